@@ -0,0 +1,13 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+//========================================================================
+int main(int argc, char* argv[]){
+	// Headless, emulated shields don't need a window
+	ofAppNoWindow window;
+	ofSetupOpenGL(&window, 0, 0, OF_WINDOW);
+
+	vector<string> args(argv + 1, argv + argc);
+	ofRunApp(new ofApp(args));
+}
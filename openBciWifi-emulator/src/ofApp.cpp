@@ -0,0 +1,1339 @@
+#include "ofApp.h"
+#include "ofxOpenBciWifiRecordingCodec.h"
+#include "ofxOpenBciWifiBatchProcessor.h"
+#include "ofxOpenBciWifiJsonParser.h"
+#include "ofxOpenBciWifiRawDecoder.h"
+#include "ofxJSON.h"
+#include <sys/resource.h>
+#include <random>
+
+//--------------------------------------------------------------
+// Hands every headset one app frame of JSON per call to deliver(), for runAccessorBenchmark()
+class ofxOpenBciWifiFrameSource : public ofxOpenBciWifiSource
+{
+public:
+	vector<string> frames;				// Bytes of one app frame by headset
+	atomic<int> pending;
+	atomic<int> delivered;
+
+	ofxOpenBciWifiFrameSource() : pending(0), delivered(0) {}
+
+	void deliver()
+	{
+		int target = delivered + 1;
+		pending++;
+		while (delivered < target)
+		{
+			ofSleepMillis(1);
+		}
+	}
+
+	void wait(int timeoutMs)
+	{
+		if (pending == 0)
+		{
+			ofSleepMillis(min(timeoutMs, 1));
+		}
+	}
+
+	void dispatch(ofxOpenBciWifiConnectionListener& listener)
+	{
+		while (_headsets.size() < frames.size())
+		{
+			_headsets.push_back(listener.onConnect("127.0.0." + ofToString(_headsets.size() + 1), 0));
+			_offsets.push_back(0);
+		}
+		if (pending == 0)
+		{
+			return;
+		}
+		bool done = true;
+		for (int h = 0; h < frames.size(); h++)
+		{
+			while (_offsets.at(h) < frames.at(h).size())
+			{
+				size_t space;
+				char* buffer = listener.getReceiveBuffer(_headsets.at(h), space);
+				if (buffer == NULL || space == 0)
+				{
+					break;
+				}
+				size_t n = min(space, frames.at(h).size() - _offsets.at(h));
+				memcpy(buffer, frames.at(h).data() + _offsets.at(h), n);
+				listener.onReceive(_headsets.at(h), n);
+				_offsets.at(h) += n;
+			}
+			done = done && _offsets.at(h) == frames.at(h).size();
+		}
+		if (done)
+		{
+			_offsets.assign(frames.size(), 0);
+			pending--;
+			delivered++;
+		}
+	}
+
+	void close() {}
+
+private:
+	vector<int> _headsets;
+	vector<size_t> _offsets;
+};
+
+//--------------------------------------------------------------
+ofApp::ofApp(vector<string> args){
+	host = "127.0.0.1";
+	port = 3000;
+	nShields = 1;
+	Fs = 250;
+	nChan = 8;
+	format = OFX_OPENBCI_WIFI_FORMAT_JSON;
+	gapSeconds = 0.f;
+	burstSeconds = 0.f;
+	injectInterval = 10.f;
+	benchmark = false;
+	stepSeconds = 10.f;
+	maxShields = 64;
+	replaySpeed = 0.f;
+	decoderCheck = false;
+	jsonBenchmark = false;
+	batchThreads = 0;
+	psdBenchmark = false;
+	kernelBenchmark = false;
+	filterBenchmark = false;
+	accessorBenchmark = false;
+
+	for (int i = 0; i < args.size(); i++)
+	{
+		string next = (i + 1 < args.size()) ? args.at(i + 1) : "";
+		if (args.at(i) == "--host") { host = next; i++; }
+		else if (args.at(i) == "--port") { port = ofToInt(next); i++; }
+		else if (args.at(i) == "--shields") { nShields = ofToInt(next); i++; }
+		else if (args.at(i) == "--fs") { Fs = ofToInt(next); i++; }
+		else if (args.at(i) == "--channels") { nChan = ofToInt(next); i++; }
+		else if (args.at(i) == "--raw") { format = OFX_OPENBCI_WIFI_FORMAT_RAW; }
+		else if (args.at(i) == "--gap") { gapSeconds = ofToFloat(next); i++; }
+		else if (args.at(i) == "--burst") { burstSeconds = ofToFloat(next); i++; }
+		else if (args.at(i) == "--benchmark") { benchmark = true; }
+		else if (args.at(i) == "--step") { stepSeconds = ofToFloat(next); i++; }
+		else if (args.at(i) == "--max-shields") { maxShields = ofToInt(next); i++; }
+		else if (args.at(i) == "--replay") { replayPath = next; i++; }
+		else if (args.at(i) == "--speed") { replaySpeed = ofToFloat(next); i++; }
+		else if (args.at(i) == "--decoder") { decoderCheck = true; }
+		else if (args.at(i) == "--json") { jsonBenchmark = true; }
+		else if (args.at(i) == "--codec") { codecPath = next; i++; }
+		else if (args.at(i) == "--batch") { batchPaths.push_back(next); i++; }
+		else if (args.at(i) == "--threads") { batchThreads = ofToInt(next); i++; }
+		else if (args.at(i) == "--psd") { psdBenchmark = true; }
+		else if (args.at(i) == "--kernels") { kernelBenchmark = true; }
+		else if (args.at(i) == "--filters") { filterBenchmark = true; }
+		else if (args.at(i) == "--accessors") { accessorBenchmark = true; }
+		else
+		{
+			ofLogWarning("openBciWifi-emulator") << "Unknown option " << args.at(i);
+		}
+	}
+	openBci = NULL;
+}
+
+//--------------------------------------------------------------
+void ofApp::setup(){
+	ofSetFrameRate(60);
+	lastReport = ofGetElapsedTimef();
+	lastInject = ofGetElapsedTimef();
+	nInjected = 0;
+	lastSamplesSent = 0;
+	lastBytesSent = 0;
+
+	if (decoderCheck)
+	{
+		runDecoderCheck();
+		return;
+	}
+
+	if (jsonBenchmark)
+	{
+		runJsonBenchmark();
+		return;
+	}
+
+	if (!codecPath.empty())
+	{
+		runCodecBenchmark();
+		return;
+	}
+
+	if (!batchPaths.empty())
+	{
+		runBatchBenchmark();
+		return;
+	}
+
+	if (psdBenchmark)
+	{
+		runPsdBenchmark();
+		return;
+	}
+
+	if (kernelBenchmark)
+	{
+		runKernelBenchmark();
+		return;
+	}
+
+	if (filterBenchmark)
+	{
+		runFilterBenchmark();
+		return;
+	}
+
+	if (accessorBenchmark)
+	{
+		runAccessorBenchmark();
+		return;
+	}
+
+	if (!replayPath.empty())
+	{
+		setupReplay();
+		return;
+	}
+
+	if (benchmark)
+	{
+		// ** Receiver under test, fed by the emulator over loopback **
+		openBci = new ofxOpenBciWifi(Fs);
+		openBci->setTcpPort(port);
+		openBci->setDataFormat(format);
+		openBci->enableThreadedProcessing();
+		openBci->enableInstrumentation();
+		ofAddListener(openBci->newSamplesEvent, this, &ofApp::onSamples);
+
+		stepShields = 1;
+		stepRunning = false;
+		maxSustainable = 0;
+		maxSustainableCpu = 0.f;
+		cout << "shields,Fs,sent samples/s,delivered samples/s,dropped,cpu %/headset,latency mean us,latency p99 us,latency max us,sustainable" << endl;
+		return;
+	}
+
+	// ** Emulator only, for a receiver running elsewhere **
+	if (!emulator.setup(host, port, nShields, Fs, nChan, format))
+	{
+		ofExit(1);
+		return;
+	}
+	emulator.start();
+	ofLogNotice("openBciWifi-emulator") << nShields << " shields streaming to " << host << ":" << port << " at " << Fs << " Hz";
+}
+
+//--------------------------------------------------------------
+void ofApp::update(){
+	float now = ofGetElapsedTimef();
+
+	if (replay)
+	{
+		openBci->update();
+		if (replay->isFinished() && replayFinished < 0)
+		{
+			// Let the last processing pass finish
+			replayFinished = now;
+		}
+		else if (replayFinished >= 0 && now - replayFinished >= 0.5f)
+		{
+			float seconds = replayFinished - replayStart;
+			cout << "Replayed " << replay->getDuration() << " s of recording in " << seconds << " s: "
+				<< samplesDelivered << " samples, " << samplesDelivered / seconds << " samples/s, "
+				<< replay->getBytesReplayed() / seconds / 1000000. << " MB/s" << endl;
+			for (int h = 0; h < openBci->getHeadsetCount(); h++)
+			{
+				cout << openBci->getHeadsetIpAddress(h) << " " << ofxOpenBciWifiInstrumentation::toString(openBci->getInstrumentation(h)) << endl;
+			}
+			ofExit(0);
+		}
+		return;
+	}
+
+	if (benchmark)
+	{
+		// Publish so the sample rings keep draining like a real app
+		openBci->update();
+
+		if (!stepRunning)
+		{
+			startStep();
+		}
+		else if (!measuring && now - stepStart >= 1.f)
+		{
+			// Let the connections settle before measuring
+			openBci->resetInstrumentation();
+			openBci->resetSampleEventLatency();
+			cpuStart = getProcessCpuSeconds();
+			emulatorCpuStart = emulator.getCpuSeconds();
+			lastSamplesSent = emulator.getSamplesSent();
+			droppedStart = 0;
+			for (int h = 0; h < openBci->getHeadsetCount(); h++)
+			{
+				droppedStart += openBci->getOverflowStats(h).droppedSamples;
+			}
+			samplesDelivered = 0;
+			measureStart = now;
+			measuring = true;
+		}
+		else if (measuring && now - measureStart >= stepSeconds)
+		{
+			finishStep();
+		}
+		return;
+	}
+
+	if ((gapSeconds > 0 || burstSeconds > 0) && now - lastInject >= injectInterval)
+	{
+		// Alternate gaps and bursts across the shields
+		int shield = nInjected % emulator.getShieldCount();
+		if (gapSeconds > 0 && (nInjected % 2 == 0 || burstSeconds <= 0))
+		{
+			emulator.injectGap(shield, gapSeconds);
+			ofLogNotice("openBciWifi-emulator") << "Gap of " << gapSeconds << " s on " << emulator.getShieldIpAddress(shield);
+		}
+		else
+		{
+			emulator.injectBurst(shield, burstSeconds);
+			ofLogNotice("openBciWifi-emulator") << "Burst after " << burstSeconds << " s on " << emulator.getShieldIpAddress(shield);
+		}
+		nInjected++;
+		lastInject = now;
+	}
+
+	if (now - lastReport >= 5.f)
+	{
+		uint64_t samples = emulator.getSamplesSent();
+		uint64_t bytes = emulator.getBytesSent();
+		ofLogNotice("openBciWifi-emulator") << (samples - lastSamplesSent) / (now - lastReport) << " samples/s, "
+			<< (bytes - lastBytesSent) / (now - lastReport) << " bytes/s";
+		lastSamplesSent = samples;
+		lastBytesSent = bytes;
+		lastReport = now;
+	}
+}
+
+//--------------------------------------------------------------
+void ofApp::setupReplay(){
+	// ** Recorded session through the receiver, no sockets **
+	replay = make_shared<ofxOpenBciWifiReplaySource>();
+	string ext = ofToLower(ofFilePath::getFileExt(replayPath));
+	bool loaded;
+	if (ext == "csv")
+	{
+		loaded = replay->loadLog(replayPath);
+	}
+	else if (ext == "cap")
+	{
+		loaded = replay->loadCapture(replayPath);
+	}
+	else
+	{
+		loaded = replay->loadRecording(replayPath);
+	}
+	if (!loaded)
+	{
+		ofExit(1);
+		return;
+	}
+	replay->setSpeed(replaySpeed);
+
+	openBci = new ofxOpenBciWifi(Fs);
+	openBci->setDataFormat(format);
+	openBci->setOverflowPolicy(OFX_OPENBCI_WIFI_OVERFLOW_BLOCK);
+	openBci->enableThreadedProcessing();
+	openBci->enableInstrumentation();
+	ofAddListener(openBci->newSamplesEvent, this, &ofApp::onSamples);
+	samplesDelivered = 0;
+	replayStart = ofGetElapsedTimef();
+	replayFinished = -1.f;
+	openBci->setSource(replay);
+}
+
+//--------------------------------------------------------------
+void ofApp::runJsonBenchmark(){
+	// 60 s of the shield's JSON stream, in the text the emulator sends, cut into the updates
+	// of a 60 fps app. The ofxJSON path drops partial chunks, so updates end on a chunk.
+	int nSamples = Fs * 60;
+	int samplesPerChunk = max(Fs / 100, 1);
+	int chunksPerUpdate = max(Fs / 60 / samplesPerChunk, 1);
+	mt19937 rng(1);
+	normal_distribution<float> noise(0.f, 10.f);
+	vector<string> updates;
+	string update;
+	char buf[64];
+	int nChunks = 0;
+	size_t nBytes = 0;
+	for (int first = 0; first < nSamples; first += samplesPerChunk)
+	{
+		update += "{\"chunk\":[";
+		for (int s = first; s < min(first + samplesPerChunk, nSamples); s++)
+		{
+			snprintf(buf, sizeof(buf), "%s{\"timestamp\":%.0f,\"sampleNumber\":%d,\"data\":[",
+				s > first ? "," : "", 1.5e12 + floor(s * 1000. / Fs), s % 256);
+			update += buf;
+			for (int ch = 0; ch < nChan; ch++)
+			{
+				snprintf(buf, sizeof(buf), ch > 0 ? ",%.2f" : "%.2f", noise(rng) + 20.f * sin(TWO_PI * 10.f * s / Fs + ch));
+				update += buf;
+			}
+			update += "]}";
+		}
+		snprintf(buf, sizeof(buf), "],\"count\":%d}\r\n", nChunks++);
+		update += buf;
+		if (nChunks % chunksPerUpdate == 0 || first + samplesPerChunk >= nSamples)
+		{
+			nBytes += update.size();
+			updates.push_back(update);
+			update.clear();
+		}
+	}
+
+	// Best of 5 runs of each path over the whole stream
+	vector<ofxOpenBciWifiSample> parsed;
+	vector<ofxOpenBciWifiSample> baseline;
+	parsed.reserve(nSamples);
+	baseline.reserve(nSamples);
+	uint64_t parserMicros = UINT64_MAX;
+	uint64_t baselineMicros = UINT64_MAX;
+	for (int run = 0; run < 5; run++)
+	{
+		// ** ofxOpenBciWifiJsonParser **
+		ofxOpenBciWifiJsonParser parser;
+		parsed.clear();
+		uint64_t start = ofGetElapsedTimeMicros();
+		for (int u = 0; u < updates.size(); u++)
+		{
+			parser.parse(updates.at(u).data(), updates.at(u).size(), parsed);
+		}
+		parserMicros = min(parserMicros, ofGetElapsedTimeMicros() - start);
+
+		// ** Split by "chunk" and read every value from an ofxJSON DOM, as update() used to **
+		ofxJSONElement json;
+		baseline.clear();
+		start = ofGetElapsedTimeMicros();
+		for (int u = 0; u < updates.size(); u++)
+		{
+			vector<string> result = ofSplitString(updates.at(u), "{\"chunk\":");
+			for (int r = 1; r < result.size(); r++)
+			{
+				result.at(r) = "{\"chunk\":" + result.at(r);
+				if (!json.parse(result.at(r)))
+				{
+					continue;
+				}
+				int nChunkSamples = json["chunk"].size();
+				for (int s = 0; s < nChunkSamples; s++)
+				{
+					ofxOpenBciWifiSample sample;
+					sample.timestamp = json["chunk"][s]["timestamp"].asDouble();
+					sample.sampleNumber = json["chunk"][s]["sampleNumber"].asInt();
+					sample.count = json["count"].asInt();
+					sample.nChannels = min((int)json["chunk"][s]["data"].size(), OFX_OPENBCI_WIFI_MAX_CHANNELS);
+					for (int ch = 0; ch < sample.nChannels; ch++)
+					{
+						sample.data[ch] = json["chunk"][s]["data"][ch].asFloat();
+					}
+					sample.nAux = 0;
+					baseline.push_back(sample);
+				}
+			}
+		}
+		baselineMicros = min(baselineMicros, ofGetElapsedTimeMicros() - start);
+	}
+
+	// Both paths round the same decimal text to float
+	bool identical = parsed.size() == baseline.size();
+	for (int s = 0; identical && s < parsed.size(); s++)
+	{
+		const ofxOpenBciWifiSample& a = parsed.at(s);
+		const ofxOpenBciWifiSample& b = baseline.at(s);
+		identical = a.timestamp == b.timestamp && a.sampleNumber == b.sampleNumber && a.count == b.count
+			&& a.nChannels == b.nChannels && memcmp(a.data, b.data, a.nChannels * sizeof(float)) == 0;
+	}
+
+	cout << nChan << " channels, " << nChunks << " chunks, " << parsed.size() << " samples, " << nBytes << " bytes" << endl;
+	cout << "parser,MB/s,samples/s,ns/sample,speedup" << endl;
+	double parserSeconds = max(parserMicros / 1000000., 1e-9);
+	double baselineSeconds = max(baselineMicros / 1000000., 1e-9);
+	cout << "ofxOpenBciWifiJsonParser," << nBytes / parserSeconds / 1000000. << "," << nSamples / parserSeconds << ","
+		<< parserSeconds * 1e9 / nSamples << "," << baselineSeconds / parserSeconds << endl;
+	cout << "ofxJSON," << nBytes / baselineSeconds / 1000000. << "," << nSamples / baselineSeconds << ","
+		<< baselineSeconds * 1e9 / nSamples << ",1" << endl;
+	cout << (identical ? "samples identical" : "MISMATCH") << endl;
+	ofExit(identical ? 0 : 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::runDecoderCheck(){
+	// Cyton packets and their values at gain 24: 4.5 V / 24 / (2^23 - 1) per channel count,
+	// 0.002 g / 16 per accelerometer count when the footer is 0xC0, aux counts as is otherwise
+	struct Fixture
+	{
+		string name;
+		string hex;
+		int sampleNumber;
+		float uV[8];
+		float aux[OFX_OPENBCI_WIFI_AUX_CHANNELS];
+	};
+	vector<Fixture> fixtures;
+	fixtures.push_back({ "full scale",
+		"A0 00 7F FF FF 80 00 00 00 00 01 FF FF FF 00 00 00 40 00 00 C0 00 00 12 34 56 00 00 00 00 1F 40 C0", 0,
+		{ 187500.f, -187500.022f, 0.0223517445f, -0.0223517445f, 0.f, 93750.0112f, -93750.0112f, 26666.6593f },
+		{ 0.f, 0.f, 1.f } });
+	fixtures.push_back({ "board at rest",
+		"A0 2A 00 12 D6 FF ED 2A 00 A3 F1 FF 5C 0F 00 0B B8 FF F4 48 03 E8 A5 FC 1A 5B FF 38 00 50 1F 2C C0", 42,
+		{ 107.780112f, -107.780112f, 938.080363f, -938.080363f, 67.0552334f, -67.0552334f, 5725.73462f, -5708.56848f },
+		{ -0.025f, 0.01f, 0.9975f } });
+	fixtures.push_back({ "aux footer",
+		"A0 FF 00 00 64 FF FF 9C 00 10 00 FF F0 00 01 00 00 FF 00 00 00 00 10 FF FF F0 01 02 03 04 FF FE C1", 255,
+		{ 2.23517445f, -2.23517445f, 91.5527453f, -91.5527453f, 1464.84392f, -1464.84392f, 0.357627911f, -0.357627911f },
+		{ 258.f, 772.f, -2.f } });
+
+	auto toBytes = [](const string& hex)
+	{
+		string bytes;
+		vector<string> values = ofSplitString(hex, " ");
+		for (int i = 0; i < values.size(); i++)
+		{
+			bytes += (char)strtol(values.at(i).c_str(), NULL, 16);
+		}
+		return bytes;
+	};
+	int nFailed = 0;
+	auto check = [&](bool ok, const string& what)
+	{
+		if (!ok)
+		{
+			cout << "FAIL " << what << endl;
+			nFailed++;
+		}
+	};
+	auto checkSample = [&](const ofxOpenBciWifiSample& sample, const Fixture& fixture, const string& what)
+	{
+		bool ok = sample.sampleNumber == fixture.sampleNumber && sample.nChannels == 8 && sample.nAux == OFX_OPENBCI_WIFI_AUX_CHANNELS;
+		for (int ch = 0; ch < 8; ch++)
+		{
+			ok = ok && fabs(sample.data[ch] - fixture.uV[ch]) <= 1e-6f * max(fabs(fixture.uV[ch]), 1.f);
+		}
+		for (int a = 0; a < OFX_OPENBCI_WIFI_AUX_CHANNELS; a++)
+		{
+			ok = ok && fabs(sample.aux[a] - fixture.aux[a]) <= 1e-6f * max(fabs(fixture.aux[a]), 1.f);
+		}
+		check(ok, what + ": " + fixture.name);
+	};
+
+	// ** Each packet on its own **
+	for (int f = 0; f < fixtures.size(); f++)
+	{
+		ofxOpenBciWifiRawDecoder decoder;
+		vector<ofxOpenBciWifiSample> samples;
+		string packet = toBytes(fixtures.at(f).hex);
+		check(packet.size() == OFX_OPENBCI_WIFI_RAW_PACKET_SIZE, "fixture size: " + fixtures.at(f).name);
+		decoder.parse(packet.data(), packet.size(), samples);
+		check(samples.size() == 1 && decoder.getErrorCount() == 0, "one packet: " + fixtures.at(f).name);
+		if (samples.size() == 1)
+		{
+			checkSample(samples.at(0), fixtures.at(f), "values");
+		}
+	}
+
+	// ** Garbage, a good packet, one with a bad footer, then two good ones, fed whole, a byte at a
+	// time and split in two at every offset. Every skipped byte counts as an error. **
+	string garbage = toBytes("7B 22 63 68 A0 11 C0 0D 0A");
+	string badFooter = toBytes(fixtures.at(1).hex);
+	badFooter.back() = 0x00;
+	string stream = garbage + toBytes(fixtures.at(0).hex) + badFooter + toBytes(fixtures.at(1).hex) + toBytes(fixtures.at(2).hex);
+	unsigned int expectedErrors = garbage.size() + badFooter.size();
+	for (int split = 0; split <= (int)stream.size(); split++)
+	{
+		ofxOpenBciWifiRawDecoder decoder;
+		vector<ofxOpenBciWifiSample> samples;
+		string what;
+		if (split == stream.size())
+		{
+			what = "resync, a byte at a time";
+			for (int b = 0; b < stream.size(); b++)
+			{
+				decoder.parse(stream.data() + b, 1, samples);
+			}
+		}
+		else
+		{
+			what = "resync, split at " + ofToString(split);
+			decoder.parse(stream.data(), split, samples);
+			decoder.parse(stream.data() + split, stream.size() - split, samples);
+		}
+		check(samples.size() == fixtures.size() && decoder.getErrorCount() == expectedErrors, what + ": "
+			+ ofToString(samples.size()) + " samples, " + ofToString(decoder.getErrorCount()) + " bytes skipped");
+		for (int f = 0; f < fixtures.size() && f < samples.size(); f++)
+		{
+			checkSample(samples.at(f), fixtures.at(f), what);
+		}
+	}
+
+	cout << (nFailed == 0 ? "decoder matches all fixtures" : ofToString(nFailed) + " checks failed") << endl;
+	ofExit(nFailed == 0 ? 0 : 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::runCodecBenchmark(){
+	ofxOpenBciWifiRecordingReader reader;
+	if (!reader.open(codecPath))
+	{
+		ofLogError("openBciWifi-emulator") << "Could not read " << codecPath;
+		ofExit(1);
+		return;
+	}
+
+	// Regroup the samples into blocks of the size the writer compresses
+	int maxBlockSamples = ofxOpenBciWifiRecordingWriter().getMaxBlockSamples();
+	vector<ofxOpenBciWifiRecordingBlock> blocks;
+	vector<int> filling;				// Block being filled by headset
+	ofxOpenBciWifiRecordingBlock block;
+	while (reader.readBlock(block))
+	{
+		if (block.headset >= filling.size())
+		{
+			filling.resize(block.headset + 1, -1);
+		}
+		for (int s = 0; s < block.nSamples; s++)
+		{
+			int b = filling.at(block.headset);
+			if (b < 0 || blocks.at(b).nChannels != block.nChannels || blocks.at(b).nSamples >= maxBlockSamples)
+			{
+				b = blocks.size();
+				blocks.push_back(ofxOpenBciWifiRecordingBlock());
+				blocks.back().headset = block.headset;
+				blocks.back().nSamples = 0;
+				blocks.back().nChannels = block.nChannels;
+				filling.at(block.headset) = b;
+			}
+			ofxOpenBciWifiRecordingBlock& out = blocks.at(b);
+			out.timestamps.push_back(block.timestamps.at(s));
+			out.sampleNumbers.push_back(block.sampleNumbers.at(s));
+			out.counts.push_back(block.counts.at(s));
+			out.data.insert(out.data.end(), block.data.begin() + s * block.nChannels, block.data.begin() + (s + 1) * block.nChannels);
+			out.nSamples++;
+		}
+	}
+	reader.close();
+
+	// ** Encode **
+	uint64_t rawBytes = 0;
+	vector<string> encoded(blocks.size());
+	uint64_t start = ofGetElapsedTimeMicros();
+	for (int b = 0; b < blocks.size(); b++)
+	{
+		ofxOpenBciWifiRecordingCodec::encode(blocks.at(b), encoded.at(b));
+		rawBytes += OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER + blocks.at(b).nSamples * (sizeof(double) + 2 * sizeof(int32_t) + blocks.at(b).nChannels * sizeof(float));
+	}
+	double encodeSeconds = (ofGetElapsedTimeMicros() - start) / 1000000.;
+
+	// ** Decode and check every bit came back **
+	uint64_t encodedBytes = 0;
+	bool identical = true;
+	ofxOpenBciWifiRecordingBlock decoded;
+	double decodeSeconds = 0;
+	for (int b = 0; b < blocks.size(); b++)
+	{
+		const string& payload = encoded.at(b);
+		encodedBytes += payload.size();
+		start = ofGetElapsedTimeMicros();
+		bool ok = ofxOpenBciWifiRecordingCodec::decode(payload.data(), payload.size(), decoded);
+		decodeSeconds += (ofGetElapsedTimeMicros() - start) / 1000000.;
+		const ofxOpenBciWifiRecordingBlock& original = blocks.at(b);
+		identical = identical && ok && decoded.nSamples == original.nSamples
+			&& memcmp(&decoded.timestamps[0], &original.timestamps[0], original.nSamples * sizeof(double)) == 0
+			&& decoded.sampleNumbers == original.sampleNumbers && decoded.counts == original.counts
+			&& memcmp(&decoded.data[0], &original.data[0], original.data.size() * sizeof(float)) == 0;
+	}
+
+	cout << blocks.size() << " blocks, " << rawBytes << " bytes raw, " << encodedBytes << " bytes compressed, ratio "
+		<< (encodedBytes > 0 ? (double)rawBytes / encodedBytes : 0.) << endl;
+	cout << "encode " << rawBytes / max(encodeSeconds, 1e-9) / 1000000. << " MB/s, decode "
+		<< rawBytes / max(decodeSeconds, 1e-9) / 1000000. << " MB/s, " << (identical ? "lossless" : "MISMATCH") << endl;
+	ofExit(identical ? 0 : 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::runBatchBenchmark(){
+	ofxOpenBciWifiBatchProcessor batch(Fs);
+	batch.setDataFormat(format);
+	for (int i = 0; i < batchPaths.size(); i++)
+	{
+		batch.addFile(batchPaths.at(i));
+	}
+
+	// Double the threads up to the limit to see how close to linear it scales
+	int maxThreads = batchThreads > 0 ? batchThreads : max((int)thread::hardware_concurrency(), 1);
+	float oneThread = 0.f;
+	cout << "threads,samples,seconds,samples/s,speedup,steals" << endl;
+	for (int nThreads = 1; ; nThreads = min(nThreads * 2, maxThreads))
+	{
+		batch.setThreadCount(nThreads);
+		if (!batch.run())
+		{
+			ofExit(1);
+			return;
+		}
+		float seconds = max(batch.getRunSeconds(), 1e-6f);
+		if (nThreads == 1)
+		{
+			oneThread = seconds;
+		}
+		cout << nThreads << "," << batch.getSampleCount() << "," << seconds << "," << batch.getSampleCount() / seconds << ","
+			<< oneThread / seconds << "," << batch.getStealCount() << endl;
+		if (nThreads == maxThreads)
+		{
+			break;
+		}
+	}
+
+	// ** Replay every file through ofxOpenBciWifi and check the batch is bit for bit the same **
+	bool identical = true;
+	for (int f = 0; f < batch.getFileCount(); f++)
+	{
+		const ofxOpenBciWifiBatchFile& file = batch.getFile(f);
+		replay = make_shared<ofxOpenBciWifiReplaySource>();
+		bool capture = ofToLower(ofFilePath::getFileExt(file.inputPath)) == "cap";
+		if (!(capture ? replay->loadCapture(file.inputPath) : replay->loadRecording(file.inputPath)))
+		{
+			ofExit(1);
+			return;
+		}
+		// Fast, but slow enough that an update rarely takes in more than a hop, so most spectra
+		// get their own event
+		replay->setSpeed(replaySpeed > 0.f ? replaySpeed : 20.f);
+
+		openBci = new ofxOpenBciWifi(Fs);
+		openBci->setDataFormat(capture ? format : OFX_OPENBCI_WIFI_FORMAT_JSON);
+		openBci->setOverflowPolicy(OFX_OPENBCI_WIFI_OVERFLOW_BLOCK);
+		ofAddListener(openBci->newSamplesEvent, this, &ofApp::onCheckSamples);
+		ofAddListener(openBci->newFftEvent, this, &ofApp::onCheckFft);
+		checkSamples.clear();
+		checkFft.clear();
+		checkFftSamples.clear();
+		samplesDelivered = 0;
+		openBci->setSource(replay);
+
+		// Processed on this thread, so the events come from update()
+		int idle = 0;
+		while (idle < 50)
+		{
+			uint64_t before = samplesDelivered;
+			openBci->update();
+			if (samplesDelivered == before)
+			{
+				idle = replay->isFinished() ? idle + 1 : 0;
+				ofSleepMillis(1);
+			}
+		}
+
+		uint64_t nSamples = 0;
+		uint64_t nSpectra = 0;
+		uint64_t nMismatches = 0;
+		for (int bh = 0; bh < file.headsets.size(); bh++)
+		{
+			const ofxOpenBciWifiBatchHeadset& headset = file.headsets.at(bh);
+			int h = openBci->getHeadset(headset.ipAddress);
+			if (h == OFX_OPENBCI_WIFI_INVALID_HEADSET || checkSamples.at(h).size() != headset.timestamps.size() * headset.nChannels)
+			{
+				ofLogError("openBciWifi-emulator") << file.inputPath << " " << headset.ipAddress << ": sample count differs";
+				nMismatches++;
+				continue;
+			}
+			const vector<float>& samples = checkSamples.at(h);
+			for (size_t s = 0; s < headset.timestamps.size(); s++, nSamples++)
+			{
+				for (int ch = 0; ch < headset.nChannels; ch++)
+				{
+					if (memcmp(&headset.data.at(ch).at(s), &samples.at(s * headset.nChannels + ch), sizeof(float)) != 0)
+					{
+						nMismatches++;
+					}
+				}
+			}
+
+			// A pass that fills more than one window only raises an event for the last spectrum,
+			// so each event is checked against the last batch spectrum the samples in so far complete
+			for (int k = 0; k < checkFftSamples.at(h).size(); k++, nSpectra++)
+			{
+				uint64_t samplesIn = checkFftSamples.at(h).at(k);
+				int spectrum = upper_bound(headset.fftSamples.begin(), headset.fftSamples.end(), samplesIn) - headset.fftSamples.begin() - 1;
+				const float* fft = &checkFft.at(h).at(k * headset.nChannels * headset.fftBins);
+				for (int ch = 0; ch < headset.nChannels; ch++)
+				{
+					if (spectrum < 0 || memcmp(&headset.fft.at(ch).at(spectrum * headset.fftBins), fft + ch * headset.fftBins, headset.fftBins * sizeof(float)) != 0)
+					{
+						nMismatches++;
+					}
+				}
+			}
+		}
+
+		ofRemoveListener(openBci->newSamplesEvent, this, &ofApp::onCheckSamples);
+		ofRemoveListener(openBci->newFftEvent, this, &ofApp::onCheckFft);
+		delete openBci;
+		openBci = NULL;
+		replay.reset();
+
+		cout << file.inputPath << ": " << nSamples << " samples, " << nSpectra << " spectra against ofxOpenBciWifi, "
+			<< (nMismatches == 0 ? "identical" : ofToString(nMismatches) + " MISMATCHES") << endl;
+		identical = identical && nMismatches == 0;
+	}
+	ofExit(identical ? 0 : 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::runPsdBenchmark(){
+	// White noise and a 10 Hz tone on every channel, 1 s windows
+	int windowSize = Fs;
+	int nSamples = Fs * 120;
+	vector<vector<float>> signal(nChan, vector<float>(nSamples));
+	mt19937 rng(1);
+	normal_distribution<float> noise(0.f, 10.f);
+	for (int ch = 0; ch < nChan; ch++)
+	{
+		for (int s = 0; s < nSamples; s++)
+		{
+			signal.at(ch).at(s) = noise(rng) + 20.f * sin(TWO_PI * 10.f * s / Fs + ch);
+		}
+	}
+
+	struct Estimator
+	{
+		string name;
+		int hop;
+		bool smoothing;
+		int welchSegments;
+		int nTapers;
+	};
+	vector<Estimator> estimators;
+	estimators.push_back({ "dB smoothing", windowSize / 2, true, 1, 0 });
+	estimators.push_back({ "none", windowSize / 2, false, 1, 0 });
+	estimators.push_back({ "Welch 4", windowSize / 2, false, 4, 0 });
+	estimators.push_back({ "Welch 8", windowSize / 2, false, 8, 0 });
+	estimators.push_back({ "multitaper NW 2", windowSize / 2, false, 1, 3 });
+	estimators.push_back({ "multitaper NW 2, same FFTs", 3 * windowSize / 2, false, 1, 3 });
+	estimators.push_back({ "multitaper NW 2 + Welch 2, same FFTs", 3 * windowSize / 2, false, 2, 3 });
+
+	// The spread of the noise bins in dB is the estimator's, as the true spectrum is flat there
+	cout << "estimator,hop,FFTs/s,us/spectrum,ns/frame,noise std" << endl;
+	for (int e = 0; e < estimators.size(); e++)
+	{
+		const Estimator& estimator = estimators.at(e);
+		ofxOpenBciWifiFftEngine engine;
+		engine.setWelchSegments(estimator.welchSegments);
+		if (estimator.nTapers > 0)
+		{
+			engine.enableMultitaper(2.f, estimator.nTapers);
+		}
+		engine.prepare(windowSize);
+		vector<vector<float>> spectra(nChan, vector<float>(windowSize / 2, 0.f));
+		vector<ofxOpenBciWifiWelchHistory> histories(nChan);
+
+		uint64_t busyMicros = 0;
+		int nSpectra = 0;
+		double sum = 0.;
+		double sumSquares = 0.;
+		uint64_t nBins = 0;
+		for (int s = windowSize; s <= nSamples; s += estimator.hop)
+		{
+			uint64_t start = ofGetElapsedTimeMicros();
+			for (int ch = 0; ch < nChan; ch++)
+			{
+				engine.queue(&signal.at(ch).at(s - windowSize), windowSize, &spectra.at(ch).at(0), OF_FFT_WINDOW_HAMMING, &histories.at(ch));
+			}
+			engine.run(estimator.smoothing, 0.25f);
+			busyMicros += ofGetElapsedTimeMicros() - start;
+			nSpectra++;
+
+			// Once the averages have settled, away from DC and the tone
+			if (s < 10 * windowSize)
+			{
+				continue;
+			}
+			for (int ch = 0; ch < nChan; ch++)
+			{
+				for (int b = 2; b < windowSize / 2; b++)
+				{
+					if (fabs(b * (float)Fs / windowSize - 10.f) > 3.f)
+					{
+						float x = spectra.at(ch).at(b);
+						sum += x;
+						sumSquares += x * x;
+						nBins++;
+					}
+				}
+			}
+		}
+		double mean = sum / max(nBins, (uint64_t)1);
+		double std = sqrt(max(sumSquares / max(nBins, (uint64_t)1) - mean * mean, 0.));
+		int nFfts = max(estimator.nTapers, 1);
+		cout << estimator.name << "," << estimator.hop << "," << (float)nFfts * Fs / estimator.hop * nChan << ","
+			<< busyMicros / (double)max(nSpectra * nChan, 1) << "," << busyMicros * 1000. / nSamples << "," << std << endl;
+	}
+	ofExit(0);
+}
+
+//--------------------------------------------------------------
+void ofApp::runKernelBenchmark(){
+	// One processing pass worth of samples at a time, as ofxOpenBciWifi::processHeadset runs them:
+	// gather into the frame block, filter, scatter into a 1 s FFT ring
+	int nSamples = max(Fs / 10, 1);
+	int windowSize = Fs;
+	int nPasses = max(400000 / nSamples, 1);
+	mt19937 rng(1);
+	normal_distribution<float> noise(0.f, 10.f);
+
+	cout << "channels,kernels,gather+scatter ns/frame,filter ns/frame,total ns/frame,speedup" << endl;
+	int channelCounts[] = { 4, 8, 16 };
+	for (int c = 0; c < 3; c++)
+	{
+		int nChannels = channelCounts[c];
+		vector<ofxOpenBciWifiSample> samples(nSamples);
+		for (int s = 0; s < nSamples; s++)
+		{
+			samples.at(s).nChannels = nChannels;
+			for (int ch = 0; ch < OFX_OPENBCI_WIFI_MAX_CHANNELS; ch++)
+			{
+				samples.at(s).data[ch] = noise(rng);
+			}
+		}
+
+		double genericNs = 0.;
+		for (int specialize = 0; specialize < 2; specialize++)
+		{
+			ofxOpenBciWifiChannelKernels kernels;
+			kernels.setup(nChannels, specialize == 1);
+			ofxOpenBciWifiFilterBank filters;
+			filters.addStage(ofxOpenBciWifiFilterDesign::highpass(OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH, 2, 0.5 / Fs));
+			filters.addStage(ofxOpenBciWifiFilterDesign::harmonicNotch(60. / Fs, 1, 0.7071));
+			filters.addStage(ofxOpenBciWifiFilterDesign::lowpass(OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH, 2, 45. / Fs));
+			filters.setup(nChannels);
+			vector<float> frames(nSamples * OFX_OPENBCI_WIFI_MAX_CHANNELS);
+			vector<float> ring(nChannels * windowSize, 0.f);
+			int pos = 0;
+
+			// Timed over whole runs of passes, a pass is too short for the clock. Even runs leave
+			// out the filter, the best of 5 of each counts.
+			uint64_t runMicros[2] = { UINT64_MAX, UINT64_MAX };
+			for (int run = 0; run < 10; run++)
+			{
+				uint64_t start = ofGetElapsedTimeMicros();
+				for (int p = 0; p < nPasses; p++)
+				{
+					kernels.gather(&samples[0], nSamples, &frames[0], OFX_OPENBCI_WIFI_MAX_CHANNELS);
+					if (run % 2 == 1)
+					{
+						filters.process(&frames[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+					}
+					for (int s = 0; s < nSamples; )
+					{
+						int n = min(nSamples - s, windowSize - pos);
+						kernels.scatter(&frames[s * OFX_OPENBCI_WIFI_MAX_CHANNELS], n, OFX_OPENBCI_WIFI_MAX_CHANNELS, &ring[0], pos, windowSize);
+						s += n;
+						pos = pos + n < windowSize ? pos + n : 0;
+					}
+				}
+				runMicros[run % 2] = min(runMicros[run % 2], ofGetElapsedTimeMicros() - start);
+			}
+			uint64_t kernelMicros = runMicros[0];
+			uint64_t filterMicros = runMicros[1] - min(runMicros[1], runMicros[0]);
+			double nFrames = (double)nPasses * nSamples;
+			double kernelNs = kernelMicros * 1000. / nFrames;
+			double totalNs = (kernelMicros + filterMicros) * 1000. / nFrames;
+			if (specialize == 0)
+			{
+				genericNs = totalNs;
+			}
+			cout << nChannels << "," << (kernels.isSpecialized() ? "specialized" : "generic") << "," << kernelNs << ","
+				<< filterMicros * 1000. / nFrames << "," << totalNs << "," << genericNs / max(totalNs, 1e-9) << endl;
+		}
+	}
+	ofExit(0);
+}
+
+//--------------------------------------------------------------
+void ofApp::runFilterBenchmark(){
+	// The 1 Hz highpass, 60 Hz notch and 50 Hz lowpass biquads, Q 0.7071, each channel once
+	// through ofxOpenBciWifiFilterBank and once through scalar biquads designed and updated
+	// like ofxBiquadFilter1f: double coefficients, float state, transposed direct form II.
+	// The same biquads with double state give the rounding error of the float ones.
+	struct Biquad
+	{
+		double a0, a1, a2, b1, b2;
+		float z1, z2;
+		double exactZ1, exactZ2;
+
+		Biquad(ofxOpenBciWifiBiquadType type, double Fc, double Q)
+		{
+			double K = tan(PI * Fc);
+			double norm = 1. / (1. + K / Q + K * K);
+			if (type == OFX_OPENBCI_WIFI_BIQUAD_LOWPASS)
+			{
+				a0 = K * K * norm;
+				a1 = 2. * a0;
+			}
+			else if (type == OFX_OPENBCI_WIFI_BIQUAD_HIGHPASS)
+			{
+				a0 = norm;
+				a1 = -2. * a0;
+			}
+			else
+			{
+				a0 = (1. + K * K) * norm;
+				a1 = 2. * (K * K - 1.) * norm;
+			}
+			a2 = a0;
+			b1 = 2. * (K * K - 1.) * norm;
+			b2 = (1. - K / Q + K * K) * norm;
+			z1 = z2 = 0.f;
+			exactZ1 = exactZ2 = 0.;
+		}
+		float update(float in)
+		{
+			float out = in * a0 + z1;
+			z1 = in * a1 + z2 - b1 * out;
+			z2 = in * a2 - b2 * out;
+			return out;
+		}
+		double updateExact(double in)
+		{
+			double out = in * a0 + exactZ1;
+			exactZ1 = in * a1 + exactZ2 - b1 * out;
+			exactZ2 = in * a2 - b2 * out;
+			return out;
+		}
+	};
+
+	// 60 s of electrode offset, alpha, line noise and broadband noise, one pass of samples per call
+	int nSamples = Fs * 60;
+	int blockSize = max(Fs / 10, 1);
+	mt19937 rng(1);
+	normal_distribution<float> noise(0.f, 10.f);
+	bool inTolerance = true;
+
+	// The electrode offsets leave large values in the highpass state, so float rounding alone moves
+	// the outputs by up to a few uV. The bank passes if it is within 4x the reference's rounding
+	// once the highpass has settled from the offset step at the start (the float coefficients
+	// change the decay of that transient a little).
+	int settle = Fs * 10;
+	cout << "channels,bank samples/s/core,reference samples/s/core,speedup,max error uV,reference rounding uV,tolerance uV" << endl;
+	int channelCounts[] = { 4, 8, 16 };
+	for (int c = 0; c < 3; c++)
+	{
+		int nChannels = channelCounts[c];
+		vector<float> input(nSamples * OFX_OPENBCI_WIFI_MAX_CHANNELS, 0.f);
+		for (int s = 0; s < nSamples; s++)
+		{
+			for (int ch = 0; ch < nChannels; ch++)
+			{
+				input.at(s * OFX_OPENBCI_WIFI_MAX_CHANNELS + ch) = 5000.f * (ch + 1) + 20.f * sin(TWO_PI * 10.f * s / Fs + ch)
+					+ 30.f * sin(TWO_PI * 60.f * s / Fs) + noise(rng);
+			}
+		}
+
+		// ** Filter bank, a block of frames per call **
+		vector<float> frames;
+		uint64_t bankMicros = UINT64_MAX;
+		for (int run = 0; run < 5; run++)
+		{
+			ofxOpenBciWifiFilterBank filters;
+			filters.addBiquad(OFX_OPENBCI_WIFI_BIQUAD_HIGHPASS, 1. / Fs);
+			filters.addBiquad(OFX_OPENBCI_WIFI_BIQUAD_NOTCH, 60. / Fs);
+			filters.addBiquad(OFX_OPENBCI_WIFI_BIQUAD_LOWPASS, 50. / Fs);
+			filters.setup(nChannels);
+			frames = input;
+			uint64_t start = ofGetElapsedTimeMicros();
+			for (int s = 0; s < nSamples; s += blockSize)
+			{
+				filters.process(&frames[s * OFX_OPENBCI_WIFI_MAX_CHANNELS], min(blockSize, nSamples - s), OFX_OPENBCI_WIFI_MAX_CHANNELS);
+			}
+			bankMicros = min(bankMicros, ofGetElapsedTimeMicros() - start);
+		}
+
+		// ** Scalar reference, a sample at a time through each channel's chain **
+		vector<float> reference;
+		uint64_t referenceMicros = UINT64_MAX;
+		for (int run = 0; run < 5; run++)
+		{
+			vector<Biquad> hp(nChannels, Biquad(OFX_OPENBCI_WIFI_BIQUAD_HIGHPASS, 1. / Fs, 0.7071));
+			vector<Biquad> notch(nChannels, Biquad(OFX_OPENBCI_WIFI_BIQUAD_NOTCH, 60. / Fs, 0.7071));
+			vector<Biquad> lp(nChannels, Biquad(OFX_OPENBCI_WIFI_BIQUAD_LOWPASS, 50. / Fs, 0.7071));
+			reference = input;
+			uint64_t start = ofGetElapsedTimeMicros();
+			for (int s = 0; s < nSamples; s++)
+			{
+				float* frame = &reference[s * OFX_OPENBCI_WIFI_MAX_CHANNELS];
+				for (int ch = 0; ch < nChannels; ch++)
+				{
+					frame[ch] = lp[ch].update(notch[ch].update(hp[ch].update(frame[ch])));
+				}
+			}
+			referenceMicros = min(referenceMicros, ofGetElapsedTimeMicros() - start);
+		}
+
+		vector<Biquad> hp(nChannels, Biquad(OFX_OPENBCI_WIFI_BIQUAD_HIGHPASS, 1. / Fs, 0.7071));
+		vector<Biquad> notch(nChannels, Biquad(OFX_OPENBCI_WIFI_BIQUAD_NOTCH, 60. / Fs, 0.7071));
+		vector<Biquad> lp(nChannels, Biquad(OFX_OPENBCI_WIFI_BIQUAD_LOWPASS, 50. / Fs, 0.7071));
+		double maxError = 0.;
+		double rounding = 0.;
+		for (int s = 0; s < nSamples; s++)
+		{
+			for (int ch = 0; ch < nChannels; ch++)
+			{
+				int i = s * OFX_OPENBCI_WIFI_MAX_CHANNELS + ch;
+				double exact = lp[ch].updateExact(notch[ch].updateExact(hp[ch].updateExact(input.at(i))));
+				if (s < settle)
+				{
+					continue;
+				}
+				maxError = max(maxError, (double)fabs(frames.at(i) - reference.at(i)));
+				rounding = max(rounding, fabs(reference.at(i) - exact));
+			}
+		}
+		double tolerance = 4. * rounding + 1e-3;
+		inTolerance = inTolerance && maxError <= tolerance;
+
+		double nChannelSamples = (double)nSamples * nChannels;
+		double bankRate = nChannelSamples / max(bankMicros / 1000000., 1e-9);
+		double referenceRate = nChannelSamples / max(referenceMicros / 1000000., 1e-9);
+		cout << nChannels << "," << bankRate << "," << referenceRate << "," << bankRate / referenceRate << ","
+			<< maxError << "," << rounding << "," << tolerance << endl;
+	}
+	cout << (inTolerance ? "within tolerance" : "OUT OF TOLERANCE") << endl;
+	ofExit(inTolerance ? 0 : 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::runAccessorBenchmark(){
+	// Every headset gets Fs / 60 samples per update(), like a 60 fps app. The app gets the samples
+	// and spectra of every headset, once through getData(ip) / getLatestFft(ip), which copy, and
+	// once through getDataSpans(h) / getLatestFft(h), which don't. It reads the first sample and
+	// bin of each channel, so the timing is the accessors' and not the app's own work.
+	int samplesPerFrame = max(Fs / 60, 1);
+	int samplesPerChunk = max(Fs / 100, 1);
+	int nWarmup = 2 * 60;				// Until every headset has a spectrum
+	int nFrames = 300;
+	int nRepeats = 10;					// Reads per frame, a read of one headset is too short for the clock
+	mt19937 rng(1);
+	normal_distribution<float> noise(0.f, 10.f);
+	bool identical = true;
+
+	cout << "headsets,channels,samples/frame/headset,copy ns/frame,spans ns/frame,speedup" << endl;
+	for (int nHeadsets = 1; nHeadsets <= maxShields; nHeadsets *= 4)
+	{
+		shared_ptr<ofxOpenBciWifiFrameSource> source = make_shared<ofxOpenBciWifiFrameSource>();
+		char buf[64];
+		for (int h = 0; h < nHeadsets; h++)
+		{
+			string frame;
+			for (int first = 0; first < samplesPerFrame; first += samplesPerChunk)
+			{
+				frame += "{\"chunk\":[";
+				for (int s = first; s < min(first + samplesPerChunk, samplesPerFrame); s++)
+				{
+					snprintf(buf, sizeof(buf), "%s{\"timestamp\":0,\"sampleNumber\":%d,\"data\":[", s > first ? "," : "", s);
+					frame += buf;
+					for (int ch = 0; ch < nChan; ch++)
+					{
+						snprintf(buf, sizeof(buf), ch > 0 ? ",%.2f" : "%.2f", noise(rng));
+						frame += buf;
+					}
+					frame += "]}";
+				}
+				frame += "],\"count\":0}\r\n";
+			}
+			source->frames.push_back(frame);
+		}
+
+		openBci = new ofxOpenBciWifi(Fs);
+		openBci->setTcpPort(port);
+		openBci->enableFft();
+		openBci->setSource(source);
+
+		uint64_t copyMicros = 0;
+		uint64_t spansMicros = 0;
+		for (int f = 0; f < nWarmup + nFrames; f++)
+		{
+			source->deliver();
+			openBci->update();
+			if (f < nWarmup)
+			{
+				continue;
+			}
+
+			// ** Copies, by ip address **
+			vector<string> ips = openBci->getHeadsetIpAddresses();
+			double copySum = 0.;
+			uint64_t start = ofGetElapsedTimeMicros();
+			for (int r = 0; r < nRepeats; r++)
+			{
+				for (int h = 0; h < ips.size(); h++)
+				{
+					vector<vector<float>> data = openBci->getData(ips.at(h));
+					vector<vector<float>> fft = openBci->getLatestFft(ips.at(h));
+					for (int ch = 0; ch < data.size(); ch++)
+					{
+						copySum += data.at(ch).empty() ? 0.f : data.at(ch).at(0);
+					}
+					for (int ch = 0; ch < fft.size(); ch++)
+					{
+						copySum += fft.at(ch).empty() ? 0.f : fft.at(ch).at(0);
+					}
+				}
+			}
+			copyMicros += ofGetElapsedTimeMicros() - start;
+
+			// ** Spans and references, by handle **
+			double spansSum = 0.;
+			start = ofGetElapsedTimeMicros();
+			for (int r = 0; r < nRepeats; r++)
+			{
+				for (int h = 0; h < openBci->getHeadsetCount(); h++)
+				{
+					ofxOpenBciWifiSampleSpans spans;
+					if (!openBci->getDataSpans(h, spans))
+					{
+						continue;
+					}
+					const vector<vector<float>>& fft = openBci->getLatestFft(h);
+					for (int ch = 0; ch < spans.nChannels; ch++)
+					{
+						spansSum += spans.size() == 0 ? 0.f : spans.at(0, ch);
+					}
+					for (int ch = 0; ch < fft.size(); ch++)
+					{
+						spansSum += fft[ch].empty() ? 0.f : fft[ch][0];
+					}
+				}
+			}
+			spansMicros += ofGetElapsedTimeMicros() - start;
+			identical = identical && copySum == spansSum;
+		}
+
+		double copyNs = copyMicros * 1000. / ((double)nFrames * nRepeats);
+		double spansNs = spansMicros * 1000. / ((double)nFrames * nRepeats);
+		cout << nHeadsets << "," << nChan << "," << samplesPerFrame << "," << copyNs << "," << spansNs << ","
+			<< copyNs / max(spansNs, 1e-9) << endl;
+		delete openBci;
+		openBci = NULL;
+	}
+	cout << (identical ? "same samples and spectra" : "MISMATCH") << endl;
+	ofExit(identical ? 0 : 1);
+}
+
+//--------------------------------------------------------------
+void ofApp::startStep(){
+	if (!emulator.setup("127.0.0.1", port, stepShields, Fs, nChan, format))
+	{
+		ofExit(1);
+		return;
+	}
+	emulator.start();
+	stepStart = ofGetElapsedTimef();
+	stepRunning = true;
+	measuring = false;
+}
+
+//--------------------------------------------------------------
+void ofApp::finishStep(){
+	float seconds = ofGetElapsedTimef() - measureStart;
+	double sentRate = (emulator.getSamplesSent() - lastSamplesSent) / seconds;
+	double deliveredRate = samplesDelivered / seconds;
+	double emulatorCpu = emulator.getCpuSeconds() - emulatorCpuStart;
+	double cpu = (getProcessCpuSeconds() - cpuStart - emulatorCpu) / seconds * 100. / stepShields;
+
+	uint64_t dropped = 0;
+	uint64_t p99 = 0;
+	for (int h = 0; h < openBci->getHeadsetCount(); h++)
+	{
+		dropped += openBci->getOverflowStats(h).droppedSamples;
+		p99 = max(p99, openBci->getInstrumentation(h).stages[OFX_OPENBCI_WIFI_STAGE_DELIVERY].p99Micros);
+	}
+	dropped -= droppedStart;
+	ofxOpenBciWifiLatencyStats latency = openBci->getSampleEventLatency();
+
+	bool sustainable = deliveredRate >= 0.99 * stepShields * Fs && dropped == 0;
+	cout << stepShields << "," << Fs << "," << sentRate << "," << deliveredRate << "," << dropped << "," << cpu << ","
+		<< latency.meanMicros << "," << p99 << "," << latency.maxMicros << "," << (sustainable ? "yes" : "no") << endl;
+
+	emulator.close();
+	stepRunning = false;
+
+	if (sustainable)
+	{
+		maxSustainable = stepShields;
+		maxSustainableCpu = cpu;
+	}
+	if (!sustainable || stepShields >= maxShields)
+	{
+		cout << "Max sustainable: " << maxSustainable << " headsets x " << Fs << " Hz ("
+			<< maxSustainable * Fs << " samples/s), " << maxSustainableCpu << " % cpu per headset" << endl;
+		ofExit(0);
+		return;
+	}
+	stepShields = min(stepShields * 2, maxShields);
+}
+
+//--------------------------------------------------------------
+void ofApp::onSamples(ofxOpenBciWifiSamplesEventArgs& args){
+	// Runs on the receiver's processing thread
+	samplesDelivered += args.samples.size();
+}
+
+//--------------------------------------------------------------
+void ofApp::onCheckSamples(ofxOpenBciWifiSamplesEventArgs& args){
+	// Interleaved, only the headset's channels
+	if (args.headset >= checkSamples.size())
+	{
+		checkSamples.resize(args.headset + 1);
+	}
+	vector<float>& samples = checkSamples.at(args.headset);
+	for (size_t s = 0; s < args.samples.size(); s++)
+	{
+		for (int ch = 0; ch < args.samples.nChannels; ch++)
+		{
+			samples.push_back(args.samples.at(s, ch));
+		}
+	}
+	samplesDelivered += args.samples.size();
+}
+
+//--------------------------------------------------------------
+void ofApp::onCheckFft(ofxOpenBciWifiFftEventArgs& args){
+	if (args.headset >= checkFft.size())
+	{
+		checkFft.resize(args.headset + 1);
+		checkFftSamples.resize(args.headset + 1);
+	}
+	for (int ch = 0; ch < args.fft->size(); ch++)
+	{
+		checkFft.at(args.headset).insert(checkFft.at(args.headset).end(), args.fft->at(ch).begin(), args.fft->at(ch).end());
+	}
+	size_t nChannels = max(args.fft->size(), (size_t)1);
+	checkFftSamples.at(args.headset).push_back(args.headset < checkSamples.size() ? checkSamples.at(args.headset).size() / nChannels : 0);
+}
+
+//--------------------------------------------------------------
+double ofApp::getProcessCpuSeconds(){
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+//--------------------------------------------------------------
+void ofApp::exit(){
+	emulator.close();
+	if (openBci != NULL)
+	{
+		ofRemoveListener(openBci->newSamplesEvent, this, &ofApp::onSamples);
+		delete openBci;
+	}
+}
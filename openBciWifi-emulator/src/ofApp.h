@@ -0,0 +1,86 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOpenBciWifi.h"
+#include "ofxOpenBciWifiEmulator.h"
+
+class ofApp : public ofBaseApp{
+
+	public:
+		ofApp(vector<string> args);
+
+		void setup();
+		void update();
+		void exit();
+
+		void setupReplay();
+		void runJsonBenchmark();
+		void runDecoderCheck();
+		void runCodecBenchmark();
+		void runBatchBenchmark();
+		void runPsdBenchmark();
+		void runKernelBenchmark();
+		void runFilterBenchmark();
+		void runAccessorBenchmark();
+		void startStep();
+		void finishStep();
+		void onSamples(ofxOpenBciWifiSamplesEventArgs& args);
+		void onCheckSamples(ofxOpenBciWifiSamplesEventArgs& args);
+		void onCheckFft(ofxOpenBciWifiFftEventArgs& args);
+		double getProcessCpuSeconds();
+
+		// ** Options **
+		string host;
+		int port;
+		int nShields;
+		int Fs;
+		int nChan;
+		ofxOpenBciWifiDataFormat format;
+		float gapSeconds;				// Injected into one shield every injectInterval, 0 = off
+		float burstSeconds;
+		float injectInterval;
+		bool benchmark;
+		float stepSeconds;
+		int maxShields;
+		string replayPath;				// Capture or data log to push through the pipeline
+		float replaySpeed;
+		bool decoderCheck;				// Raw packet decoder against packet fixtures
+		bool jsonBenchmark;				// Incremental JSON parser against the ofxJSON split / DOM path
+		string codecPath;				// Recording to compress and decompress
+		vector<string> batchPaths;		// Captures or recordings to reprocess offline
+		int batchThreads;				// Most threads to scale to, 0 = one per core
+		bool psdBenchmark;				// Cost and variance of the spectrum estimators
+		bool kernelBenchmark;			// Channel count specialized loops against the generic ones
+		bool filterBenchmark;			// Filter bank against a scalar biquad chain
+		bool accessorBenchmark;			// Copying accessors against the spans and references, per app frame
+
+		ofxOpenBciWifiEmulator emulator;
+		ofxOpenBciWifi* openBci;		// Receiver in the same process, benchmark and replay only
+		shared_ptr<ofxOpenBciWifiReplaySource> replay;
+		float replayStart;
+		float replayFinished;
+
+		float lastReport;
+		float lastInject;
+		int nInjected;
+		uint64_t lastSamplesSent;
+		uint64_t lastBytesSent;
+
+		// ** Benchmark step **
+		int stepShields;
+		bool stepRunning;
+		bool measuring;
+		float stepStart;
+		float measureStart;
+		double cpuStart;
+		double emulatorCpuStart;
+		uint64_t droppedStart;
+		atomic<uint64_t> samplesDelivered;
+
+		// ** Batch check, by headset of the replaying receiver **
+		vector<vector<float>> checkSamples;			// Samples x Channels
+		vector<vector<float>> checkFft;				// Spectra x Channels x Bins
+		vector<vector<uint64_t>> checkFftSamples;	// Samples in when each spectrum arrived
+		int maxSustainable;
+		float maxSustainableCpu;
+};
@@ -5,7 +5,7 @@ void ofApp::setup(){
 
 	// ** Setup OpenBCI **
 	openBci.setTcpPort(3000);
-	openBci.enableDataLogging(ofToDataPath(ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".log"));
+	openBci.enableDataLogging(ofToDataPath(ofGetTimestampString("%Y-%m-%d-%H-%M-%S") + ".obw"));
 
 	// ** Setup oscilloscopes **
 	nHeadsets = 2;
@@ -64,12 +64,8 @@ void ofApp::setup(){
 		}
 	}
 
-	lastFftMillis.resize(nHeadsets);
-	fftDelay.resize(nHeadsets);
-	for (int i = 0; i < lastFftMillis.size(); i++)
-	{
-		lastFftMillis.at(i) = ofGetElapsedTimeMillis();
-	}
+	// Measure the pipeline and log a summary every 10 seconds
+	openBci.enableInstrumentation(10.f);
 
 	isPaused = false;
 	selectedScope = 0;
@@ -89,34 +85,36 @@ void ofApp::update(){
 
 	stringData = openBci.getStringData();
 
-	vector<string> ipAddresses = openBci.getHeadsetIpAddresses();
-	for (int h = 0; h < ipAddresses.size() && h < nHeadsets; h++)
+	for (int h = 0; h < openBci.getHeadsetCount() && h < nHeadsets; h++)
 	{
 		if (debugLoggingEnabled)
 		{
 			debugLogger.push(stringData.at(h) + "\n");
 		}
 
-		vector<vector<float>> tempData = openBci.getData(ipAddresses.at(h));
-		vector<vector<float>> tempFftData;
-		if (openBci.isFftNew(ipAddresses.at(h)))
-		{
-			tempFftData = openBci.getLatestFft(ipAddresses.at(h));
-
-			fftDelay.at(h) = ofGetElapsedTimeMillis() - lastFftMillis.at(h);
-			lastFftMillis.at(h) = ofGetElapsedTimeMillis();
-		}
+		// Read the published samples in place, headsets are addressed by their handle
+		ofxOpenBciWifiSampleSpans spans;
+		openBci.getDataSpans(h, spans);
+		bool fftNew = openBci.isFftNew(h);
 
-		for (int ch = 0; ch < tempData.size() && ch < nChan; ch++)
+		for (int ch = 0; ch < spans.nChannels && ch < nChan; ch++)
 		{
 			if (!isPaused)
 			{
-				scopeWins.at(h).scopes.at(ch).updateData(tempData.at(ch));
+				ofxOpenBciWifiChannelSpan channel = spans.channel(ch);
+				scopeData.resize(channel.size());
+				for (size_t s = 0; s < channel.size(); s++)
+				{
+					scopeData.at(s) = channel[s];
+				}
+				scopeWins.at(h).scopes.at(ch).updateData(scopeData);
 
-				if (openBci.isFftNew(ipAddresses.at(h)))
+				if (fftNew)
 				{
-					tempFftData.at(ch).resize(nFftBins);
-					scopeFftWins.at(h).scopes.at(ch).updateData(tempFftData.at(ch));
+					const vector<float>& fft = openBci.getLatestFft(h).at(ch);
+					fftData.assign(fft.begin(), fft.begin() + min((int)fft.size(), nFftBins));
+					fftData.resize(nFftBins);
+					scopeFftWins.at(h).scopes.at(ch).updateData(fftData);
 				}
 			}
 		}
@@ -129,7 +127,7 @@ void ofApp::draw(){
 	ofDrawBitmapString("ofxOpenBciWifi Example\nconnect on port: " + ofToString(openBci.getTcpPort()), 10, 20);
 
 	ofDrawBitmapString("Frame Rate (Hz): " + ofToString(ofGetFrameRate()) + 
-		"\nFFT Buffer Fill Rates (Hz): " + ofToString(1000.f / fftDelay.at(0)) + ", " + ofToString(1000.f / fftDelay.at(1)), ofGetWindowSize().x / 2, 20);
+		"\nFFT Buffer Fill Rates (Hz): " + ofToString(openBci.getInstrumentation(0).fftFramesPerSecond) + ", " + ofToString(openBci.getInstrumentation(1).fftFramesPerSecond), ofGetWindowSize().x / 2, 20);
 	
 	int yDraw = yTop - 7;
 	vector<string> ipAddresses = openBci.getHeadsetIpAddresses();
@@ -142,10 +140,10 @@ void ofApp::draw(){
 	ofDrawBitmapString("FFT", ofGetWindowSize().x / 2 + ofGetWindowSize().x / 2 * 3 / 4 + xGap, yDraw);
 	for (int h = 0; h < nHeadsets; h++)
 	{
-		if (ipAddresses.size() > h)
+		if (openBci.getHeadsetCount() > h)
 		{
-			string stringData = openBci.getStringData(ipAddresses.at(h));
-			ofDrawBitmapString(ipAddresses.at(h) + " JSON: " + stringData, 10, 50 + 15 * h);
+			string stringData = openBci.getStringData(h);
+			ofDrawBitmapString(openBci.getHeadsetIpAddress(h) + " JSON: " + stringData, 10, 50 + 15 * h);
 		}
 		// OpenBCI Headset Data: ip
 		// FFT
@@ -30,12 +30,11 @@ class ofApp : public ofBaseApp{
 		vector<ofxMultiScope> scopeWins;
 		vector<ofxMultiScope> scopeFftWins;
 		vector<string> stringData;
+		vector<float> scopeData;		// Reused for each channel handed to the scopes
+		vector<float> fftData;
 
 		int nFftBins;
 
-		vector<uint64_t> lastFftMillis;
-		vector<float> fftDelay;
-
 		float xGap;
 		float yTop;
 
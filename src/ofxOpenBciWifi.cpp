@@ -13,9 +13,12 @@
 ofxOpenBciWifi::ofxOpenBciWifi(int samplingFreq)
 {
 	_tcpPort = 3000;
-	_messageDelimiter = "\r\n";
-	TCP.setMessageDelimiter(_messageDelimiter);
-	TCP.setup(_tcpPort);
+	_tcpSource = make_shared<ofxOpenBciWifiTcpSource>();
+	_tcpSource->setup(_tcpPort);
+	_source = _tcpSource;
+	_requestedSource = _tcpSource;
+	_tcpSetupRequested = false;
+	_receiveBuffer = NULL;
 
 	_verboseOutput = false;
 	if (_verboseOutput)
@@ -26,42 +29,72 @@ ofxOpenBciWifi::ofxOpenBciWifi(int samplingFreq)
 	_loggingEnabled = false;
 	_nHeadsets = 0;
 
-	_Fs = samplingFreq;
-	_fftEnabled = true;
-	_fftWindowSize = _Fs;
-	_fftOverlap = _fftWindowSize / 2;
-	_fftBuffersize = _fftWindowSize * 2;
+	_dataFormat = OFX_OPENBCI_WIFI_FORMAT_JSON;
+	_bufferPool.reserve(16);
+	_overflowPolicy = OFX_OPENBCI_WIFI_OVERFLOW_DROP_OLDEST;
+	_discardBuffer.resize(_bufferPool.getChunkSize());
 
-	_stringBufferLen = 200 * _Fs * 30; // charPerSample x Fs x Seconds
+	_defaultConfig.Fs = samplingFreq;
+	_defaultConfig.fftWindowSize = 0;
+	_defaultConfig.fftHopSize = 0;
+	_defaultConfig.fftWindow = OF_FFT_WINDOW_HAMMING;
+	_efficientFftSizesEnabled = false;
+	_fftEnabled = true;
 
-	_fft = ofxFft::create(_fftWindowSize, OF_FFT_WINDOW_HAMMING);
+	_samples.reserve(samplingFreq);
+	_frameBlock.reserve(samplingFreq * OFX_OPENBCI_WIFI_MAX_CHANNELS);
 
 	_hpFiltEnabled = true;
 	_hpFiltFreq = 1.f;
+	_hpFiltOrder = 2;
+	_hpFiltFamily = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH;
+	_hpFiltRipple = 0.5f;
 	_notchFiltEnabled = true;
 	_notchFiltFreq = 60.f;
+	_notchFiltHarmonics = 1;
+	_notchFiltQ = 0.7071f;
 	_lpFiltEnabled = false;
 	_lpFiltFreq = 50.f;
+	_lpFiltOrder = 2;
+	_lpFiltFamily = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH;
+	_lpFiltRipple = 0.5f;
+
+	_montageEnabled = false;
+	_montageBeforeFilters = true;
+
+	_bandPowerEnabled = false;
+	_bandWindowSeconds = 1.f;
+	_bandUpdateInterval = 1;
 
 	_fftSmoothingEnabled = true;
 	//_fftSmoothingNwin = 7;
 	_fftSmoothingNewDataWeight = 0.25f;
 
-	_lastLoopTime = ofGetElapsedTimeMicros();
+	_threadedProcessingEnabled = false;
+	_sampleBlockSize = 1;
+	_sampleEventLatency = ofxOpenBciWifiLatencyStats();
+
+	_instrumentationEnabled = false;
+	_instrumentationDumpInterval = 0;
+	_lastInstrumentationDump = 0;
 
 	startThread();
 }
 
 ofxOpenBciWifi::~ofxOpenBciWifi() {
 	waitForThread(true);
+	_capture.close();
+	_recorder.close();
 }
 
 void ofxOpenBciWifi::setTcpPort(int port)
 {
 	// ToDo: add error checking
-	_tcpPort = port;
 	lock();
-	TCP.setup(_tcpPort);
+	// The network thread may be waiting on the old socket, so it rebinds between waits
+	_tcpPort = port;
+	_requestedSource = _tcpSource;
+	_tcpSetupRequested = true;
 	unlock();
 }
 
@@ -70,29 +103,138 @@ int ofxOpenBciWifi::getTcpPort()
 	return _tcpPort;
 }
 
+void ofxOpenBciWifi::setSource(shared_ptr<ofxOpenBciWifiSource> source)
+{
+	lock();
+	_requestedSource = source;
+	_tcpSetupRequested = false;
+	unlock();
+}
+
+shared_ptr<ofxOpenBciWifiSource> ofxOpenBciWifi::getSource()
+{
+	lock();
+	shared_ptr<ofxOpenBciWifiSource> source = _requestedSource;
+	unlock();
+	return source;
+}
+
+void ofxOpenBciWifi::setDataFormat(ofxOpenBciWifiDataFormat format)
+{
+	lock();
+	ofScopedLock processingLock(_processingMutex);
+	_dataFormat = format;
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		// Bytes already buffered belong to the old format
+		_bufferPool.release(_byteQueueWrite.at(h));
+		_bufferPool.release(_byteQueueProcess.at(h));
+		_jsonParsers.at(h).reset();
+		_rawDecoders.at(h).reset();
+	}
+	unlock();
+}
+
+ofxOpenBciWifiDataFormat ofxOpenBciWifi::getDataFormat()
+{
+	return _dataFormat;
+}
+
 int ofxOpenBciWifi::getHeadsetCount()
 {
-	return _nHeadsets;
+	return _ipAddressesRead.size();
 }
 
 vector<string> ofxOpenBciWifi::getHeadsetIpAddresses()
 {
-	return _ipAddresses;
+	return _ipAddressesRead;
+}
+
+int ofxOpenBciWifi::getHeadset(string ipAddress)
+{
+	map<string, int>::iterator it = _headsetsRead.find(ipAddress);
+	if (it == _headsetsRead.end())
+	{
+		return OFX_OPENBCI_WIFI_INVALID_HEADSET;
+	}
+	return it->second;
+}
+
+string ofxOpenBciWifi::getHeadsetIpAddress(int headset)
+{
+	if (headset < 0 || headset >= _ipAddressesRead.size())
+	{
+		return "";
+	}
+	return _ipAddressesRead.at(headset);
 }
 
-void ofxOpenBciWifi::enableDataLogging(string filePath)
+void ofxOpenBciWifi::enableDataLogging(string filePath, bool compress)
 {
-	_logger.setDirPath("");
-	_logger.setFilename(filePath);
-	_logger.startThread();
-	_logger.push("ip,timestamps,sample_numbers,count,data0,...,dataN\n");
-	_loggingEnabled = true;
+	ofScopedLock processingLock(_processingMutex);
+	_recorder.close();
+	if (compress)
+	{
+		_recorder.enableCompression();
+	}
+	else
+	{
+		_recorder.disableCompression();
+	}
+	_loggingEnabled = _recorder.open(filePath);
+	// Every headset starts the recording with its config
+	_recordedConfigs.assign(_nHeadsets, ofxOpenBciWifiRecordingConfig());
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		_recordedConfigs.at(h).nChannels = -1;
+	}
 }
 
 void ofxOpenBciWifi::disableDataLogging()
 {
+	ofScopedLock processingLock(_processingMutex);
 	_loggingEnabled = false;
-	_logger.stopThread();
+	_recorder.close();
+}
+
+ofxOpenBciWifiRecordingConfig ofxOpenBciWifi::getRecordingConfig(int h)
+{
+	ofxOpenBciWifiRecordingConfig config;
+	memset(&config, 0, sizeof(config));
+	config.Fs = _headsetConfigs.at(h).Fs;
+	config.nChannels = _nChannels.at(h);
+	config.dataFormat = _dataFormat;
+	config.hpFiltEnabled = _hpFiltEnabled;
+	config.notchFiltEnabled = _notchFiltEnabled;
+	config.lpFiltEnabled = _lpFiltEnabled;
+	config.hpFiltFreq = _hpFiltFreq;
+	config.notchFiltFreq = _notchFiltFreq;
+	config.lpFiltFreq = _lpFiltFreq;
+	config.montageEnabled = _montageEnabled;
+	strncpy(config.ipAddress, _ipAddresses.at(h).c_str(), sizeof(config.ipAddress) - 1);
+	return config;
+}
+
+void ofxOpenBciWifi::enableCapture(string filePath)
+{
+	lock();
+	uint64_t now = ofGetElapsedTimeMicros();
+	if (_capture.open(filePath, now))
+	{
+		// Headsets that are already streaming
+		for (int h = 0; h < _nHeadsets; h++)
+		{
+			_capture.writeConnect(h, _ipAddresses.at(h), now);
+		}
+	}
+	unlock();
+}
+
+void ofxOpenBciWifi::disableCapture()
+{
+	lock();
+	_capture.close();
+	unlock();
 }
 
 void ofxOpenBciWifi::swapStringData()
@@ -103,442 +245,1318 @@ void ofxOpenBciWifi::swapStringData()
 void ofxOpenBciWifi::threadedFunction()
 {
 	while (isThreadRunning()) {
+		// Sleep until the source has something. Only this thread touches the source, so it
+		// can't be closed or set up again in the middle of a wait.
 		lock();
-		for (int h = 0; h < _nHeadsets; h++) {
-			if (_stringDataWrite.at(h).size() > _stringBufferLen)
-			{
-				// Clear string data before it blows up your RAM
-				_stringDataWrite.at(h).clear();
-			}
-		}
+		applySourceRequest();
+		shared_ptr<ofxOpenBciWifiSource> source = _source;
+		unlock();
+		source->wait(10);
 
+		lock();
 		readIncomingData();
+
+		bool threadedProcessing = _threadedProcessingEnabled;
+		if (threadedProcessing)
+		{
+			_processingMutex.lock();
+			takeReceivedData();
+		}
 		unlock();
-		// Debug timing code
-		//_loopTimes.push_back(ofGetElapsedTimeMicros() - _lastLoopTime);
-		//_lastLoopTime = ofGetElapsedTimeMicros();
-		sleep(1);
+
+		if (threadedProcessing)
+		{
+			// Process on this thread so samples flow in continuously instead of once per frame
+			processHeadsets();
+			_processingMutex.unlock();
+		}
 	}
 }
 
 void ofxOpenBciWifi::readIncomingData()
 {
-	for (unsigned int i = 0; i < (unsigned int)TCP.getLastID(); i++)
+	_source->dispatch(*this);
+}
+
+void ofxOpenBciWifi::applySourceRequest()
+{
+	// Called with lock() held, on the network thread
+	if (_requestedSource != _source)
+	{
+		// Frees the port when replaying
+		_source->close();
+		_source = _requestedSource;
+	}
+	if (_tcpSetupRequested)
 	{
-		int h = -1;		// Headset number
-		if (!TCP.isClientConnected(i))continue;
-		
-		// get the ip and port of the client
-		string port = ofToString(TCP.getClientPort(i));
-		string ip = TCP.getClientIP(i);
+		_tcpSource->setup(_tcpPort);
+		_tcpSetupRequested = false;
+	}
+}
 
-		// Match the tcp client to the stored ipAddresses or add a new address
-		for (int ipNum = 0; ipNum < _ipAddresses.size(); ipNum++)
-		{
-			if (_ipAddresses.at(ipNum).compare(ip) == 0)
-			{
-				h = ipNum;
-			}
-		}
-		if (h == -1)
+int ofxOpenBciWifi::findHeadset(const string& ip, int samplingFreq)
+{
+	// Match the tcp client to the stored ipAddresses or add a new address
+	for (int ipNum = 0; ipNum < _ipAddresses.size(); ipNum++)
+	{
+		if (_ipAddresses.at(ipNum).compare(ip) == 0)
 		{
-			// we didn't find a match to the current ip, so add it
-			h = _ipAddresses.size();
-			addHeadset(ip);
+			return ipNum;
 		}
-
-		// receive all the available messages, separated by _messageDelimiter
-		string tmp;
-		do {
-			_stringDataWrite.at(h) = _stringDataWrite.at(h) + tmp;
-			tmp = TCP.receive(i);
-		} while (tmp != "");
-		bool debugTest = true;
 	}
+
+	// we didn't find a match to the current ip, so add it
+	addHeadset(ip, samplingFreq);
+	return _ipAddresses.size() - 1;
 }
 
-void ofxOpenBciWifi::update()
+int ofxOpenBciWifi::onConnect(const string& ip, int samplingFreq)
 {
-	clearDataVectors();
-
-	lock();
-	for (unsigned int h = 0; h < _nHeadsets; h++)
+	int h = findHeadset(ip, samplingFreq);
+	if (_capture.isOpen())
 	{
-		_stringDataRead.at(h) = _stringDataWrite.at(h);
-		_stringDataWrite.at(h).clear();
+		_capture.writeConnect(h, ip, ofGetElapsedTimeMicros());
 	}
-	unlock();
+	return h;
+}
 
-	for (unsigned int h = 0; h < _nHeadsets; h++)
+char* ofxOpenBciWifi::getReceiveBuffer(int headset, size_t& nBytes)
+{
+	ofxOpenBciWifiByteQueue& queue = _byteQueueWrite.at(headset);
+	_discarding.at(headset) = false;
+	size_t maxBytes = _stringBufferLens.at(headset);
+	if (queue.size() >= maxBytes)
 	{
-		if (_stringDataRead.at(h).size() == 0)
+		// Keep the received data bounded before it blows up your RAM
+		ofxOpenBciWifiOverflowStats& stats = _overflowStats.at(headset);
+		if (!_overflowing.at(headset))
 		{
-			continue;
+			_overflowing.at(headset) = true;
+			stats.overflowEvents++;
 		}
 
-		if (_verboseOutput)
+		switch (_overflowPolicy)
 		{
-			ofLogVerbose("ofxOpenBciWifi") << _stringDataRead.at(h);
-		}
-
-		// Split the string by "chunk"
-		vector<string> result = ofSplitString(_stringDataRead.at(h), "{\"chunk\":");
-		for (int r = 1; r < result.size(); r++)
-		{
-			// Add back "chunk"
-			result.at(r) = "{\"chunk\":" + result.at(r);
-			bool success = json.parse(result.at(r));
-			if (!success)
-			{
-				bool debugStop = true;
-			}
-			else
+		case OFX_OPENBCI_WIFI_OVERFLOW_DROP_OLDEST:
+			while (queue.size() >= maxBytes)
 			{
-				int nSamples = 0;
-				try {
-					nSamples = json["chunk"].size();
-				}
-				catch (exception e) {}
-
-
-				vector<int> writePosition; // Data write position (should only need single value instead of vector if everything works properly)
-				if (nSamples > 0)
-				{
-					try {
-						// Check the number of data channels
-						int tmp = json["chunk"][0]["data"].size();
-						if (tmp > _nChannels.at(h)) {
-							// Number of channels has changed
-							_nChannels.at(h) = tmp;
-
-							// resize data vector channel size	 
-							_data.at(h).resize(_nChannels.at(h));
-
-							// Resize the fft vectors
-							_fftBuffer.at(h).resize(_nChannels.at(h));
-							_latestFft.at(h).resize(_nChannels.at(h));
-
-							// Create filters for each channel
-							_filterHP.at(h).resize(_nChannels.at(h));
-							_filterNotch.at(h).resize(_nChannels.at(h));
-							_filterLP.at(h).resize(_nChannels.at(h));
-
-							sample_numbers.at(h).resize(2);
-							sample_numbers.at(h).at(0) = 255;
-							sample_numbers.at(h).at(1) = 255;
-							for (int ch = 0; ch < _nChannels.at(h); ch++)
-							{
-								_fftBuffer.at(h).at(ch).resize(_fftBuffersize);
-								_latestFft.at(h).at(ch).resize(_fftWindowSize / 2);
-
-								// This will reset all filters when the number of channels changes
-								_filterHP.at(h).at(ch) = ofxBiquadFilter1f(OFX_BIQUAD_TYPE_HIGHPASS, _hpFiltFreq / _Fs, 0.7071);
-								_filterNotch.at(h).at(ch) = ofxBiquadFilter1f(OFX_BIQUAD_TYPE_NOTCH, _notchFiltFreq / _Fs, 0.7071);
-								_filterLP.at(h).at(ch) = ofxBiquadFilter1f(OFX_BIQUAD_TYPE_LOWPASS, _lpFiltFreq / _Fs, 0.7071);
-							}
-						}
-					}
-					catch (exception e) 
-					{
-						bool debug = 1;
-					}
-
-					writePosition.resize(_nChannels.at(h));
-
-					// resize data vector to fit new samples
-					for (int ch = 0; ch < _nChannels.at(h); ch++)
-					{
-						writePosition.at(ch) = _data.at(h).at(ch).size();
-						_data.at(h).at(ch).resize(writePosition.at(ch) + nSamples);
-					}
-				}
-
-				for (int s = 0; s < nSamples; s++)
-				{
-					if (_loggingEnabled)
-					{
-						try {
-							_logger.push(_ipAddresses.at(h) + ",");
-							_logger.push(json["chunk"][s]["timestamp"].asString() + ",");
-							_logger.push(json["chunk"][s]["sampleNumber"].asString() + ",");
-							sample_numbers.at(h).at(0) = sample_numbers.at(h).at(1);
-							sample_numbers.at(h).at(1) = json["chunk"][s]["sampleNumber"].asInt();
-							if ((sample_numbers.at(h).at(1) - sample_numbers.at(h).at(0)) >= 2)
-							{
-								bool debug = true;
-							}
-							_logger.push(json["count"].asString() + ",");
-						}
-						catch (exception e) {}
-					}
-
-					for (int ch = 0; ch < _nChannels.at(h); ch++)
-					{
-						int wp = writePosition.at(ch) + s;
-						try {
-							_data.at(h).at(ch).at(wp) = json["chunk"][s]["data"][ch].asFloat();
-
-							// Filter data
-							if (_hpFiltEnabled)
-							{
-								_data.at(h).at(ch).at(wp) = _filterHP.at(h).at(ch).update(_data.at(h).at(ch).at(wp));
-							}
-							if (_notchFiltEnabled)
-							{
-								_data.at(h).at(ch).at(wp) = _filterNotch.at(h).at(ch).update(_data.at(h).at(ch).at(wp));
-							}
-							if (_lpFiltEnabled)
-							{
-								_data.at(h).at(ch).at(wp) = _filterLP.at(h).at(ch).update(_data.at(h).at(ch).at(wp));
-							}
-
-							// Log data
-							if (_loggingEnabled)
-							{
-								_logger.push(ofToString(_data.at(h).at(ch).at(wp)) + ",");
-							}
-
-							if (_fftEnabled)
-							{
-								// Fill up the FFT buffer
-								_fftBuffer.at(h).at(ch).at(_fftWritePos.at(h)) = _data.at(h).at(ch).at(wp);
-							}
-						}
-						catch (exception e) {
-							bool debug = true;
-						}
-					}
-					if (_loggingEnabled)
-					{
-						_logger.push("\n");
-					}
-
-					if (_fftEnabled && _nChannels.at(h))
-					{
-						_fftWritePos.at(h)++;
-						//if (_fftWritePos >= _fftReadPos + _fftWindowSize)
-						if (_fftWritePos.at(h) == _fftReadPos.at(h) + _fftWindowSize)
-						{
-							for (int ch = 0; ch < _nChannels.at(h); ch++)
-							{
-								// If the buffer is full, perform FFT
-								_fft->setSignal(&_fftBuffer.at(h).at(ch).at(_fftReadPos.at(h)));
-
-								float* curFft = _fft->getAmplitude();
-
-								for (int n = 0; n < _fftWindowSize / 2; n++)
-								{
-									if (isfinite(_latestFft.at(h).at(ch).at(n)))
-									{
-										if (_fftSmoothingEnabled)
-										{
-											// Smooth the FFT over time so that after X windows only 20% "legacy" influence remains
-											//float newDataWeight = 1.f - pow(10, log10(0.2) / _fftSmoothingNwin);
-											// Calculate the FFT power in dB for easier viewing
-											_latestFft.at(h).at(ch).at(n) = smooth(10.f * log10(curFft[n]), _latestFft.at(h).at(ch).at(n), _fftSmoothingNewDataWeight);
-										}
-										else
-										{
-											_latestFft.at(h).at(ch).at(n) = 10.f * log10(curFft[n]);
-										}
-									}
-									else
-									{
-										// Handle case when fftData runs off into the weeds
-										_latestFft.at(h).at(ch).at(n) = 10.f * log10(curFft[n]);
-									}
-								}
-							}
-
-							// Set fft buffer write position and read position
-							if (_fftReadPos.at(h) + 2*_fftWindowSize - _fftOverlap - 1 <= _fftBuffersize)
-							{
-								_fftReadPos.at(h) = _fftReadPos.at(h) + _fftWindowSize - _fftOverlap;
-							}
-							else
-							{
-								for (int ch = 0; ch < _nChannels.at(h); ch++)
-								{
-									// FFT buffer is running out. Shift back to the beginning.
-									// Test Code
-									//_fftBuffer.at(h).at(ch).at(_fftReadPos.at(h) + _fftWindowSize - _fftOverlap) = 1000000000;
-									//_fftBuffer.at(h).at(ch).at(_fftReadPos.at(h) + _fftWindowSize - 1) = 1000000000;
-									copy(_fftBuffer.at(h).at(ch).begin() + _fftReadPos.at(h) + _fftWindowSize - _fftOverlap,
-										_fftBuffer.at(h).at(ch).begin() + _fftReadPos.at(h) + _fftWindowSize,
-										_fftBuffer.at(h).at(ch).begin());
-								}
-								_fftReadPos.at(h) = 0;
-								_fftWritePos.at(h) = _fftReadPos.at(h) + _fftWindowSize - _fftOverlap;
-
-							}
-
-							_newFftReady.at(h) = true;
-						}
-					}
-				}
+				ofxOpenBciWifiChunk* chunk = queue.popFront();
+				stats.droppedBytes += chunk->size;
+				_bufferPool.release(chunk);
 			}
+			queue.markDiscontinuity();
+			break;
+		case OFX_OPENBCI_WIFI_OVERFLOW_DROP_NEWEST:
+			// Drain the socket into the discard buffer
+			_discarding.at(headset) = true;
+			nBytes = _discardBuffer.size();
+			_receiveBuffer = _discardBuffer.data();
+			return _receiveBuffer;
+		case OFX_OPENBCI_WIFI_OVERFLOW_BLOCK:
+			nBytes = 0;
+			return NULL;
 		}
 	}
+	else
+	{
+		_overflowing.at(headset) = false;
+	}
+	_receiveBuffer = queue.getWriteBuffer(_bufferPool, nBytes);
+	return _receiveBuffer;
 }
 
-float ofxOpenBciWifi::smooth(float newData, float oldData, float newDataWeight)
+void ofxOpenBciWifi::onReceive(int headset, size_t nBytes)
 {
-	return newData * newDataWeight + oldData * (1.f - newDataWeight);
+	_bufferPool.addBytesReceived(nBytes);
+	if (_capture.isOpen())
+	{
+		_capture.writeData(headset, _receiveBuffer, nBytes, ofGetElapsedTimeMicros());
+	}
+	if (_discarding.at(headset))
+	{
+		_overflowStats.at(headset).droppedBytes += nBytes;
+		_byteQueueWrite.at(headset).markDiscontinuity();
+		return;
+	}
+	_byteQueueWrite.at(headset).commit(nBytes, ofGetElapsedTimeMicros());
 }
 
-void ofxOpenBciWifi::addHeadset(string ipAddress)
+void ofxOpenBciWifi::onDisconnect(int headset)
 {
-	_ipAddresses.push_back(ipAddress);
-	int sz = _ipAddresses.size();
-	_stringDataRead.resize(sz);
-	_stringDataWrite.resize(sz);
-	_data.resize(sz);
-	_filterHP.resize(sz);
-	_filterNotch.resize(sz);
-	_filterLP.resize(sz);
-	_latestFft.resize(sz);
-	_fftBuffer.resize(sz);
-	_nChannels.push_back(0);
-	_newFftReady.push_back(false);
-	_fftReadPos.push_back(0);
-	_fftWritePos.push_back(0);
-	_nHeadsets = sz;
-
-	sample_numbers.resize(sz);
-
-	ofLogNotice("ofxOpenBciWifi") << "Headset #" << sz << " detected: " << ipAddress;
+	ofLogNotice("ofxOpenBciWifi") << "Headset #" << headset + 1 << " disconnected: " << _ipAddresses.at(headset);
+	if (_capture.isOpen())
+	{
+		_capture.writeDisconnect(headset, ofGetElapsedTimeMicros());
+	}
 }
 
-vector<string> ofxOpenBciWifi::getStringData()
+void ofxOpenBciWifi::update()
 {
-	return _stringDataRead;
+	if (!_threadedProcessingEnabled)
+	{
+		lock();
+		_processingMutex.lock();
+		takeReceivedData();
+		unlock();
+		processHeadsets();
+		_processingMutex.unlock();
+	}
+
+	ofScopedLock processingLock(_processingMutex);
+	publishData();
 }
 
-string ofxOpenBciWifi::getStringData(string ipAddress)
+void ofxOpenBciWifi::takeReceivedData()
 {
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	for (int h = 0; h < _nHeadsets; h++)
 	{
-		if (ipAddress.compare(_ipAddresses.at(h)) == 0)
+		ofxOpenBciWifiByteQueue& queue = _byteQueueProcess.at(h);
+		ofxOpenBciWifiOverflowStats& stats = _overflowStats.at(h);
+		size_t maxBytes = _stringBufferLens.at(h);
+		stats.bytesHighWaterMark = max(stats.bytesHighWaterMark, queue.size() + _byteQueueWrite.at(h).size());
+
+		// Each take moves a partly filled tail chunk. The queue is empty unless processing is
+		// backing up, then they are packed together so the byte limit also bounds the chunks.
+		if (_overflowPolicy == OFX_OPENBCI_WIFI_OVERFLOW_DROP_OLDEST)
+		{
+			queue.append(_byteQueueWrite.at(h), _bufferPool);
+			if (queue.size() > maxBytes)
+			{
+				stats.overflowEvents++;
+				while (queue.size() > maxBytes)
+				{
+					ofxOpenBciWifiChunk* chunk = queue.popFront();
+					stats.droppedBytes += chunk->size;
+					_bufferPool.release(chunk);
+				}
+				queue.markDiscontinuity();
+			}
+		}
+		else if (queue.size() < maxBytes)
 		{
-			return _stringDataRead.at(h);
+			// Otherwise leave the bytes with the network thread so its policy applies
+			queue.append(_byteQueueWrite.at(h), _bufferPool);
 		}
 	}
 }
 
-vector<vector<float>> ofxOpenBciWifi::getData(string ipAddress)
+void ofxOpenBciWifi::processHeadsets()
 {
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	for (int h = 0; h < _nHeadsets; h++)
 	{
-		if (ipAddress.compare(_ipAddresses.at(h)) == 0)
+		processHeadset(h);
+	}
+
+	// Transform every window that filled during this pass in one batch
+	bool instrument = _instrumentationEnabled;
+	uint64_t fftStart = instrument ? ofGetElapsedTimeMicros() : 0;
+	_fftEngine.run(_fftSmoothingEnabled, _fftSmoothingNewDataWeight);
+	uint64_t fftTime = instrument ? ofGetElapsedTimeMicros() - fftStart : 0;
+
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		if (_fftEventPending.at(h))
 		{
-			return _data.at(h);
+			if (instrument)
+			{
+				// The batch is shared, so each headset in it is charged the whole batch
+				_instrumentation.at(h).record(OFX_OPENBCI_WIFI_STAGE_FFT, fftTime);
+			}
+			_fftEventPending.at(h) = false;
+			ofxOpenBciWifiFftEventArgs args;
+			args.headset = h;
+			args.fft = &_latestFftWrite.at(h);
+			ofNotifyEvent(newFftEvent, args);
 		}
 	}
-}
 
-vector<vector<float>> ofxOpenBciWifi::getLatestFft(string ipAddress)
-{
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	if (instrument && _instrumentationDumpInterval > 0)
 	{
-		if (ipAddress.compare(_ipAddresses.at(h)) == 0)
+		uint64_t now = ofGetElapsedTimeMicros();
+		if (now - _lastInstrumentationDump >= _instrumentationDumpInterval)
 		{
-			return _latestFft.at(h);
+			for (int h = 0; h < _nHeadsets; h++)
+			{
+				ofLogNotice("ofxOpenBciWifi") << "Headset #" << h + 1 << " " << _ipAddresses.at(h) << ": "
+					<< ofxOpenBciWifiInstrumentation::toString(_instrumentation.at(h).getSnapshot(now));
+				_instrumentation.at(h).reset(now);
+			}
+			_lastInstrumentationDump = now;
 		}
 	}
 }
 
-int ofxOpenBciWifi::getFftBinFromFrequency(float freq)
+void ofxOpenBciWifi::notifySamples(int h)
 {
-	return _fft->getBinFromFrequency(freq, _Fs);
+	vector<float>& block = _sampleBlocks.at(h);
+	ofxOpenBciWifiSamplesEventArgs args;
+	args.headset = h;
+	args.samples.first = &block[0];
+	args.samples.nFirst = block.size() / OFX_OPENBCI_WIFI_MAX_CHANNELS;
+	args.samples.second = NULL;
+	args.samples.nSecond = 0;
+	args.samples.nChannels = _nChannels.at(h);
+	args.samples.stride = OFX_OPENBCI_WIFI_MAX_CHANNELS;
+	args.receiveTime = _sampleBlockReceiveTimes.at(h);
+
+	uint64_t latency = ofGetElapsedTimeMicros() - args.receiveTime;
+	_sampleEventLatency.nBlocks++;
+	_sampleEventLatency.lastMicros = latency;
+	_sampleEventLatency.maxMicros = max(_sampleEventLatency.maxMicros, latency);
+	_sampleEventLatency.meanMicros += (latency - _sampleEventLatency.meanMicros) / _sampleEventLatency.nBlocks;
+
+	ofNotifyEvent(newSamplesEvent, args);
+	block.clear();
 }
 
-void ofxOpenBciWifi::clearDataVectors()
+void ofxOpenBciWifi::processHeadset(int h)
 {
-	for (int h = 0; h < _data.size(); h++)
+	ofxOpenBciWifiByteQueue& bytes = _byteQueueProcess.at(h);
+	if (bytes.empty())
+	{
+		return;
+	}
+
+	if (bytes.takeDiscontinuity())
+	{
+		// Received bytes were dropped, throw away any partial chunk or packet
+		_jsonParsers.at(h).reset();
+		_rawDecoders.at(h).reset();
+	}
+
+	// Unless the policy drops new samples, only parse what fits in the sample ring,
+	// the rest waits in the bounded byte queues
+	size_t ringSpace = _dataRings.at(h)->getWriteSpace();
+
+	// Pull the samples out of the received chunks or packets
+	bool instrument = _instrumentationEnabled;
+	uint64_t parseStart = instrument ? ofGetElapsedTimeMicros() : 0;
+	_samples.clear();
+	_sampleReceiveTimes.clear();
+	int nSamples = 0;
+	while (!bytes.empty())
+	{
+		ofxOpenBciWifiChunk* chunk = bytes.getHead();
+		size_t maxChunkSamples = chunk->size / OFX_OPENBCI_WIFI_RAW_PACKET_SIZE + 1;
+		if (_overflowPolicy != OFX_OPENBCI_WIFI_OVERFLOW_DROP_NEWEST && nSamples + maxChunkSamples > ringSpace)
+		{
+			break;
+		}
+		bytes.popFront();
+		if (instrument)
+		{
+			_instrumentation.at(h).record(OFX_OPENBCI_WIFI_STAGE_RECEIVE, parseStart - min(parseStart, chunk->receiveTime));
+			_instrumentation.at(h).addBytes(chunk->size);
+		}
+
+		if (_verboseOutput && _dataFormat == OFX_OPENBCI_WIFI_FORMAT_JSON)
+		{
+			ofLogVerbose("ofxOpenBciWifi") << string(chunk->data, chunk->size);
+		}
+
+		if (_dataFormat == OFX_OPENBCI_WIFI_FORMAT_RAW)
+		{
+			nSamples += _rawDecoders.at(h).parse(chunk->data, chunk->size, _samples);
+		}
+		else
+		{
+			nSamples += _jsonParsers.at(h).parse(chunk->data, chunk->size, _samples);
+		}
+		_bytesParsed.at(h) += chunk->size;
+		// Samples finished by this chunk count as received with it
+		_sampleReceiveTimes.resize(_samples.size(), chunk->receiveTime);
+
+		// Keep the received bytes for getStringData(), packed like the ones waiting to be parsed
+		// or a stalled update() would hold a mostly empty chunk per pass
+		_byteQueueProcessed.at(h).pushBack(chunk, _bufferPool);
+	}
+	_samplesParsed.at(h) += nSamples;
+	if (instrument)
 	{
-		//_stringDataRead.at(h).clear();
-		for (int ch = 0; ch < _data.at(h).size(); ch++)
+		_instrumentation.at(h).record(OFX_OPENBCI_WIFI_STAGE_PARSE, ofGetElapsedTimeMicros() - parseStart);
+		_instrumentation.at(h).addSamples(nSamples);
+		if (nSamples > 0 && _unpublishedReceiveTimes.at(h) == 0)
 		{
-			_data.at(h).at(ch).clear();			// Headsets x Channels x Sample
+			_unpublishedReceiveTimes.at(h) = _sampleReceiveTimes.front();
 		}
-		_newFftReady.at(h) = false;
 	}
-}
+	while (_byteQueueProcessed.at(h).size() > _stringBufferLens.at(h))
+	{
+		_bufferPool.release(_byteQueueProcessed.at(h).popFront());
+	}
 
-bool ofxOpenBciWifi::isFftNew(string ipAddress)
-{
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	const ofxOpenBciWifiHeadsetConfig& headsetConfig = _headsetConfigs.at(h);
+	// Check the number of data channels
+	if (nSamples > 0 && _samples[0].nChannels > _nInputChannels.at(h))
+	{
+		// Number of channels has changed
+		_nInputChannels.at(h) = _samples[0].nChannels;
+		setupChannels(h);
+	}
+
+	// Gather the block of frames and filter every channel at once
+	_frameBlock.resize(nSamples * OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	int nChannels = min(_nChannels.at(h), OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	ofxOpenBciWifiChannelKernels& kernels = _channelKernels.at(h);
+	if (nSamples > 0)
+	{
+		_inputKernels.at(h).gather(&_samples[0], nSamples, &_frameBlock[0], OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	}
+	ofxOpenBciWifiFilterBank& filters = _filterBanks.at(h);
+	filters.setEnabled(FILTER_HP, _hpFiltEnabled);
+	filters.setEnabled(FILTER_NOTCH, _notchFiltEnabled);
+	filters.setEnabled(FILTER_LP, _lpFiltEnabled);
+	if (nSamples > 0)
 	{
-		if (ipAddress.compare(_ipAddresses.at(h)) == 0)
+		// The montage re-references the block in place on one side of the filters
+		uint64_t filterStart = instrument ? ofGetElapsedTimeMicros() : 0;
+		if (_montageEnabled && _montageBeforeFilters)
+		{
+			_montages.at(h).process(&_frameBlock[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		}
+		filters.process(&_frameBlock[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		if (_montageEnabled && !_montageBeforeFilters)
+		{
+			_montages.at(h).process(&_frameBlock[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		}
+		if (instrument)
 		{
-			return _newFftReady.at(h);
+			_instrumentation.at(h).record(OFX_OPENBCI_WIFI_STAGE_FILTER, ofGetElapsedTimeMicros() - filterStart);
 		}
 	}
-}
 
-void ofxOpenBciWifi::enableFft()
-{
-	_fftEnabled = true;
-}
+	if (_bandPowerEnabled && nSamples > 0)
+	{
+		// Slides the band windows over the whole block, listeners get the powers right away
+		ofxOpenBciWifiBandPower& bandPower = _bandPowers.at(h);
+		if (bandPower.process(&_frameBlock[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS))
+		{
+			_newBandPowerWrite.at(h) = true;
+			ofxOpenBciWifiBandPowerEventArgs args;
+			args.headset = h;
+			args.power = &bandPower.getPowers();
+			args.ratios = &bandPower.getRatios();
+			args.receiveTime = _sampleReceiveTimes.back();
+			ofNotifyEvent(newBandPowerEvent, args);
+		}
+	}
 
-void ofxOpenBciWifi::disableFft()
-{
-	_fftEnabled = false;
-}
+	if (_loggingEnabled && nSamples > 0)
+	{
+		// The whole block goes to the recorder in one copy
+		ofxOpenBciWifiRecordingConfig config = getRecordingConfig(h);
+		if (h >= _recordedConfigs.size())
+		{
+			_recordedConfigs.resize(h + 1);
+			_recordedConfigs.at(h).nChannels = -1;
+		}
+		if (memcmp(&config, &_recordedConfigs.at(h), sizeof(config)) != 0)
+		{
+			_recorder.writeConfig(h, config);
+			_recordedConfigs.at(h) = config;
+		}
+		_recorder.writeBlock(h, &_samples[0], &_frameBlock[0], nSamples, nChannels, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	}
 
-void ofxOpenBciWifi::enableHPFilter(float freq)
-{
-	_hpFiltFreq = freq;
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	for (int s = 0; s < nSamples; s++)
 	{
-		for (int ch = 0; ch < _nChannels.at(h); ch++)
+		float* frame = &_frameBlock[s * OFX_OPENBCI_WIFI_MAX_CHANNELS];
+
+		// Hand the filtered frame to the consumer
+		if (!_dataRings.at(h)->push(frame))
+		{
+			_overflowStats.at(h).droppedSamples++;
+		}
+
+		// Collect the frame for newSamplesEvent
+		vector<float>& block = _sampleBlocks.at(h);
+		if (block.empty())
 		{
-			// This will reset the filters
-			_filterHP.at(h).at(ch) = ofxBiquadFilter1f(OFX_BIQUAD_TYPE_HIGHPASS, _hpFiltFreq / _Fs, 0.7071);
+			_sampleBlockReceiveTimes.at(h) = _sampleReceiveTimes.at(s);
+		}
+		block.insert(block.end(), frame, frame + OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		if (block.size() >= _sampleBlockSize * OFX_OPENBCI_WIFI_MAX_CHANNELS)
+		{
+			notifySamples(h);
 		}
 	}
-	_hpFiltEnabled = true;
-}
 
-void ofxOpenBciWifi::disableHPFilter()
-{
-	_hpFiltEnabled = false;
+	if (_fftEnabled && nChannels > 0)
+	{
+		// Fill up the FFT ring, which holds the last window of every channel, in runs that
+		// stop at the end of the ring and at every window
+		int windowSize = headsetConfig.fftWindowSize;
+		float* ring = &_fftRings.at(h)[0];
+		int& pos = _fftRingPos.at(h);
+		int& toWindow = _fftSamplesToWindow.at(h);
+		for (int s = 0; s < nSamples; )
+		{
+			int n = min(min(nSamples - s, windowSize - pos), toWindow);
+			kernels.scatter(&_frameBlock[s * OFX_OPENBCI_WIFI_MAX_CHANNELS], n, OFX_OPENBCI_WIFI_MAX_CHANNELS, ring, pos, windowSize);
+			s += n;
+			pos = pos + n < windowSize ? pos + n : 0;
+			toWindow -= n;
+
+			if (toWindow == 0)
+			{
+				for (int ch = 0; ch < nChannels; ch++)
+				{
+					// Queue the window for the FFT at the end of the pass, oldest sample first
+					const float* channel = ring + ch * windowSize;
+					_fftEngine.queue(channel + pos, windowSize - pos, channel, pos,
+						&_latestFftWrite.at(h).at(ch).at(0), headsetConfig.fftWindow, &_welchHistories.at(h).at(ch));
+				}
+				toWindow = headsetConfig.fftHopSize;
+				_fftEventPending.at(h) = true;
+				if (instrument)
+				{
+					_instrumentation.at(h).addFftFrames(1);
+				}
+				_newFftReadyWrite.at(h) = true;
+			}
+		}
+	}
+
+	ofxOpenBciWifiOverflowStats& stats = _overflowStats.at(h);
+	stats.samplesHighWaterMark = max(stats.samplesHighWaterMark, _dataRings.at(h)->getCapacity() - _dataRings.at(h)->getWriteSpace());
 }
 
-void ofxOpenBciWifi::enableLPFilter(float freq)
+void ofxOpenBciWifi::publishData()
 {
-	_lpFiltFreq = freq;
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	// Pick up rings of newly connected headsets
+	for (int h = _dataRingsRead.size(); h < _nHeadsets; h++)
 	{
-		for (int ch = 0; ch < _nChannels.at(h); ch++)
+		_dataRingsRead.push_back(_dataRings.at(h));
+		_byteQueueRead.push_back(ofxOpenBciWifiByteQueue());
+		_publishedFrames.push_back(0);
+		_nChannelsRead.push_back(0);
+		_ipAddressesRead.push_back(_ipAddresses.at(h));
+		_headsetsRead[_ipAddresses.at(h)] = h;
+		_latestFftRead.push_back(vector<vector<float>>());
+		_newFftReadyRead.push_back(false);
+		_headsetConfigsRead.push_back(_headsetConfigs.at(h));
+		_bandPowerRead.push_back(vector<vector<float>>());
+		_bandRatiosRead.push_back(vector<vector<float>>());
+		_newBandPowerRead.push_back(false);
+	}
+
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		if (_dataRingsRead.at(h) != _dataRings.at(h))
+		{
+			// The headset's Fs changed, the unread frames of the old ring are dropped
+			_dataRingsRead.at(h) = _dataRings.at(h);
+			_publishedFrames.at(h) = 0;
+		}
+		_headsetConfigsRead.at(h) = _headsetConfigs.at(h);
+
+		// Release the frames of the last update and publish everything processed since then
+		_dataRingsRead.at(h)->consume(_publishedFrames.at(h));
+		_publishedFrames.at(h) = _dataRingsRead.at(h)->getReadAvailable();
+		_nChannelsRead.at(h) = _nChannels.at(h);
+
+		// Recycle the bytes of the last update and publish the ones processed since then
+		_bufferPool.release(_byteQueueRead.at(h));
+		_byteQueueRead.at(h).append(_byteQueueProcessed.at(h));
+
+		if (_unpublishedReceiveTimes.at(h) != 0)
+		{
+			if (_instrumentationEnabled)
+			{
+				uint64_t now = ofGetElapsedTimeMicros();
+				_instrumentation.at(h).record(OFX_OPENBCI_WIFI_STAGE_DELIVERY, now - min(now, _unpublishedReceiveTimes.at(h)));
+			}
+			_unpublishedReceiveTimes.at(h) = 0;
+		}
+
+		_newFftReadyRead.at(h) = _newFftReadyWrite.at(h);
+		if (_newFftReadyWrite.at(h))
+		{
+			_latestFftRead.at(h) = _latestFftWrite.at(h);
+			_newFftReadyWrite.at(h) = false;
+		}
+
+		_newBandPowerRead.at(h) = _newBandPowerWrite.at(h);
+		if (_newBandPowerWrite.at(h))
 		{
-			// This will reset the filters
-			_filterLP.at(h).at(ch) = ofxBiquadFilter1f(OFX_BIQUAD_TYPE_LOWPASS, _lpFiltFreq / _Fs, 0.7071);
+			_bandPowerRead.at(h) = _bandPowers.at(h).getPowers();
+			_bandRatiosRead.at(h) = _bandPowers.at(h).getRatios();
+			_newBandPowerWrite.at(h) = false;
 		}
 	}
-	_lpFiltEnabled = true;
 }
 
-void ofxOpenBciWifi::disableLPFilter()
+float ofxOpenBciWifi::smooth(float newData, float oldData, float newDataWeight)
 {
-	_lpFiltEnabled = false;
+	return newData * newDataWeight + oldData * (1.f - newDataWeight);
 }
 
-void ofxOpenBciWifi::enableNotchFilter(float freq)
+void ofxOpenBciWifi::addHeadset(string ipAddress, int samplingFreq)
 {
-	_notchFiltFreq = freq;
-	for (int h = 0; h < _ipAddresses.size(); h++)
+	ofScopedLock processingLock(_processingMutex);
+	ofxOpenBciWifiHeadsetConfig config = _defaultConfig;
+	map<string, ofxOpenBciWifiHeadsetConfig>::iterator it = _ownConfigs.find(ipAddress);
+	if (it != _ownConfigs.end())
 	{
-		for (int ch = 0; ch < _nChannels.at(h); ch++)
-		{
-			// This will reset the filters
-			_filterNotch.at(h).at(ch) = ofxBiquadFilter1f(OFX_BIQUAD_TYPE_NOTCH, _notchFiltFreq / _Fs, 0.7071);
-		}
+		config = it->second;
 	}
-	_notchFiltEnabled = true;
-}
+	else if (samplingFreq > 0)
+	{
+		config.Fs = samplingFreq;
+	}
+	ofxOpenBciWifiHeadsetEventArgs args;
+	args.headset = _ipAddresses.size();
+	args.ipAddress = ipAddress;
+	args.config = &config;
+	ofNotifyEvent(headsetConnectEvent, args);
 
-void ofxOpenBciWifi::disableNotchFilter()
+	_ipAddresses.push_back(ipAddress);
+	int sz = _ipAddresses.size();
+	_byteQueueWrite.resize(sz);
+	_discarding.push_back(false);
+	_overflowing.push_back(false);
+	_overflowStats.push_back(ofxOpenBciWifiOverflowStats());
+	_bytesParsed.push_back(0);
+	_samplesParsed.push_back(0);
+	_byteQueueProcess.resize(sz);
+	_byteQueueProcessed.resize(sz);
+	_dataRings.push_back(shared_ptr<ofxOpenBciWifiSampleRing>());
+	_stringBufferLens.push_back(0);
+	_filterBanks.resize(sz);
+	// Designed for the headset's Fs by applyHeadsetConfig()
+	_filterBanks.back().addStage(vector<ofxOpenBciWifiBiquad>());		// FILTER_HP
+	_filterBanks.back().addStage(vector<ofxOpenBciWifiBiquad>());		// FILTER_NOTCH
+	_filterBanks.back().addStage(vector<ofxOpenBciWifiBiquad>());		// FILTER_LP
+	_latestFftWrite.resize(sz);
+	_fftRings.resize(sz);
+	_nInputChannels.push_back(0);
+	_nChannels.push_back(0);
+	_inputKernels.resize(sz);
+	_channelKernels.resize(sz);
+	_montages.resize(sz);
+	_newFftReadyWrite.push_back(false);
+	_fftRingPos.push_back(0);
+	_fftSamplesToWindow.push_back(0);
+	_welchHistories.resize(sz);
+	_fftEventPending.push_back(false);
+	_sampleBlocks.push_back(vector<float>());
+	_sampleBlocks.back().reserve(_sampleBlockSize * OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	_sampleBlockReceiveTimes.push_back(0);
+	_unpublishedReceiveTimes.push_back(0);
+	_instrumentation.push_back(ofxOpenBciWifiInstrumentation());
+	_instrumentation.back().reset(ofGetElapsedTimeMicros());
+	_jsonParsers.resize(sz);
+	_rawDecoders.resize(sz);
+	_bandPowers.resize(sz);
+	_newBandPowerWrite.push_back(false);
+	_requestedConfigs.push_back(config);
+	_headsetConfigs.push_back(config);
+	applyHeadsetConfig(sz - 1, config);
+	_nHeadsets = sz;
+
+	ofLogNotice("ofxOpenBciWifi") << "Headset #" << sz << " detected: " << ipAddress << ", Fs " << _headsetConfigs.back().Fs
+		<< ", FFT window " << _headsetConfigs.back().fftWindowSize;
+}
+
+ofxOpenBciWifiHeadsetConfig ofxOpenBciWifi::resolveConfig(ofxOpenBciWifiHeadsetConfig config)
+{
+	config.Fs = max(config.Fs, 1);
+	if (config.fftWindowSize <= 0)
+	{
+		config.fftWindowSize = config.Fs;
+	}
+	if (_efficientFftSizesEnabled)
+	{
+		config.fftWindowSize = ofxOpenBciWifiFftEngine::getEfficientSize(config.fftWindowSize);
+	}
+	config.fftWindowSize = max(config.fftWindowSize, 2);
+	if (config.fftHopSize <= 0)
+	{
+		config.fftHopSize = config.fftWindowSize - config.fftWindowSize / 2;
+	}
+	return config;
+}
+
+void ofxOpenBciWifi::applyHeadsetConfig(int h, ofxOpenBciWifiHeadsetConfig config)
+{
+	// Called with lock() and _processingMutex held
+	_requestedConfigs.at(h) = config;
+	config = resolveConfig(config);
+	bool newFs = config.Fs != _headsetConfigs.at(h).Fs || !_dataRings.at(h);
+	_headsetConfigs.at(h) = config;
+
+	if (newFs)
+	{
+		// Buffer about 30 s whatever the rate
+		_stringBufferLens.at(h) = 200 * config.Fs * 30; // charPerSample x Fs x Seconds
+		// update() moves to the new ring with its next publish
+		_dataRings.at(h) = make_shared<ofxOpenBciWifiSampleRing>();
+		_dataRings.at(h)->setup(config.Fs * 30, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+
+		// This will reset the filters
+		_filterBanks.at(h).setStage(FILTER_HP, designFilter(FILTER_HP, config.Fs));
+		_filterBanks.at(h).setStage(FILTER_NOTCH, designFilter(FILTER_NOTCH, config.Fs));
+		_filterBanks.at(h).setStage(FILTER_LP, designFilter(FILTER_LP, config.Fs));
+	}
+
+	// Start the spectra over, headsets with the same window size share a plan
+	setupBandPower(h);
+	_fftEngine.prepare(config.fftWindowSize, config.fftWindow);
+	_fftRings.at(h).assign(_nChannels.at(h) * config.fftWindowSize, 0.f);
+	_welchHistories.at(h).assign(_nChannels.at(h), ofxOpenBciWifiWelchHistory());
+	_fftRingPos.at(h) = 0;
+	_fftSamplesToWindow.at(h) = config.fftWindowSize;
+	for (int ch = 0; ch < _latestFftWrite.at(h).size(); ch++)
+	{
+		_latestFftWrite.at(h).at(ch).assign(config.fftWindowSize / 2, 0.f);
+	}
+	_newFftReadyWrite.at(h) = false;
+}
+
+vector<ofxOpenBciWifiBiquad> ofxOpenBciWifi::designFilter(int filter, int Fs)
+{
+	switch (filter)
+	{
+	case FILTER_HP:
+		return ofxOpenBciWifiFilterDesign::highpass(_hpFiltFamily, _hpFiltOrder, _hpFiltFreq / Fs, _hpFiltRipple);
+	case FILTER_NOTCH:
+		return ofxOpenBciWifiFilterDesign::harmonicNotch(_notchFiltFreq / Fs, _notchFiltHarmonics, _notchFiltQ);
+	case FILTER_LP:
+	default:
+		return ofxOpenBciWifiFilterDesign::lowpass(_lpFiltFamily, _lpFiltOrder, _lpFiltFreq / Fs, _lpFiltRipple);
+	}
+}
+
+void ofxOpenBciWifi::setupChannels(int h)
+{
+	// Sizes everything per channel for the decoded channel count and the montage,
+	// called with _processingMutex held
+	const ofxOpenBciWifiHeadsetConfig& headsetConfig = _headsetConfigs.at(h);
+	int nInputs = _nInputChannels.at(h);
+	_montages.at(h) = _montage;
+	_montages.at(h).setup(nInputs);
+	int nChannels = _montageEnabled ? _montages.at(h).getOutputCount() : nInputs;
+	_nChannels.at(h) = nChannels;
+	_inputKernels.at(h).setup(nInputs);
+	_channelKernels.at(h).setup(nChannels);
+
+	// Resize the fft vectors, the window starts over
+	_fftRings.at(h).assign(nChannels * headsetConfig.fftWindowSize, 0.f);
+	_fftRingPos.at(h) = 0;
+	_fftSamplesToWindow.at(h) = headsetConfig.fftWindowSize;
+	_latestFftWrite.at(h).resize(nChannels);
+	for (int ch = 0; ch < nChannels; ch++)
+	{
+		_latestFftWrite.at(h).at(ch).resize(headsetConfig.fftWindowSize / 2);
+	}
+	_welchHistories.at(h).assign(nChannels, ofxOpenBciWifiWelchHistory());
+
+	// This will reset all filters when the number of channels changes
+	_filterBanks.at(h).setup(_montageEnabled && _montageBeforeFilters ? nChannels : nInputs);
+	setupBandPower(h);
+}
+
+void ofxOpenBciWifi::setupBandPower(int h)
+{
+	// Clears the band windows, called with _processingMutex held
+	const ofxOpenBciWifiHeadsetConfig& config = _headsetConfigs.at(h);
+	int windowSize = (int)(_bandWindowSeconds * config.Fs + 0.5f);
+	_bandPowers.at(h).setup(_nChannels.at(h), windowSize, config.Fs, _bands, _bandRatios, _bandUpdateInterval);
+	_newBandPowerWrite.at(h) = false;
+}
+
+void ofxOpenBciWifi::setDefaultHeadsetConfig(ofxOpenBciWifiHeadsetConfig config)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_defaultConfig = config;
+}
+
+ofxOpenBciWifiHeadsetConfig ofxOpenBciWifi::getDefaultHeadsetConfig()
+{
+	ofScopedLock processingLock(_processingMutex);
+	return _defaultConfig;
+}
+
+void ofxOpenBciWifi::setHeadsetConfig(string ipAddress, ofxOpenBciWifiHeadsetConfig config)
+{
+	lock();
+	ofScopedLock processingLock(_processingMutex);
+	_ownConfigs[ipAddress] = config;
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		if (_ipAddresses.at(h) == ipAddress)
+		{
+			applyHeadsetConfig(h, config);
+		}
+	}
+	unlock();
+}
+
+ofxOpenBciWifiHeadsetConfig ofxOpenBciWifi::getHeadsetConfig(string ipAddress)
+{
+	int h = getHeadset(ipAddress);
+	if (h != OFX_OPENBCI_WIFI_INVALID_HEADSET)
+	{
+		return getHeadsetConfig(h);
+	}
+	ofScopedLock processingLock(_processingMutex);
+	map<string, ofxOpenBciWifiHeadsetConfig>::iterator it = _ownConfigs.find(ipAddress);
+	return it != _ownConfigs.end() ? it->second : _defaultConfig;
+}
+
+ofxOpenBciWifiHeadsetConfig ofxOpenBciWifi::getHeadsetConfig(int headset)
+{
+	if (headset < 0 || headset >= _headsetConfigsRead.size())
+	{
+		return getDefaultHeadsetConfig();
+	}
+	return _headsetConfigsRead.at(headset);
+}
+
+int ofxOpenBciWifi::getSamplingFreq(int headset)
+{
+	return getHeadsetConfig(headset).Fs;
+}
+
+void ofxOpenBciWifi::enableEfficientFftSizes()
+{
+	lock();
+	ofScopedLock processingLock(_processingMutex);
+	if (!_efficientFftSizesEnabled)
+	{
+		_efficientFftSizesEnabled = true;
+		for (int h = 0; h < _nHeadsets; h++)
+		{
+			applyHeadsetConfig(h, _requestedConfigs.at(h));
+		}
+	}
+	unlock();
+}
+
+void ofxOpenBciWifi::disableEfficientFftSizes()
+{
+	lock();
+	ofScopedLock processingLock(_processingMutex);
+	if (_efficientFftSizesEnabled)
+	{
+		_efficientFftSizesEnabled = false;
+		for (int h = 0; h < _nHeadsets; h++)
+		{
+			applyHeadsetConfig(h, _requestedConfigs.at(h));
+		}
+	}
+	unlock();
+}
+
+vector<string> ofxOpenBciWifi::getStringData()
+{
+	vector<string> stringData;
+	for (int h = 0; h < _byteQueueRead.size(); h++)
+	{
+		stringData.push_back(getStringData(h));
+	}
+	return stringData;
+}
+
+string ofxOpenBciWifi::getStringData(string ipAddress)
+{
+	return getStringData(getHeadset(ipAddress));
+}
+
+string ofxOpenBciWifi::getStringData(int h)
+{
+	// The only copy of the received bytes, made on request
+	string stringData;
+	if (h < 0 || h >= _byteQueueRead.size())
+	{
+		return stringData;
+	}
+	stringData.reserve(_byteQueueRead.at(h).size());
+	for (ofxOpenBciWifiChunk* chunk = _byteQueueRead.at(h).getHead(); chunk != NULL; chunk = chunk->next)
+	{
+		stringData.append(chunk->data, chunk->size);
+	}
+	_bufferPool.addBytesCopied(stringData.size());
+	return stringData;
+}
+
+void ofxOpenBciWifi::setOverflowPolicy(ofxOpenBciWifiOverflowPolicy policy)
+{
+	lock();
+	_overflowPolicy = policy;
+	unlock();
+}
+
+ofxOpenBciWifiOverflowPolicy ofxOpenBciWifi::getOverflowPolicy()
+{
+	return _overflowPolicy;
+}
+
+ofxOpenBciWifiOverflowStats ofxOpenBciWifi::getOverflowStats(string ipAddress)
+{
+	return getOverflowStats(getHeadset(ipAddress));
+}
+
+ofxOpenBciWifiOverflowStats ofxOpenBciWifi::getOverflowStats(int h)
+{
+	ofxOpenBciWifiOverflowStats stats = ofxOpenBciWifiOverflowStats();
+	if (h < 0 || h >= _ipAddressesRead.size())
+	{
+		return stats;
+	}
+	lock();
+	ofScopedLock processingLock(_processingMutex);
+	stats = _overflowStats.at(h);
+	// Estimate the samples in the dropped bytes from what has been parsed so far
+	if (_samplesParsed.at(h) > 0)
+	{
+		stats.droppedSamples += stats.droppedBytes * _samplesParsed.at(h) / _bytesParsed.at(h);
+	}
+	unlock();
+	return stats;
+}
+
+ofxOpenBciWifiBufferStats ofxOpenBciWifi::getReceiveBufferStats()
+{
+	return _bufferPool.getStats();
+}
+
+vector<vector<float>> ofxOpenBciWifi::getData(string ipAddress)
+{
+	return getData(getHeadset(ipAddress));
+}
+
+vector<vector<float>> ofxOpenBciWifi::getData(int headset)
+{
+	vector<vector<float>> data;
+	ofxOpenBciWifiSampleSpans spans;
+	if (!getDataSpans(headset, spans))
+	{
+		return data;
+	}
+
+	data.resize(spans.nChannels);
+	for (int ch = 0; ch < spans.nChannels; ch++)
+	{
+		data.at(ch).reserve(spans.size());
+		for (size_t s = 0; s < spans.nFirst; s++)
+		{
+			data.at(ch).push_back(spans.first[s * spans.stride + ch]);
+		}
+		for (size_t s = 0; s < spans.nSecond; s++)
+		{
+			data.at(ch).push_back(spans.second[s * spans.stride + ch]);
+		}
+	}
+	return data;
+}
+
+bool ofxOpenBciWifi::getDataSpans(string ipAddress, ofxOpenBciWifiSampleSpans& spans)
+{
+	return getDataSpans(getHeadset(ipAddress), spans);
+}
+
+bool ofxOpenBciWifi::getDataSpans(int headset, ofxOpenBciWifiSampleSpans& spans)
+{
+	if (headset < 0 || headset >= _dataRingsRead.size())
+	{
+		return false;
+	}
+	_dataRingsRead.at(headset)->peek(_publishedFrames.at(headset), spans.first, spans.nFirst, spans.second, spans.nSecond);
+	spans.nChannels = _nChannelsRead.at(headset);
+	spans.stride = _dataRingsRead.at(headset)->getStride();
+	return true;
+}
+
+vector<vector<float>> ofxOpenBciWifi::getLatestFft(string ipAddress)
+{
+	return getLatestFft(getHeadset(ipAddress));
+}
+
+const vector<vector<float>>& ofxOpenBciWifi::getLatestFft(int headset)
+{
+	if (headset < 0 || headset >= _latestFftRead.size())
+	{
+		return _emptyFft;
+	}
+	return _latestFftRead.at(headset);
+}
+
+int ofxOpenBciWifi::getFftBinFromFrequency(float freq)
+{
+	ofScopedLock processingLock(_processingMutex);
+	ofxOpenBciWifiHeadsetConfig config = resolveConfig(_defaultConfig);
+	return _fftEngine.getPlan(config.fftWindowSize, config.fftWindow)->getBinFromFrequency(freq, config.Fs);
+}
+
+int ofxOpenBciWifi::getFftBinFromFrequency(int headset, float freq)
+{
+	if (headset < 0 || headset >= _headsetConfigsRead.size())
+	{
+		return getFftBinFromFrequency(freq);
+	}
+	ofxOpenBciWifiHeadsetConfig config = _headsetConfigsRead.at(headset);
+	ofScopedLock processingLock(_processingMutex);
+	return _fftEngine.getPlan(config.fftWindowSize, config.fftWindow)->getBinFromFrequency(freq, config.Fs);
+}
+
+bool ofxOpenBciWifi::isFftNew(string ipAddress)
+{
+	return isFftNew(getHeadset(ipAddress));
+}
+
+bool ofxOpenBciWifi::isFftNew(int headset)
+{
+	if (headset < 0 || headset >= _newFftReadyRead.size())
+	{
+		return false;
+	}
+	return _newFftReadyRead.at(headset);
+}
+
+void ofxOpenBciWifi::enableBandPower(float windowSeconds, int updateInterval)
 {
+	ofScopedLock processingLock(_processingMutex);
+	_bandWindowSeconds = windowSeconds;
+	_bandUpdateInterval = max(updateInterval, 1);
+	if (_bands.empty())
+	{
+		_bands = ofxOpenBciWifiBandPower::getDefaultBands();
+	}
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		setupBandPower(h);
+	}
+	_bandPowerEnabled = true;
+}
+
+void ofxOpenBciWifi::disableBandPower()
+{
+	_bandPowerEnabled = false;
+}
+
+int ofxOpenBciWifi::addBand(string name, float lowFreq, float highFreq)
+{
+	ofScopedLock processingLock(_processingMutex);
+	ofxOpenBciWifiBand band = { name, lowFreq, highFreq };
+	_bands.push_back(band);
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		setupBandPower(h);
+	}
+	return _bands.size() - 1;
+}
+
+int ofxOpenBciWifi::addBandRatio(string name, int numeratorBand, int denominatorBand)
+{
+	ofScopedLock processingLock(_processingMutex);
+	ofxOpenBciWifiBandRatio ratio = { name, numeratorBand, denominatorBand };
+	_bandRatios.push_back(ratio);
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		setupBandPower(h);
+	}
+	return _bandRatios.size() - 1;
+}
+
+void ofxOpenBciWifi::clearBands()
+{
+	ofScopedLock processingLock(_processingMutex);
+	_bands.clear();
+	_bandRatios.clear();
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		setupBandPower(h);
+	}
+}
+
+vector<ofxOpenBciWifiBand> ofxOpenBciWifi::getBands()
+{
+	ofScopedLock processingLock(_processingMutex);
+	return _bands;
+}
+
+vector<ofxOpenBciWifiBandRatio> ofxOpenBciWifi::getBandRatios()
+{
+	ofScopedLock processingLock(_processingMutex);
+	return _bandRatios;
+}
+
+vector<vector<float>> ofxOpenBciWifi::getBandPower(string ipAddress)
+{
+	return getBandPower(getHeadset(ipAddress));
+}
+
+const vector<vector<float>>& ofxOpenBciWifi::getBandPower(int headset)
+{
+	if (headset < 0 || headset >= _bandPowerRead.size())
+	{
+		return _emptyFft;
+	}
+	return _bandPowerRead.at(headset);
+}
+
+vector<vector<float>> ofxOpenBciWifi::getBandPowerRatios(string ipAddress)
+{
+	return getBandPowerRatios(getHeadset(ipAddress));
+}
+
+const vector<vector<float>>& ofxOpenBciWifi::getBandPowerRatios(int headset)
+{
+	if (headset < 0 || headset >= _bandRatiosRead.size())
+	{
+		return _emptyFft;
+	}
+	return _bandRatiosRead.at(headset);
+}
+
+bool ofxOpenBciWifi::isBandPowerNew(int headset)
+{
+	if (headset < 0 || headset >= _newBandPowerRead.size())
+	{
+		return false;
+	}
+	return _newBandPowerRead.at(headset);
+}
+
+void ofxOpenBciWifi::setSampleBlockSize(int nSamples)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_sampleBlockSize = max(nSamples, 1);
+	for (int h = 0; h < _sampleBlocks.size(); h++)
+	{
+		_sampleBlocks.at(h).reserve(_sampleBlockSize * OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	}
+}
+
+int ofxOpenBciWifi::getSampleBlockSize()
+{
+	return _sampleBlockSize;
+}
+
+ofxOpenBciWifiLatencyStats ofxOpenBciWifi::getSampleEventLatency()
+{
+	ofScopedLock processingLock(_processingMutex);
+	return _sampleEventLatency;
+}
+
+void ofxOpenBciWifi::resetSampleEventLatency()
+{
+	ofScopedLock processingLock(_processingMutex);
+	_sampleEventLatency = ofxOpenBciWifiLatencyStats();
+}
+
+void ofxOpenBciWifi::enableInstrumentation(float dumpIntervalSeconds)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_instrumentationDumpInterval = (uint64_t)(max(dumpIntervalSeconds, 0.f) * 1000000);
+	if (!_instrumentationEnabled)
+	{
+		_lastInstrumentationDump = ofGetElapsedTimeMicros();
+		for (int h = 0; h < _instrumentation.size(); h++)
+		{
+			_instrumentation.at(h).reset(_lastInstrumentationDump);
+			_unpublishedReceiveTimes.at(h) = 0;
+		}
+	}
+	_instrumentationEnabled = true;
+}
+
+void ofxOpenBciWifi::disableInstrumentation()
+{
+	_instrumentationEnabled = false;
+}
+
+ofxOpenBciWifiInstrumentationSnapshot ofxOpenBciWifi::getInstrumentation(int headset)
+{
+	ofScopedLock processingLock(_processingMutex);
+	if (headset < 0 || headset >= _instrumentation.size())
+	{
+		return ofxOpenBciWifiInstrumentationSnapshot();
+	}
+	return _instrumentation.at(headset).getSnapshot(ofGetElapsedTimeMicros());
+}
+
+void ofxOpenBciWifi::resetInstrumentation()
+{
+	ofScopedLock processingLock(_processingMutex);
+	uint64_t now = ofGetElapsedTimeMicros();
+	for (int h = 0; h < _instrumentation.size(); h++)
+	{
+		_instrumentation.at(h).reset(now);
+	}
+	_lastInstrumentationDump = now;
+}
+
+void ofxOpenBciWifi::enableMontage(const ofxOpenBciWifiMontage& montage, bool beforeFilters)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_montage = montage;
+	_montageBeforeFilters = beforeFilters;
+	_montageEnabled = true;
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		setupChannels(h);
+	}
+}
+
+void ofxOpenBciWifi::disableMontage()
+{
+	// The channel counts change, so unlike the filters this waits for the processing pass
+	ofScopedLock processingLock(_processingMutex);
+	_montageEnabled = false;
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		setupChannels(h);
+	}
+}
+
+void ofxOpenBciWifi::enableThreadedProcessing()
+{
+	_threadedProcessingEnabled = true;
+}
+
+void ofxOpenBciWifi::disableThreadedProcessing()
+{
+	_threadedProcessingEnabled = false;
+}
+
+void ofxOpenBciWifi::enableFft()
+{
+	_fftEnabled = true;
+}
+
+void ofxOpenBciWifi::enableFft(int windowSize, int hopSize, fftWindowType windowType)
+{
+	lock();
+	ofScopedLock processingLock(_processingMutex);
+	auto setFft = [&](ofxOpenBciWifiHeadsetConfig& config)
+	{
+		config.fftWindowSize = windowSize;
+		config.fftHopSize = hopSize;
+		config.fftWindow = windowType;
+	};
+	setFft(_defaultConfig);
+	for (map<string, ofxOpenBciWifiHeadsetConfig>::iterator it = _ownConfigs.begin(); it != _ownConfigs.end(); ++it)
+	{
+		setFft(it->second);
+	}
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		ofxOpenBciWifiHeadsetConfig config = _requestedConfigs.at(h);
+		setFft(config);
+		applyHeadsetConfig(h, config);
+	}
+	_fftEnabled = true;
+	unlock();
+}
+
+void ofxOpenBciWifi::disableFft()
+{
+	_fftEnabled = false;
+}
+
+void ofxOpenBciWifi::enableFftSmoothing(float newDataWeight)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_fftSmoothingNewDataWeight = newDataWeight;
+	_fftSmoothingEnabled = true;
+}
+
+void ofxOpenBciWifi::disableFftSmoothing()
+{
+	_fftSmoothingEnabled = false;
+}
+
+void ofxOpenBciWifi::enableWelchPsd(int nSegments)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_fftEngine.setWelchSegments(nSegments);
+}
+
+void ofxOpenBciWifi::disableWelchPsd()
+{
+	ofScopedLock processingLock(_processingMutex);
+	_fftEngine.setWelchSegments(1);
+}
+
+void ofxOpenBciWifi::enableMultitaperPsd(float timeHalfBandwidth, int nTapers)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_fftEngine.enableMultitaper(timeHalfBandwidth, nTapers);
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		// Tapers are computed here rather than on the processing pass, and the averages start over
+		_fftEngine.prepare(_headsetConfigs.at(h).fftWindowSize, _headsetConfigs.at(h).fftWindow);
+		_welchHistories.at(h).assign(_nChannels.at(h), ofxOpenBciWifiWelchHistory());
+	}
+}
+
+void ofxOpenBciWifi::disableMultitaperPsd()
+{
+	ofScopedLock processingLock(_processingMutex);
+	_fftEngine.disableMultitaper();
+	for (int h = 0; h < _nHeadsets; h++)
+	{
+		_welchHistories.at(h).assign(_nChannels.at(h), ofxOpenBciWifiWelchHistory());
+	}
+}
+
+void ofxOpenBciWifi::enableHPFilter(float freq, int order, ofxOpenBciWifiFilterFamily family, float rippleDb)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_hpFiltFreq = freq;
+	_hpFiltOrder = order;
+	_hpFiltFamily = family;
+	_hpFiltRipple = rippleDb;
+	for (int h = 0; h < _filterBanks.size(); h++)
+	{
+		// This will reset the filters
+		_filterBanks.at(h).setStage(FILTER_HP, designFilter(FILTER_HP, _headsetConfigs.at(h).Fs));
+	}
+	_hpFiltEnabled = true;
+}
+
+void ofxOpenBciWifi::disableHPFilter()
+{
+	_hpFiltEnabled = false;
+}
+
+void ofxOpenBciWifi::enableLPFilter(float freq, int order, ofxOpenBciWifiFilterFamily family, float rippleDb)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_lpFiltFreq = freq;
+	_lpFiltOrder = order;
+	_lpFiltFamily = family;
+	_lpFiltRipple = rippleDb;
+	for (int h = 0; h < _filterBanks.size(); h++)
+	{
+		// This will reset the filters
+		_filterBanks.at(h).setStage(FILTER_LP, designFilter(FILTER_LP, _headsetConfigs.at(h).Fs));
+	}
+	_lpFiltEnabled = true;
+}
+
+void ofxOpenBciWifi::disableLPFilter()
+{
+	_lpFiltEnabled = false;
+}
+
+void ofxOpenBciWifi::enableNotchFilter(float freq, int nHarmonics, float Q)
+{
+	ofScopedLock processingLock(_processingMutex);
+	_notchFiltFreq = freq;
+	_notchFiltHarmonics = nHarmonics;
+	_notchFiltQ = Q;
+	for (int h = 0; h < _filterBanks.size(); h++)
+	{
+		// This will reset the filters
+		_filterBanks.at(h).setStage(FILTER_NOTCH, designFilter(FILTER_NOTCH, _headsetConfigs.at(h).Fs));
+	}
 	_notchFiltEnabled = true;
 }
+
+void ofxOpenBciWifi::disableNotchFilter()
+{
+	_notchFiltEnabled = false;
+}
@@ -10,100 +10,313 @@
 
 #pragma once
 
-#include "ofxNetwork.h"
-#include "ofxJSON.h"
-#include "ofxBiquadFilter.h"
-#include "ofxFft.h"
-#include "ofxThreadedLogger.h"
+#include "ofxOpenBciWifiJsonParser.h"
+#include "ofxOpenBciWifiRawDecoder.h"
+#include "ofxOpenBciWifiSampleRing.h"
+#include "ofxOpenBciWifiTcpSource.h"
+#include "ofxOpenBciWifiReplaySource.h"
+#include "ofxOpenBciWifiBufferPool.h"
+#include "ofxOpenBciWifiFilterBank.h"
+#include "ofxOpenBciWifiChannelKernels.h"
+#include "ofxOpenBciWifiMontage.h"
+#include "ofxOpenBciWifiFftEngine.h"
+#include "ofxOpenBciWifiBandPower.h"
+#include "ofxOpenBciWifiInstrumentation.h"
+#include "ofxOpenBciWifiRecording.h"
 
-class ofxOpenBciWifi : public ofThread
+// Sampling rate and spectrum settings of one headset
+struct ofxOpenBciWifiHeadsetConfig
+{
+	int Fs;
+	int fftWindowSize;								// Samples per spectrum, 0 = Fs
+	int fftHopSize;									// Samples between spectra, 0 = half a window. May exceed the window.
+	fftWindowType fftWindow;
+};
+
+// Handed to ofxOpenBciWifi::headsetConnectEvent listeners
+struct ofxOpenBciWifiHeadsetEventArgs
+{
+	int headset;
+	string ipAddress;
+	ofxOpenBciWifiHeadsetConfig* config;			// May be changed by the listeners
+};
+
+class ofxOpenBciWifi : public ofThread, private ofxOpenBciWifiConnectionListener
 {
 private:
-	ofxTCPServer TCP;
-	int _Fs;
+	shared_ptr<ofxOpenBciWifiTcpSource> _tcpSource;
+	shared_ptr<ofxOpenBciWifiSource> _source;		// Only used by the network thread once it runs
+	shared_ptr<ofxOpenBciWifiSource> _requestedSource;	// Switched to by the network thread between waits
+	bool _tcpSetupRequested;						// setTcpPort() was called since the last switch
+	ofxOpenBciWifiCaptureWriter _capture;
+	char* _receiveBuffer;							// Last buffer handed out by getReceiveBuffer
+	ofxOpenBciWifiHeadsetConfig _defaultConfig;
+	map<string, ofxOpenBciWifiHeadsetConfig> _ownConfigs;	// Set with setHeadsetConfig() by ip address
+	vector<ofxOpenBciWifiHeadsetConfig> _requestedConfigs;	// Picked at connect or set since
+	vector<ofxOpenBciWifiHeadsetConfig> _headsetConfigs;	// In use, with the FFT sizes filled in
+	vector<ofxOpenBciWifiHeadsetConfig> _headsetConfigsRead;
+	bool _efficientFftSizesEnabled;
 	int _tcpPort;
 	int _nHeadsets;
-	string _messageDelimiter;						
 	vector<string> _ipAddresses;
-	int _stringBufferLen;							// Length of string buffer for incoming data 
-	vector<string> _stringDataWrite;
-	vector<string> _stringDataRead;
-	vector<int> _nChannels;
-	vector<vector<vector<float>>> _data;			// Headsets x Channels x Sample
-	vector<vector<vector<float>>> _fftBuffer;		// Headsets x Channels x Sample
-	vector<vector<vector<float>>> _latestFft;		// Headsets x Channels x Frequency
-
-	uint64_t _lastLoopTime;
-	vector<unsigned int> _loopTimes;
+	vector<size_t> _stringBufferLens;				// Length of string buffer for incoming data per headset
+	ofxOpenBciWifiBufferPool _bufferPool;
+	vector<ofxOpenBciWifiByteQueue> _byteQueueWrite;		// Received by the network thread
+	vector<ofxOpenBciWifiByteQueue> _byteQueueProcess;		// Being parsed
+	vector<ofxOpenBciWifiByteQueue> _byteQueueProcessed;	// Parsed since the last update()
+	vector<ofxOpenBciWifiByteQueue> _byteQueueRead;			// Published by the last update()
+	ofxOpenBciWifiOverflowPolicy _overflowPolicy;
+	vector<char> _discardBuffer;					// Socket reads dropped by OFX_OPENBCI_WIFI_OVERFLOW_DROP_NEWEST
+	vector<bool> _discarding;
+	vector<bool> _overflowing;
+	vector<ofxOpenBciWifiOverflowStats> _overflowStats;
+	vector<uint64_t> _bytesParsed;
+	vector<uint64_t> _samplesParsed;
+	vector<int> _nInputChannels;					// Decoded, before the montage
+	vector<int> _nChannels;							// Processed and published
+	vector<ofxOpenBciWifiChannelKernels> _inputKernels;		// Loops for each headset's decoded channel count
+	vector<ofxOpenBciWifiChannelKernels> _channelKernels;	// and processed channel count
+	vector<shared_ptr<ofxOpenBciWifiSampleRing>> _dataRings;		// Filtered frames, written by processing
+	vector<shared_ptr<ofxOpenBciWifiSampleRing>> _dataRingsRead;	// Same rings, only touched by the update() thread
+	vector<size_t> _publishedFrames;				// Frames published by the last update()
+	vector<int> _nChannelsRead;
+	vector<string> _ipAddressesRead;				// Headsets published by the last update()
+	map<string, int> _headsetsRead;					// Headset handle by ip address
+	vector<vector<float>> _fftRings;				// Headsets x (Channels x fftWindowSize), written circularly
+	vector<vector<vector<float>>> _latestFftWrite;	// Headsets x Channels x Frequency
+	vector<vector<vector<float>>> _latestFftRead;	// Headsets x Channels x Frequency
+	vector<vector<float>> _emptyFft;
+
+	bool _instrumentationEnabled;
+	uint64_t _instrumentationDumpInterval;			// Microseconds, 0 = no periodic dump
+	uint64_t _lastInstrumentationDump;
+	vector<ofxOpenBciWifiInstrumentation> _instrumentation;
+	vector<uint64_t> _unpublishedReceiveTimes;		// Oldest sample processed since the last update(), 0 = none
 	
-	ofxFft* _fft;
-	int _fftWindowSize;					// Number of samples used to calculate fft. Default = Fs.
-	int _fftBuffersize;
-	int _fftOverlap;					// Number of overlapped samples between fft calculations. Default = fftWindowSize/2.
+	ofxOpenBciWifiFftEngine _fftEngine;		// Spectra of the windows filled during a processing pass, plans shared by size
 	bool _fftEnabled;
-	vector<bool> _newFftReady;
-	vector<int> _fftReadPos;
-	vector<int> _fftWritePos;
+	vector<bool> _newFftReadyWrite;
+	vector<bool> _newFftReadyRead;
+	vector<int> _fftRingPos;						// Next sample written, the oldest of the window
+	vector<int> _fftSamplesToWindow;				// Until the next spectrum
+	vector<vector<ofxOpenBciWifiWelchHistory>> _welchHistories;	// Headsets x Channels
 	
+	// Sections of each headset's filter bank
+	enum { FILTER_HP, FILTER_NOTCH, FILTER_LP };
+	vector<ofxOpenBciWifiFilterBank> _filterBanks;
+	vector<float> _frameBlock;						// Frames of the current update, filtered in place
+
 	bool _hpFiltEnabled;
 	float _hpFiltFreq;
-	vector<vector<ofxBiquadFilter1f>> _filterHP;
+	int _hpFiltOrder;
+	ofxOpenBciWifiFilterFamily _hpFiltFamily;
+	float _hpFiltRipple;
 
 	bool _notchFiltEnabled;
 	float _notchFiltFreq;
-	vector<vector<ofxBiquadFilter1f>> _filterNotch;
+	int _notchFiltHarmonics;
+	float _notchFiltQ;
 
 	bool _lpFiltEnabled;
 	float _lpFiltFreq;
-	vector<vector<ofxBiquadFilter1f>> _filterLP;
+	int _lpFiltOrder;
+	ofxOpenBciWifiFilterFamily _lpFiltFamily;
+	float _lpFiltRipple;
+
+	vector<ofxOpenBciWifiBiquad> designFilter(int filter, int Fs);	// Sections of FILTER_HP, FILTER_NOTCH or FILTER_LP
+
+	bool _montageEnabled;
+	bool _montageBeforeFilters;
+	ofxOpenBciWifiMontage _montage;
+	vector<ofxOpenBciWifiMontage> _montages;		// Set up for each headset's channel count
+
+	bool _bandPowerEnabled;
+	float _bandWindowSeconds;
+	int _bandUpdateInterval;
+	vector<ofxOpenBciWifiBand> _bands;
+	vector<ofxOpenBciWifiBandRatio> _bandRatios;
+	vector<ofxOpenBciWifiBandPower> _bandPowers;	// Per headset, updated while processing
+	vector<bool> _newBandPowerWrite;
+	vector<bool> _newBandPowerRead;
+	vector<vector<vector<float>>> _bandPowerRead;	// Headsets x Channels x Bands
+	vector<vector<vector<float>>> _bandRatiosRead;	// Headsets x Channels x Ratios
 
 	bool _fftSmoothingEnabled;
 	//int _fftSmoothingNwin;
 	float _fftSmoothingNewDataWeight;
 
 	bool _loggingEnabled;
-	LoggerThread _logger;
+	ofxOpenBciWifiRecordingWriter _recorder;
+	vector<ofxOpenBciWifiRecordingConfig> _recordedConfigs;	// Last config written per headset
 
 	bool _verboseOutput;
 
-	ofxJSONElement json;
+	ofxOpenBciWifiDataFormat _dataFormat;
+	vector<ofxOpenBciWifiJsonParser> _jsonParsers;
+	vector<ofxOpenBciWifiRawDecoder> _rawDecoders;
+	vector<ofxOpenBciWifiSample> _samples;			// Samples parsed during the current update
+	vector<uint64_t> _sampleReceiveTimes;			// When each of _samples was received
+
+	int _sampleBlockSize;							// Samples per newSamplesEvent
+	vector<vector<float>> _sampleBlocks;			// Frames waiting for newSamplesEvent
+	vector<uint64_t> _sampleBlockReceiveTimes;
+	vector<bool> _fftEventPending;
+	ofxOpenBciWifiLatencyStats _sampleEventLatency;
+
+	bool _threadedProcessingEnabled;
+	ofMutex _processingMutex;						// Guards parsers, filters, fft state and the Write data
 
 	void threadedFunction();
-	void addHeadset(string ipAddress);
-	void clearDataVectors();
+	void addHeadset(string ipAddress, int samplingFreq);
+	ofxOpenBciWifiHeadsetConfig resolveConfig(ofxOpenBciWifiHeadsetConfig config);
+	void applyHeadsetConfig(int h, ofxOpenBciWifiHeadsetConfig config);
+	void setupChannels(int h);
+	void setupBandPower(int h);
 	void swapStringData();
 	void readIncomingData();
+	void applySourceRequest();
+	int findHeadset(const string& ip, int samplingFreq);
 
-	vector<vector<int>> sample_numbers;
+	// ofxOpenBciWifiConnectionListener
+	int onConnect(const string& ip, int samplingFreq);
+	char* getReceiveBuffer(int headset, size_t& nBytes);
+	void onReceive(int headset, size_t nBytes);
+	void onDisconnect(int headset);
+	void takeReceivedData();
+	void processHeadsets();
+	void processHeadset(int h);
+	void notifySamples(int h);
+	void publishData();
+	ofxOpenBciWifiRecordingConfig getRecordingConfig(int h);
 
 public:
-	ofxOpenBciWifi(int samplingFreq = 250);
+	ofxOpenBciWifi(int samplingFreq = 250);	// Of headsets without their own config
 	~ofxOpenBciWifi();
-	void setTcpPort(int port);
+	void setTcpPort(int port);				// Also switches back to the TCP source
 	int getTcpPort();
+	// Reads from source instead of the TCP port, e.g. an ofxOpenBciWifiReplaySource
+	void setSource(shared_ptr<ofxOpenBciWifiSource> source);
+	shared_ptr<ofxOpenBciWifiSource> getSource();
+	void setDataFormat(ofxOpenBciWifiDataFormat format);	// Must match the output mode set on the Wifi shield
+	ofxOpenBciWifiDataFormat getDataFormat();
+	// Headsets are numbered from 0 in the order they connect. The numbers are stable and
+	// are valid handles once an update() has published the headset.
 	int getHeadsetCount();
 	vector<string> getHeadsetIpAddresses();
-	void enableDataLogging(string filePath);
+	int getHeadset(string ipAddress);		// OFX_OPENBCI_WIFI_INVALID_HEADSET if not connected
+	string getHeadsetIpAddress(int headset);
+	// Sampling rate and FFT settings per headset, for mixing boards that stream at different rates.
+	// A headset without its own config gets the default at connect, with the rate its source
+	// reports if any (replayed recordings do). headsetConnectEvent listeners get the last word.
+	// Any config change of a connected headset starts its spectra and band powers over. A new Fs
+	// also redesigns and resets its filters and replaces its sample ring, dropping unread samples.
+	void setDefaultHeadsetConfig(ofxOpenBciWifiHeadsetConfig config);	// For headsets that connect afterwards
+	ofxOpenBciWifiHeadsetConfig getDefaultHeadsetConfig();
+	void setHeadsetConfig(string ipAddress, ofxOpenBciWifiHeadsetConfig config);	// Before or after it connects
+	ofxOpenBciWifiHeadsetConfig getHeadsetConfig(string ipAddress);
+	ofxOpenBciWifiHeadsetConfig getHeadsetConfig(int headset);		// In use, with the FFT sizes filled in
+	int getSamplingFreq(int headset);
+	// Rounds FFT windows up to sizes with no prime factors but 2, 3 and 5, which transform fastest
+	void enableEfficientFftSizes();
+	void disableEfficientFftSizes();
+	// Records the filtered samples in the binary ofxOpenBciWifiRecording format,
+	// ofxOpenBciWifiRecordingReader::convertToCsv() gives the old csv logs.
+	// compress codes the samples losslessly on the writer thread, see ofxOpenBciWifiRecordingCodec
+	void enableDataLogging(string filePath, bool compress = false);
 	void disableDataLogging();
+	void enableCapture(string filePath);	// Records the received bytes for ofxOpenBciWifiReplaySource
+	void disableCapture();
 	void update();
 	vector<string> getStringData();
 	string getStringData(string ipAddress);
+	string getStringData(int headset);
+	ofxOpenBciWifiBufferStats getReceiveBufferStats();
+	void setOverflowPolicy(ofxOpenBciWifiOverflowPolicy policy);	// Default drops the oldest data
+	ofxOpenBciWifiOverflowPolicy getOverflowPolicy();
+	ofxOpenBciWifiOverflowStats getOverflowStats(string ipAddress);
+	ofxOpenBciWifiOverflowStats getOverflowStats(int headset);
 	vector<vector<float>> getData(string ipAddress);
+	vector<vector<float>> getData(int headset);
+	bool getDataSpans(string ipAddress, ofxOpenBciWifiSampleSpans& spans);	// Samples of the last update() without copying
+	bool getDataSpans(int headset, ofxOpenBciWifiSampleSpans& spans);
 	vector<vector<float>> getLatestFft(string ipAddress);
-	int getFftBinFromFrequency(float freq);
+	const vector<vector<float>>& getLatestFft(int headset);		// Valid until the next update()
+	int getFftBinFromFrequency(float freq);		// Of the default config
+	int getFftBinFromFrequency(int headset, float freq);
 	bool isFftNew(string ipAddress);
+	bool isFftNew(int headset);
 
-	void enableHPFilter(float freq);
+	// Band powers from a sliding DFT over the last windowSeconds of every channel, refreshed every
+	// updateInterval samples instead of every FFT hop. Only the bins of the bands are computed, so
+	// a handful of bands costs far less than the full FFT. Without bands the default ones are used
+	// (delta, theta, alpha, beta, gamma). Powers are the mean square in the band, in uV^2.
+	void enableBandPower(float windowSeconds = 1.f, int updateInterval = 1);
+	void disableBandPower();
+	int addBand(string name, float lowFreq, float highFreq);	// [lowFreq, highFreq) Hz, returns the band index
+	int addBandRatio(string name, int numeratorBand, int denominatorBand);	// Returns the ratio index
+	void clearBands();										// Also clears the ratios
+	vector<ofxOpenBciWifiBand> getBands();
+	vector<ofxOpenBciWifiBandRatio> getBandRatios();
+	vector<vector<float>> getBandPower(string ipAddress);
+	const vector<vector<float>>& getBandPower(int headset);		// Channels x Bands, valid until the next update()
+	vector<vector<float>> getBandPowerRatios(string ipAddress);
+	const vector<vector<float>>& getBandPowerRatios(int headset);	// Channels x Ratios
+	bool isBandPowerNew(int headset);
+
+	// Any order runs as one cascade of second order sections, e.g. enableHPFilter(1, 4) for a
+	// 4th order Butterworth that is 48 dB down at 0.25 Hz. rippleDb is for Chebyshev only.
+	void enableHPFilter(float freq, int order = 2, ofxOpenBciWifiFilterFamily family = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH, float rippleDb = 0.5f);
 	void disableHPFilter();
-	void enableLPFilter(float freq);
+	void enableLPFilter(float freq, int order = 2, ofxOpenBciWifiFilterFamily family = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH, float rippleDb = 0.5f);
 	void disableLPFilter();
-	void enableNotchFilter(float freq);
+	// Notches freq and its first nHarmonics - 1 harmonics, 0 = every harmonic below Nyquist. Q is
+	// the fundamental's and the harmonics keep its width, e.g. enableNotchFilter(60, 0, 30).
+	void enableNotchFilter(float freq, int nHarmonics = 1, float Q = 0.7071f);
 	void disableNotchFilter();
+	// Re-references the channels of every headset inside the pipeline, e.g.
+	// enableMontage(ofxOpenBciWifiMontage::commonAverage()). getData(), the spectra, band powers and
+	// recordings all get the montage's outputs. beforeFilters = false filters the decoded channels
+	// and re-references the filtered ones. Changing it starts the filters and spectra over.
+	void enableMontage(const ofxOpenBciWifiMontage& montage, bool beforeFilters = true);
+	void disableMontage();
+	// Fired on the processing thread: the network thread with threaded processing, otherwise inside update().
+	// Listeners run with the processing lock held, so keep them short and don't call back into this object.
+	ofEvent<ofxOpenBciWifiSamplesEventArgs> newSamplesEvent;
+	ofEvent<ofxOpenBciWifiFftEventArgs> newFftEvent;
+	ofEvent<ofxOpenBciWifiBandPowerEventArgs> newBandPowerEvent;	// After every processed block that updated them
+	ofEvent<ofxOpenBciWifiHeadsetEventArgs> headsetConnectEvent;	// Before the headset's first sample
+	void setSampleBlockSize(int nSamples);	// Samples per newSamplesEvent. Default = 1.
+	int getSampleBlockSize();
+	ofxOpenBciWifiLatencyStats getSampleEventLatency();
+	void resetSampleEventLatency();
+
+	// Per-stage latency histograms and throughput, off by default. With dumpIntervalSeconds > 0 a
+	// summary per headset is logged with ofLogNotice and the measurements restart every interval.
+	void enableInstrumentation(float dumpIntervalSeconds = 0.f);
+	void disableInstrumentation();
+	ofxOpenBciWifiInstrumentationSnapshot getInstrumentation(int headset);
+	void resetInstrumentation();
+
+	void enableThreadedProcessing();		// Parse, filter and FFT on the network thread, update() only publishes
+	void disableThreadedProcessing();
 	void enableFft();
+	// Sets the FFT of the default and every headset config, windowSize 0 = each headset's Fs and
+	// hopSize 0 = half a window. A small hop gives spectra more often at the cost of more FFTs.
+	void enableFft(int windowSize, int hopSize = 0, fftWindowType windowType = OF_FFT_WINDOW_HAMMING);
 	void disableFft();
-	// ** Planned functions **
-	//void enableFftSmoothing(float newDataWeight = 0.25f);
-	//void disableFftSmoothing();
+	// Exponential smoothing of the spectra in dB, on by default
+	void enableFftSmoothing(float newDataWeight = 0.25f);
+	void disableFftSmoothing();
+	// Lower variance spectra from averaging linear power instead. Welch averages the last
+	// nSegments windows of each channel, so with the default hop of half a window it costs no
+	// extra FFTs and a new estimate still comes every hop. Multitaper transforms every window
+	// with nTapers DPSS tapers (0 = 2 NW - 1) in place of the window function, which costs
+	// nTapers FFTs per window, so raise the hop to match the FFT budget. They can be combined,
+	// and smoothing in dB still applies on top unless disabled.
+	void enableWelchPsd(int nSegments = 4);
+	void disableWelchPsd();
+	void enableMultitaperPsd(float timeHalfBandwidth = 2.f, int nTapers = 0);
+	void disableMultitaperPsd();
 
 	static float smooth(float newData, float oldData, float newDataWeight);
 };
\ No newline at end of file
@@ -0,0 +1,275 @@
+//
+//  ofxOpenBciWifiBandPower.cpp
+//
+//  Band powers of every channel of a headset, updated sample by sample with a sliding DFT.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiBandPower.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OFX_OPENBCI_WIFI_BAND_SSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define OFX_OPENBCI_WIFI_BAND_NEON
+#endif
+
+#define HANN_MEAN_SQUARE 0.375					// Mean of the squared Hann window
+
+ofxOpenBciWifiBandPower::ofxOpenBciWifiBandPower()
+{
+	_nChannels = 0;
+	_windowSize = 0;
+	_updateInterval = 1;
+	reset();
+}
+
+void ofxOpenBciWifiBandPower::setup(int nChannels, int windowSize, float Fs, const vector<ofxOpenBciWifiBand>& bands,
+	const vector<ofxOpenBciWifiBandRatio>& ratios, int updateInterval)
+{
+	_nChannels = max(nChannels, 0);
+	_windowSize = max(windowSize, 4);
+	_updateInterval = max(updateInterval, 1);
+	_ratios = ratios;
+
+	// Bins k with k * Fs / windowSize in [lowFreq, highFreq), plus a neighbour on each side for the Hann window
+	int N = _windowSize;
+	vector<pair<int, int>> bandRanges;
+	vector<bool> tracked(N / 2 + 1, false);
+	for (int b = 0; b < bands.size(); b++)
+	{
+		int lo = max((int)ceil(bands.at(b).lowFreq * N / Fs), 1);
+		int hi = min((int)ceil(bands.at(b).highFreq * N / Fs) - 1, N / 2 - 1);
+		bandRanges.push_back(make_pair(lo, hi));
+		for (int k = lo - 1; k <= hi + 1 && lo <= hi; k++)
+		{
+			tracked.at(k) = true;
+		}
+	}
+	_bins.clear();
+	_twiddles.clear();
+	vector<int> binIndex(N / 2 + 1, -1);
+	for (int k = 0; k < tracked.size(); k++)
+	{
+		if (tracked.at(k))
+		{
+			binIndex.at(k) = _bins.size();
+			_bins.push_back(k);
+			_twiddles.push_back(cos(TWO_PI * k / N));
+			_twiddles.push_back(sin(TWO_PI * k / N));
+		}
+	}
+	// A band's bins and their neighbours are consecutive in _bins
+	_bandBins.clear();
+	for (int b = 0; b < bandRanges.size(); b++)
+	{
+		if (bandRanges.at(b).first <= bandRanges.at(b).second)
+		{
+			_bandBins.push_back(make_pair(binIndex.at(bandRanges.at(b).first), binIndex.at(bandRanges.at(b).second)));
+		}
+		else
+		{
+			_bandBins.push_back(make_pair(0, -1));
+		}
+	}
+
+	_spectrum.assign(_bins.size() * 2 * _nChannels, 0.);
+	_history.assign(N * _nChannels, 0.f);
+	_delta.assign(_nChannels, 0.);
+	_powers.assign(_nChannels, vector<float>(bands.size(), 0.f));
+	_ratioValues.assign(_nChannels, vector<float>(ratios.size(), 0.f));
+	reset();
+}
+
+void ofxOpenBciWifiBandPower::reset()
+{
+	fill(_spectrum.begin(), _spectrum.end(), 0.);
+	fill(_history.begin(), _history.end(), 0.f);
+	for (int c = 0; c < _powers.size(); c++)
+	{
+		fill(_powers.at(c).begin(), _powers.at(c).end(), 0.f);
+		fill(_ratioValues.at(c).begin(), _ratioValues.at(c).end(), 0.f);
+	}
+	_pos = 0;
+	_nFrames = 0;
+	_untilUpdate = 1;
+	_untilResync = _windowSize * OFX_OPENBCI_WIFI_BAND_RESYNC_WINDOWS;
+}
+
+int ofxOpenBciWifiBandPower::getBinCount()
+{
+	return _bins.size();
+}
+
+bool ofxOpenBciWifiBandPower::process(const float* frames, int nFrames, int stride)
+{
+	int C = _nChannels;
+	int nBins = _bins.size();
+	bool updated = false;
+	if (C == 0 || _windowSize == 0)
+	{
+		return false;
+	}
+	double* delta = &_delta[0];
+	const double* twiddles = nBins > 0 ? &_twiddles[0] : NULL;
+	double* spectrum = nBins > 0 ? &_spectrum[0] : NULL;
+	for (int f = 0; f < nFrames; f++)
+	{
+		// X_k = e^(j 2 pi k / N) (X_k + x_new - x_old) keeps every bin the DFT of the last N frames
+		const float* x = frames + f * stride;
+		float* oldest = &_history[_pos * C];
+		for (int c = 0; c < C; c++)
+		{
+			delta[c] = (double)x[c] - oldest[c];
+			oldest[c] = x[c];
+		}
+		_pos = _pos + 1 < _windowSize ? _pos + 1 : 0;
+
+		// Channels are innermost and contiguous, 2 at a time with SSE2 / NEON
+		for (int b = 0; b < nBins; b++)
+		{
+			double wr = twiddles[2 * b];
+			double wi = twiddles[2 * b + 1];
+			double* re = spectrum + 2 * b * C;
+			double* im = re + C;
+			int c = 0;
+#if defined(OFX_OPENBCI_WIFI_BAND_SSE)
+			__m128d vwr = _mm_set1_pd(wr);
+			__m128d vwi = _mm_set1_pd(wi);
+			for (; c + 2 <= C; c += 2)
+			{
+				__m128d r = _mm_add_pd(_mm_loadu_pd(re + c), _mm_loadu_pd(delta + c));
+				__m128d i = _mm_loadu_pd(im + c);
+				_mm_storeu_pd(re + c, _mm_sub_pd(_mm_mul_pd(r, vwr), _mm_mul_pd(i, vwi)));
+				_mm_storeu_pd(im + c, _mm_add_pd(_mm_mul_pd(r, vwi), _mm_mul_pd(i, vwr)));
+			}
+#elif defined(OFX_OPENBCI_WIFI_BAND_NEON)
+			float64x2_t vwr = vdupq_n_f64(wr);
+			float64x2_t vwi = vdupq_n_f64(wi);
+			for (; c + 2 <= C; c += 2)
+			{
+				float64x2_t r = vaddq_f64(vld1q_f64(re + c), vld1q_f64(delta + c));
+				float64x2_t i = vld1q_f64(im + c);
+				vst1q_f64(re + c, vsubq_f64(vmulq_f64(r, vwr), vmulq_f64(i, vwi)));
+				vst1q_f64(im + c, vaddq_f64(vmulq_f64(r, vwi), vmulq_f64(i, vwr)));
+			}
+#endif
+			for (; c < C; c++)
+			{
+				double r = re[c] + delta[c];
+				double i = im[c];
+				re[c] = r * wr - i * wi;
+				im[c] = r * wi + i * wr;
+			}
+		}
+
+		_nFrames++;
+		if (--_untilResync == 0)
+		{
+			resync();
+			_untilResync = _windowSize * OFX_OPENBCI_WIFI_BAND_RESYNC_WINDOWS;
+		}
+		if (_nFrames >= _windowSize && --_untilUpdate == 0)
+		{
+			updatePowers();
+			_untilUpdate = _updateInterval;
+			updated = true;
+		}
+	}
+	return updated;
+}
+
+void ofxOpenBciWifiBandPower::resync()
+{
+	// Straight DFT of the window, oldest frame first
+	int C = _nChannels;
+	int N = _windowSize;
+	for (int b = 0; b < _bins.size(); b++)
+	{
+		double* re = &_spectrum[2 * b * C];
+		double* im = re + C;
+		fill(re, re + 2 * C, 0.);
+		for (int m = 0; m < N; m++)
+		{
+			double angle = TWO_PI * ((int64_t)_bins.at(b) * m % N) / N;
+			double wr = cos(angle);
+			double wi = -sin(angle);
+			const float* x = &_history[((_pos + m) % N) * C];
+			for (int c = 0; c < C; c++)
+			{
+				re[c] += x[c] * wr;
+				im[c] += x[c] * wi;
+			}
+		}
+	}
+}
+
+void ofxOpenBciWifiBandPower::updatePowers()
+{
+	// One sided mean square: 2 |X|^2 / (N^2 mean(w^2)), with the Hann window applied as
+	// 0.5 X_k - 0.25 (X_k-1 + X_k+1)
+	int C = _nChannels;
+	double scale = 2. / ((double)_windowSize * _windowSize * HANN_MEAN_SQUARE);
+	for (int band = 0; band < _bandBins.size(); band++)
+	{
+		_bandSums.assign(C, 0.);
+		for (int b = _bandBins.at(band).first; b <= _bandBins.at(band).second; b++)
+		{
+			const double* re = &_spectrum[2 * b * C];
+			const double* im = re + C;
+			const double* reLow = re - 2 * C;
+			const double* imLow = reLow + C;
+			const double* reHigh = re + 2 * C;
+			const double* imHigh = reHigh + C;
+			for (int c = 0; c < C; c++)
+			{
+				double hr = 0.5 * re[c] - 0.25 * (reLow[c] + reHigh[c]);
+				double hi = 0.5 * im[c] - 0.25 * (imLow[c] + imHigh[c]);
+				_bandSums[c] += hr * hr + hi * hi;
+			}
+		}
+		for (int c = 0; c < C; c++)
+		{
+			_powers[c][band] = _bandSums[c] * scale;
+		}
+	}
+
+	for (int r = 0; r < _ratios.size(); r++)
+	{
+		const ofxOpenBciWifiBandRatio& ratio = _ratios.at(r);
+		for (int c = 0; c < C; c++)
+		{
+			float value = 0.f;
+			if (ratio.numerator >= 0 && ratio.numerator < _bandBins.size()
+				&& ratio.denominator >= 0 && ratio.denominator < _bandBins.size()
+				&& _powers.at(c).at(ratio.denominator) > 0.f)
+			{
+				value = _powers.at(c).at(ratio.numerator) / _powers.at(c).at(ratio.denominator);
+			}
+			_ratioValues.at(c).at(r) = value;
+		}
+	}
+}
+
+const vector<vector<float>>& ofxOpenBciWifiBandPower::getPowers()
+{
+	return _powers;
+}
+
+const vector<vector<float>>& ofxOpenBciWifiBandPower::getRatios()
+{
+	return _ratioValues;
+}
+
+vector<ofxOpenBciWifiBand> ofxOpenBciWifiBandPower::getDefaultBands()
+{
+	vector<ofxOpenBciWifiBand> bands;
+	bands.push_back({ "delta", 1.f, 4.f });
+	bands.push_back({ "theta", 4.f, 8.f });
+	bands.push_back({ "alpha", 8.f, 13.f });
+	bands.push_back({ "beta", 13.f, 30.f });
+	bands.push_back({ "gamma", 30.f, 45.f });		// Below the 50 / 60 Hz line noise
+	return bands;
+}
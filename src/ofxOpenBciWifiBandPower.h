@@ -0,0 +1,76 @@
+//
+//  ofxOpenBciWifiBandPower.h
+//
+//  Band powers of every channel of a headset, updated sample by sample with a sliding DFT.
+//  Only the DFT bins inside the bands (and their neighbours, for the Hann window applied in
+//  the frequency domain) are tracked, so each sample costs a few complex multiplies per bin
+//  instead of a full FFT per hop. The bins are recomputed from the window every
+//  OFX_OPENBCI_WIFI_BAND_RESYNC_WINDOWS windows so rounding can't build up.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+#define OFX_OPENBCI_WIFI_BAND_RESYNC_WINDOWS 64
+
+struct ofxOpenBciWifiBand
+{
+	string name;
+	float lowFreq;									// Hz, the band is [lowFreq, highFreq)
+	float highFreq;
+};
+
+struct ofxOpenBciWifiBandRatio
+{
+	string name;
+	int numerator;									// Band indices
+	int denominator;
+};
+
+class ofxOpenBciWifiBandPower
+{
+private:
+	int _nChannels;
+	int _windowSize;
+	int _updateInterval;
+	vector<int> _bins;								// DFT bins tracked
+	vector<double> _twiddles;						// cos, sin of 2 pi bin / windowSize per bin
+	vector<double> _spectrum;						// Bins x Channels x (re, im) of the current window
+	vector<float> _history;							// windowSize x Channels, written circularly
+	vector<double> _delta;							// New minus oldest frame
+	vector<double> _bandSums;
+	int _pos;										// Oldest frame of the window in _history
+	uint64_t _nFrames;
+	int _untilUpdate;
+	int _untilResync;
+	vector<pair<int, int>> _bandBins;				// First and last index into _bins of every band's bins
+	vector<ofxOpenBciWifiBandRatio> _ratios;
+	vector<vector<float>> _powers;					// Channels x Bands
+	vector<vector<float>> _ratioValues;				// Channels x Ratios
+
+	void resync();
+	void updatePowers();
+
+public:
+	ofxOpenBciWifiBandPower();
+
+	// Clears the window. Bands outside (0, Fs / 2) are clipped to the DFT bins between DC and Nyquist.
+	void setup(int nChannels, int windowSize, float Fs, const vector<ofxOpenBciWifiBand>& bands,
+		const vector<ofxOpenBciWifiBandRatio>& ratios, int updateInterval = 1);
+	void reset();
+	int getBinCount();
+
+	// Slides the window over nFrames interleaved frames. Returns true if the powers were updated,
+	// which happens every updateInterval frames once the first window is full.
+	bool process(const float* frames, int nFrames, int stride);
+
+	// Mean square of each band in the window (Hann weighted), in the squared units of the samples
+	const vector<vector<float>>& getPowers();		// Channels x Bands
+	const vector<vector<float>>& getRatios();		// Channels x Ratios
+
+	// Delta, theta, alpha, beta and gamma
+	static vector<ofxOpenBciWifiBand> getDefaultBands();
+};
@@ -0,0 +1,719 @@
+//
+//  ofxOpenBciWifiBatchProcessor.cpp
+//
+//  Offline reprocessing of recorded sessions on every core.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiBatchProcessor.h"
+#include "ofxOpenBciWifiReplaySource.h"
+#include "ofxOpenBciWifiJsonParser.h"
+#include "ofxOpenBciWifiRawDecoder.h"
+
+#define BATCH_PARSE_BYTES (64 * 1024)			// Bytes handed to the parser at a time
+#define BATCH_FILTER_FRAMES 4096				// Frames filtered at a time, small enough to stay in cache
+#define BATCH_WRITE_SAMPLES 256					// Samples per block of the output recording
+
+// Filter sections, in the order ofxOpenBciWifi adds them
+#define FILTER_HP 0
+#define FILTER_NOTCH 1
+#define FILTER_LP 2
+
+namespace
+{
+	// Gathers the bytes of every connection of a capture
+	class CaptureCollector : public ofxOpenBciWifiConnectionListener
+	{
+	private:
+		vector<char> _buffer;
+
+	public:
+		vector<string> ips;
+		vector<string> bytes;
+
+		CaptureCollector() : _buffer(BATCH_PARSE_BYTES) {}
+
+		int onConnect(const string& ip, int /*samplingFreq*/)
+		{
+			// Reconnections carry on with the same headset, like ofxOpenBciWifi
+			for (int h = 0; h < ips.size(); h++)
+			{
+				if (ips.at(h) == ip)
+				{
+					return h;
+				}
+			}
+			ips.push_back(ip);
+			bytes.push_back(string());
+			return ips.size() - 1;
+		}
+
+		char* getReceiveBuffer(int /*headset*/, size_t& nBytes)
+		{
+			nBytes = _buffer.size();
+			return &_buffer[0];
+		}
+
+		void onReceive(int headset, size_t nBytes)
+		{
+			bytes.at(headset).append(&_buffer[0], nBytes);
+		}
+
+		void onDisconnect(int /*headset*/) {}
+	};
+}
+
+ofxOpenBciWifiBatchProcessor::ofxOpenBciWifiBatchProcessor(int samplingFreq)
+{
+	_Fs = samplingFreq;
+	_dataFormat = OFX_OPENBCI_WIFI_FORMAT_JSON;
+	_hpFiltEnabled = true;
+	_hpFiltFreq = 1.f;
+	_hpFiltOrder = 2;
+	_hpFiltFamily = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH;
+	_hpFiltRipple = 0.5f;
+	_notchFiltEnabled = true;
+	_notchFiltFreq = 60.f;
+	_notchFiltHarmonics = 1;
+	_notchFiltQ = 0.7071f;
+	_lpFiltEnabled = false;
+	_lpFiltFreq = 50.f;
+	_lpFiltOrder = 2;
+	_lpFiltFamily = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH;
+	_lpFiltRipple = 0.5f;
+	_montageEnabled = false;
+	_montageBeforeFilters = true;
+	_fftEnabled = true;
+	_fftWindowSize = 0;
+	_fftHopSize = 0;
+	_fftWindowType = OF_FFT_WINDOW_HAMMING;
+	_efficientFftSizesEnabled = false;
+	_fftSmoothingEnabled = true;
+	_fftSmoothingNewDataWeight = 0.25f;
+	_welchSegments = 1;
+	_multitaperEnabled = false;
+	_timeHalfBandwidth = 2.f;
+	_nTapers = 0;
+	_nThreads = 0;
+	_nSamples = 0;
+	_runSeconds = 0.f;
+}
+
+void ofxOpenBciWifiBatchProcessor::setDataFormat(ofxOpenBciWifiDataFormat format)
+{
+	_dataFormat = format;
+}
+
+ofxOpenBciWifiDataFormat ofxOpenBciWifiBatchProcessor::getDataFormat()
+{
+	return _dataFormat;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableHPFilter(float freq, int order, ofxOpenBciWifiFilterFamily family, float rippleDb)
+{
+	_hpFiltEnabled = true;
+	_hpFiltFreq = freq;
+	_hpFiltOrder = order;
+	_hpFiltFamily = family;
+	_hpFiltRipple = rippleDb;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableHPFilter()
+{
+	_hpFiltEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableLPFilter(float freq, int order, ofxOpenBciWifiFilterFamily family, float rippleDb)
+{
+	_lpFiltEnabled = true;
+	_lpFiltFreq = freq;
+	_lpFiltOrder = order;
+	_lpFiltFamily = family;
+	_lpFiltRipple = rippleDb;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableLPFilter()
+{
+	_lpFiltEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableNotchFilter(float freq, int nHarmonics, float Q)
+{
+	_notchFiltEnabled = true;
+	_notchFiltFreq = freq;
+	_notchFiltHarmonics = nHarmonics;
+	_notchFiltQ = Q;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableNotchFilter()
+{
+	_notchFiltEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableMontage(const ofxOpenBciWifiMontage& montage, bool beforeFilters)
+{
+	_montageEnabled = true;
+	_montageBeforeFilters = beforeFilters;
+	_montage = montage;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableMontage()
+{
+	_montageEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableFft()
+{
+	_fftEnabled = true;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableFft(int windowSize, int hopSize, fftWindowType windowType)
+{
+	_fftEnabled = true;
+	_fftWindowSize = windowSize;
+	_fftHopSize = hopSize;
+	_fftWindowType = windowType;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableFft()
+{
+	_fftEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableEfficientFftSizes()
+{
+	_efficientFftSizesEnabled = true;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableEfficientFftSizes()
+{
+	_efficientFftSizesEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableFftSmoothing(float newDataWeight)
+{
+	_fftSmoothingEnabled = true;
+	_fftSmoothingNewDataWeight = newDataWeight;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableFftSmoothing()
+{
+	_fftSmoothingEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableWelchPsd(int nSegments)
+{
+	_welchSegments = max(nSegments, 1);
+}
+
+void ofxOpenBciWifiBatchProcessor::disableWelchPsd()
+{
+	_welchSegments = 1;
+}
+
+void ofxOpenBciWifiBatchProcessor::enableMultitaperPsd(float timeHalfBandwidth, int nTapers)
+{
+	_multitaperEnabled = true;
+	_timeHalfBandwidth = timeHalfBandwidth;
+	_nTapers = nTapers;
+}
+
+void ofxOpenBciWifiBatchProcessor::disableMultitaperPsd()
+{
+	_multitaperEnabled = false;
+}
+
+void ofxOpenBciWifiBatchProcessor::setThreadCount(int nThreads)
+{
+	_nThreads = max(nThreads, 0);
+}
+
+int ofxOpenBciWifiBatchProcessor::getThreadCount()
+{
+	return _nThreads > 0 ? _nThreads : max((int)thread::hardware_concurrency(), 1);
+}
+
+int ofxOpenBciWifiBatchProcessor::addFile(string inputPath, string outputPath)
+{
+	ofxOpenBciWifiBatchFile file;
+	file.inputPath = inputPath;
+	file.outputPath = outputPath;
+	file.loaded = false;
+	_files.push_back(file);
+	return _files.size() - 1;
+}
+
+void ofxOpenBciWifiBatchProcessor::clearFiles()
+{
+	_files.clear();
+}
+
+int ofxOpenBciWifiBatchProcessor::getFileCount()
+{
+	return _files.size();
+}
+
+const ofxOpenBciWifiBatchFile& ofxOpenBciWifiBatchProcessor::getFile(int file)
+{
+	return _files.at(file);
+}
+
+uint64_t ofxOpenBciWifiBatchProcessor::getSampleCount()
+{
+	return _nSamples;
+}
+
+float ofxOpenBciWifiBatchProcessor::getRunSeconds()
+{
+	return _runSeconds;
+}
+
+uint64_t ofxOpenBciWifiBatchProcessor::getStealCount()
+{
+	return _pool.getStealCount();
+}
+
+bool ofxOpenBciWifiBatchProcessor::run()
+{
+	uint64_t start = ofGetElapsedTimeMicros();
+	_pool.setup(_nThreads);
+	while (_fftEngines.size() < _pool.getThreadCount())
+	{
+		_fftEngines.push_back(unique_ptr<ofxOpenBciWifiFftEngine>(new ofxOpenBciWifiFftEngine()));
+	}
+	_nSamples = 0;
+	_jobs.clear();
+	for (int f = 0; f < _files.size(); f++)
+	{
+		_files.at(f).loaded = false;
+		_files.at(f).headsets.clear();
+		_jobs.push_back(unique_ptr<FileJob>(new FileJob()));
+	}
+
+	// Each file spreads into tasks per headset and channel group, idle workers steal them
+	for (int f = 0; f < _files.size(); f++)
+	{
+		_pool.push([this, f](int worker) { loadFile(f, worker); });
+	}
+	_pool.wait();
+	_jobs.clear();
+	_runSeconds = (ofGetElapsedTimeMicros() - start) / 1000000.f;
+
+	bool loaded = true;
+	for (int f = 0; f < _files.size(); f++)
+	{
+		loaded = loaded && _files.at(f).loaded;
+	}
+	return loaded;
+}
+
+void ofxOpenBciWifiBatchProcessor::loadFile(int f, int worker)
+{
+	ofxOpenBciWifiBatchFile& file = _files.at(f);
+	bool capture = ofToLower(ofFilePath::getFileExt(file.inputPath)) == "cap";
+	file.loaded = capture ? loadCapture(f) : loadRecording(f);
+	if (!file.loaded)
+	{
+		ofLogError("ofxOpenBciWifiBatchProcessor") << "Could not read " << file.inputPath;
+		return;
+	}
+
+	FileJob& job = *_jobs.at(f);
+	job.nHeadsetsLeft = file.headsets.size();
+	for (int h = 0; h < file.headsets.size(); h++)
+	{
+		if (capture)
+		{
+			_pool.push([this, f, h](int worker) { parseHeadset(f, h, worker); }, worker);
+		}
+		else
+		{
+			startChannels(f, h, worker);
+		}
+	}
+}
+
+bool ofxOpenBciWifiBatchProcessor::loadCapture(int f)
+{
+	ofxOpenBciWifiBatchFile& file = _files.at(f);
+	ofxOpenBciWifiReplaySource replay;
+	if (!replay.loadCapture(file.inputPath))
+	{
+		return false;
+	}
+	replay.setSpeed(0);
+	CaptureCollector collector;
+	while (!replay.isFinished())
+	{
+		replay.dispatch(collector);
+	}
+
+	FileJob& job = *_jobs.at(f);
+	for (int h = 0; h < collector.ips.size(); h++)
+	{
+		file.headsets.push_back(ofxOpenBciWifiBatchHeadset());
+		file.headsets.back().ipAddress = collector.ips.at(h);
+		file.headsets.back().Fs = _Fs;
+		file.headsets.back().nChannels = 0;
+		job.headsets.push_back(unique_ptr<HeadsetJob>(new HeadsetJob()));
+		job.headsets.back()->bytes.swap(collector.bytes.at(h));
+	}
+	return true;
+}
+
+bool ofxOpenBciWifiBatchProcessor::loadRecording(int f)
+{
+	ofxOpenBciWifiBatchFile& file = _files.at(f);
+	ofxOpenBciWifiRecordingReader reader;
+	if (!reader.open(file.inputPath))
+	{
+		return false;
+	}
+
+	FileJob& job = *_jobs.at(f);
+	ofxOpenBciWifiRecordingBlock block;
+	while (reader.readBlock(block))
+	{
+		while (block.headset >= file.headsets.size())
+		{
+			int h = file.headsets.size();
+			ofxOpenBciWifiRecordingConfig config = reader.getConfig(h);
+			if (config.hpFiltEnabled || config.notchFiltEnabled || config.lpFiltEnabled)
+			{
+				// Only the filtered samples are recorded, filtering them again gives neither the
+				// new settings nor what ofxOpenBciWifi would produce with them
+				ofLogError("ofxOpenBciWifiBatchProcessor") << file.inputPath << " headset #" << h + 1
+					<< " was recorded with filters on, reprocess a capture of the session instead (ofxOpenBciWifi::enableCapture())";
+				return false;
+			}
+			if (config.montageEnabled && _montageEnabled)
+			{
+				ofLogWarning("ofxOpenBciWifiBatchProcessor") << file.inputPath << " headset #" << h + 1
+					<< " was recorded re-referenced, the montage is applied to its outputs";
+			}
+			file.headsets.push_back(ofxOpenBciWifiBatchHeadset());
+			file.headsets.back().ipAddress = config.ipAddress;
+			file.headsets.back().Fs = config.Fs > 0 ? (int)config.Fs : _Fs;
+			file.headsets.back().nChannels = 0;
+			job.headsets.push_back(unique_ptr<HeadsetJob>(new HeadsetJob()));
+		}
+
+		ofxOpenBciWifiBatchHeadset& headset = file.headsets.at(block.headset);
+		vector<float>& frames = job.headsets.at(block.headset)->frames;
+		headset.timestamps.insert(headset.timestamps.end(), block.timestamps.begin(), block.timestamps.end());
+		headset.sampleNumbers.insert(headset.sampleNumbers.end(), block.sampleNumbers.begin(), block.sampleNumbers.end());
+		headset.counts.insert(headset.counts.end(), block.counts.begin(), block.counts.end());
+		// Same channel count rule as ofxOpenBciWifi::processHeadset()
+		headset.nChannels = max(headset.nChannels, min(block.nChannels, OFX_OPENBCI_WIFI_MAX_CHANNELS));
+		size_t pos = frames.size();
+		frames.resize(pos + block.nSamples * OFX_OPENBCI_WIFI_MAX_CHANNELS, 0.f);
+		for (int s = 0; s < block.nSamples; s++)
+		{
+			copy(block.data.begin() + s * block.nChannels, block.data.begin() + s * block.nChannels + min(block.nChannels, headset.nChannels),
+				frames.begin() + pos + s * OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		}
+	}
+	return true;
+}
+
+void ofxOpenBciWifiBatchProcessor::parseHeadset(int f, int h, int worker)
+{
+	ofxOpenBciWifiBatchHeadset& headset = _files.at(f).headsets.at(h);
+	HeadsetJob& job = *_jobs.at(f)->headsets.at(h);
+	ofxOpenBciWifiJsonParser jsonParser;
+	ofxOpenBciWifiRawDecoder rawDecoder;
+	vector<ofxOpenBciWifiSample> samples;
+	for (size_t pos = 0; pos < job.bytes.size(); pos += BATCH_PARSE_BYTES)
+	{
+		size_t nBytes = min((size_t)BATCH_PARSE_BYTES, job.bytes.size() - pos);
+		samples.clear();
+		if (_dataFormat == OFX_OPENBCI_WIFI_FORMAT_RAW)
+		{
+			rawDecoder.parse(job.bytes.data() + pos, nBytes, samples);
+		}
+		else
+		{
+			jsonParser.parse(job.bytes.data() + pos, nBytes, samples);
+		}
+
+		size_t frame = job.frames.size();
+		job.frames.resize(frame + samples.size() * OFX_OPENBCI_WIFI_MAX_CHANNELS, 0.f);
+		for (int s = 0; s < samples.size(); s++, frame += OFX_OPENBCI_WIFI_MAX_CHANNELS)
+		{
+			const ofxOpenBciWifiSample& sample = samples.at(s);
+			headset.timestamps.push_back(sample.timestamp);
+			headset.sampleNumbers.push_back(sample.sampleNumber);
+			headset.counts.push_back(sample.count);
+			headset.nChannels = max(headset.nChannels, min(sample.nChannels, OFX_OPENBCI_WIFI_MAX_CHANNELS));
+			copy(sample.data, sample.data + min(sample.nChannels, headset.nChannels), job.frames.begin() + frame);
+		}
+	}
+	string().swap(job.bytes);
+	startChannels(f, h, worker);
+}
+
+void ofxOpenBciWifiBatchProcessor::startChannels(int f, int h, int worker)
+{
+	ofxOpenBciWifiBatchHeadset& headset = _files.at(f).headsets.at(h);
+	HeadsetJob& job = *_jobs.at(f)->headsets.at(h);
+	size_t nSamples = headset.timestamps.size();
+	_nSamples += nSamples;
+
+	// Same montage for the decoded channel count as ofxOpenBciWifi::setupChannels()
+	job.nFilterChannels = headset.nChannels;
+	if (_montageEnabled)
+	{
+		job.montage = _montage;
+		job.montage.setup(headset.nChannels);
+		headset.nChannels = job.montage.getOutputCount();
+		if (_montageBeforeFilters)
+		{
+			job.nFilterChannels = headset.nChannels;
+			if (nSamples > 0)
+			{
+				job.montage.process(&job.frames[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+			}
+		}
+	}
+
+	headset.data.resize(headset.nChannels);
+	headset.fft.resize(headset.nChannels);
+	headset.fftBins = 0;
+	headset.fftWindowSize = 0;
+	headset.fftHopSize = 0;
+	if (_fftEnabled && headset.Fs > 1)
+	{
+		// Sized like ofxOpenBciWifi does, by default Fs samples each half overlapping the window before
+		headset.fftWindowSize = _fftWindowSize > 0 ? _fftWindowSize : headset.Fs;
+		if (_efficientFftSizesEnabled)
+		{
+			headset.fftWindowSize = ofxOpenBciWifiFftEngine::getEfficientSize(headset.fftWindowSize);
+		}
+		headset.fftWindowSize = max(headset.fftWindowSize, 2);
+		headset.fftHopSize = _fftHopSize > 0 ? _fftHopSize : headset.fftWindowSize - headset.fftWindowSize / 2;
+		headset.fftBins = headset.fftWindowSize / 2;
+		for (size_t end = headset.fftWindowSize; end <= nSamples; end += headset.fftHopSize)
+		{
+			headset.fftSamples.push_back(end);
+		}
+	}
+
+	int nGroups = (job.nFilterChannels + OFX_OPENBCI_WIFI_FILTER_LANES - 1) / OFX_OPENBCI_WIFI_FILTER_LANES;
+	if (nSamples == 0 || nGroups == 0)
+	{
+		finishHeadset(f);
+		return;
+	}
+	job.nGroupsLeft = nGroups;
+	for (int g = 0; g < nGroups; g++)
+	{
+		int firstChannel = g * OFX_OPENBCI_WIFI_FILTER_LANES;
+		_pool.push([this, f, h, firstChannel](int worker) { processChannels(f, h, firstChannel, worker); }, worker);
+	}
+}
+
+void ofxOpenBciWifiBatchProcessor::processChannels(int f, int h, int firstChannel, int worker)
+{
+	ofxOpenBciWifiBatchHeadset& headset = _files.at(f).headsets.at(h);
+	HeadsetJob& job = *_jobs.at(f)->headsets.at(h);
+	size_t nSamples = headset.timestamps.size();
+	int nChannels = min(OFX_OPENBCI_WIFI_FILTER_LANES, job.nFilterChannels - firstChannel);
+	// The montage needs every filtered channel, so they go back into the frames until it runs
+	bool rereferenceAfter = _montageEnabled && !_montageBeforeFilters;
+
+	// ** Filter, the coefficients come out of the same designs as ofxOpenBciWifi's **
+	ofxOpenBciWifiFilterBank filters;
+	filters.addStage(ofxOpenBciWifiFilterDesign::highpass(_hpFiltFamily, _hpFiltOrder, _hpFiltFreq / headset.Fs, _hpFiltRipple));	// FILTER_HP
+	filters.addStage(ofxOpenBciWifiFilterDesign::harmonicNotch(_notchFiltFreq / headset.Fs, _notchFiltHarmonics, _notchFiltQ));	// FILTER_NOTCH
+	filters.addStage(ofxOpenBciWifiFilterDesign::lowpass(_lpFiltFamily, _lpFiltOrder, _lpFiltFreq / headset.Fs, _lpFiltRipple));	// FILTER_LP
+	filters.setup(nChannels);
+	filters.setEnabled(FILTER_HP, _hpFiltEnabled);
+	filters.setEnabled(FILTER_NOTCH, _notchFiltEnabled);
+	filters.setEnabled(FILTER_LP, _lpFiltEnabled);
+
+	for (int ch = firstChannel; ch < firstChannel + nChannels && !rereferenceAfter; ch++)
+	{
+		headset.data.at(ch).resize(nSamples);
+	}
+	// Lanes filter independently, so the group's own copy gives the same values as the whole frame
+	vector<float> block(BATCH_FILTER_FRAMES * OFX_OPENBCI_WIFI_FILTER_LANES);
+	for (size_t start = 0; start < nSamples; start += BATCH_FILTER_FRAMES)
+	{
+		int nFrames = min((size_t)BATCH_FILTER_FRAMES, nSamples - start);
+		float* frames = &job.frames[start * OFX_OPENBCI_WIFI_MAX_CHANNELS + firstChannel];
+		for (int s = 0; s < nFrames; s++)
+		{
+			memcpy(&block[s * OFX_OPENBCI_WIFI_FILTER_LANES], frames + s * OFX_OPENBCI_WIFI_MAX_CHANNELS, OFX_OPENBCI_WIFI_FILTER_LANES * sizeof(float));
+		}
+		filters.process(&block[0], nFrames, OFX_OPENBCI_WIFI_FILTER_LANES);
+		for (int l = 0; l < nChannels; l++)
+		{
+			if (rereferenceAfter)
+			{
+				// Only this group's channels, the other groups write theirs concurrently
+				for (int s = 0; s < nFrames; s++)
+				{
+					frames[s * OFX_OPENBCI_WIFI_MAX_CHANNELS + l] = block[s * OFX_OPENBCI_WIFI_FILTER_LANES + l];
+				}
+				continue;
+			}
+			float* data = &headset.data.at(firstChannel + l)[start];
+			for (int s = 0; s < nFrames; s++)
+			{
+				data[s] = block[s * OFX_OPENBCI_WIFI_FILTER_LANES + l];
+			}
+		}
+	}
+
+	if (rereferenceAfter)
+	{
+		if (--job.nGroupsLeft == 0)
+		{
+			rereferenceHeadset(f, h, worker);
+		}
+		return;
+	}
+	transformChannels(f, h, firstChannel, worker);
+}
+
+void ofxOpenBciWifiBatchProcessor::rereferenceHeadset(int f, int h, int worker)
+{
+	// Every group is filtered, re-reference the whole frames like ofxOpenBciWifi does after its filters
+	ofxOpenBciWifiBatchHeadset& headset = _files.at(f).headsets.at(h);
+	HeadsetJob& job = *_jobs.at(f)->headsets.at(h);
+	size_t nSamples = headset.timestamps.size();
+	job.montage.process(&job.frames[0], nSamples, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	for (int ch = 0; ch < headset.nChannels; ch++)
+	{
+		vector<float>& data = headset.data.at(ch);
+		data.resize(nSamples);
+		for (size_t s = 0; s < nSamples; s++)
+		{
+			data[s] = job.frames[s * OFX_OPENBCI_WIFI_MAX_CHANNELS + ch];
+		}
+	}
+
+	int nGroups = (headset.nChannels + OFX_OPENBCI_WIFI_FILTER_LANES - 1) / OFX_OPENBCI_WIFI_FILTER_LANES;
+	if (nGroups == 0)
+	{
+		vector<float>().swap(job.frames);
+		finishHeadset(f);
+		return;
+	}
+	job.nGroupsLeft = nGroups;
+	for (int g = 0; g < nGroups; g++)
+	{
+		int firstChannel = g * OFX_OPENBCI_WIFI_FILTER_LANES;
+		_pool.push([this, f, h, firstChannel](int worker) { transformChannels(f, h, firstChannel, worker); }, worker);
+	}
+}
+
+void ofxOpenBciWifiBatchProcessor::transformChannels(int f, int h, int firstChannel, int worker)
+{
+	ofxOpenBciWifiBatchHeadset& headset = _files.at(f).headsets.at(h);
+	HeadsetJob& job = *_jobs.at(f)->headsets.at(h);
+	int nChannels = min(OFX_OPENBCI_WIFI_FILTER_LANES, headset.nChannels - firstChannel);
+
+	// ** FFT, one window at a time so the smoothing sees the spectrum before it **
+	if (headset.fftBins > 0)
+	{
+		ofxOpenBciWifiFftEngine& engine = *_fftEngines.at(worker);
+		int windowSize = headset.fftWindowSize;
+		int hop = headset.fftHopSize;
+		engine.setWelchSegments(_welchSegments);
+		if (_multitaperEnabled)
+		{
+			// Keeps the worker's tapers while the settings don't change
+			engine.enableMultitaper(_timeHalfBandwidth, _nTapers);
+		}
+		else
+		{
+			engine.disableMultitaper();
+		}
+		{
+			ofScopedLock planLock(_planMutex);
+			engine.prepare(windowSize, _fftWindowType);
+		}
+		for (int ch = firstChannel; ch < firstChannel + nChannels; ch++)
+		{
+			ofxOpenBciWifiWelchHistory history;
+			vector<float>& fft = headset.fft.at(ch);
+			fft.assign(headset.fftSamples.size() * headset.fftBins, 0.f);
+			for (int k = 0; k < headset.fftSamples.size(); k++)
+			{
+				float* spectrum = &fft[k * headset.fftBins];
+				if (k > 0)
+				{
+					memcpy(spectrum, spectrum - headset.fftBins, headset.fftBins * sizeof(float));
+				}
+				engine.queue(&headset.data.at(ch)[k * hop], windowSize, spectrum, _fftWindowType, &history);
+				engine.run(_fftSmoothingEnabled, _fftSmoothingNewDataWeight);
+			}
+		}
+	}
+
+	if (--job.nGroupsLeft == 0)
+	{
+		vector<float>().swap(job.frames);
+		finishHeadset(f);
+	}
+}
+
+void ofxOpenBciWifiBatchProcessor::finishHeadset(int f)
+{
+	if (--_jobs.at(f)->nHeadsetsLeft == 0 && !_files.at(f).outputPath.empty())
+	{
+		writeFile(f);
+	}
+}
+
+void ofxOpenBciWifiBatchProcessor::writeFile(int f)
+{
+	ofxOpenBciWifiBatchFile& file = _files.at(f);
+	ofxOpenBciWifiRecordingWriter writer;
+	writer.enableBlocking();
+	if (!writer.open(file.outputPath))
+	{
+		return;
+	}
+
+	vector<ofxOpenBciWifiSample> samples(BATCH_WRITE_SAMPLES);
+	vector<float> frames;
+	for (int h = 0; h < file.headsets.size(); h++)
+	{
+		const ofxOpenBciWifiBatchHeadset& headset = file.headsets.at(h);
+		ofxOpenBciWifiRecordingConfig config;
+		memset(&config, 0, sizeof(config));
+		config.Fs = headset.Fs;
+		config.nChannels = headset.nChannels;
+		config.dataFormat = _dataFormat;
+		config.hpFiltEnabled = _hpFiltEnabled;
+		config.notchFiltEnabled = _notchFiltEnabled;
+		config.lpFiltEnabled = _lpFiltEnabled;
+		config.hpFiltFreq = _hpFiltFreq;
+		config.notchFiltFreq = _notchFiltFreq;
+		config.lpFiltFreq = _lpFiltFreq;
+		config.montageEnabled = _montageEnabled;
+		strncpy(config.ipAddress, headset.ipAddress.c_str(), sizeof(config.ipAddress) - 1);
+		writer.writeConfig(h, config);
+
+		frames.resize(BATCH_WRITE_SAMPLES * max(headset.nChannels, 1));
+		for (size_t start = 0; start < headset.timestamps.size(); start += BATCH_WRITE_SAMPLES)
+		{
+			int nSamples = min((size_t)BATCH_WRITE_SAMPLES, headset.timestamps.size() - start);
+			for (int s = 0; s < nSamples; s++)
+			{
+				samples.at(s).timestamp = headset.timestamps.at(start + s);
+				samples.at(s).sampleNumber = headset.sampleNumbers.at(start + s);
+				samples.at(s).count = headset.counts.at(start + s);
+				for (int ch = 0; ch < headset.nChannels; ch++)
+				{
+					frames[s * headset.nChannels + ch] = headset.data.at(ch)[start + s];
+				}
+			}
+			writer.writeBlock(h, &samples[0], &frames[0], nSamples, headset.nChannels, headset.nChannels);
+		}
+	}
+	writer.close();
+}
@@ -0,0 +1,159 @@
+//
+//  ofxOpenBciWifiBatchProcessor.h
+//
+//  Offline reprocessing of recorded sessions with other filter or FFT settings. Files are
+//  loaded and parsed in parallel, then every group of OFX_OPENBCI_WIFI_FILTER_LANES channels
+//  of every headset is filtered and transformed as its own task on an ofxOpenBciWifiWorkPool.
+//  The filter bank, parsers and FFT engine are the ones ofxOpenBciWifi runs online, with the
+//  same coefficients, window positions, smoothing and PSD averaging, so the filtered samples and spectra are
+//  bit for bit what ofxOpenBciWifi produces with the same settings.
+//  A montage before the filters re-references the frames before they are split into groups, one
+//  after them runs once every group is filtered, between the filter and the FFT tasks.
+//  Captures (.cap) hold the received bytes and are parsed with the set data format. Recordings
+//  only hold the filtered samples, so only ones made with every filter off can be reprocessed.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiWorkPool.h"
+#include "ofxOpenBciWifiFilterBank.h"
+#include "ofxOpenBciWifiMontage.h"
+#include "ofxOpenBciWifiFftEngine.h"
+#include "ofxOpenBciWifiRecording.h"
+
+struct ofxOpenBciWifiBatchHeadset
+{
+	string ipAddress;
+	int Fs;
+	int nChannels;
+	vector<double> timestamps;
+	vector<int32_t> sampleNumbers;
+	vector<int32_t> counts;
+	vector<vector<float>> data;					// Channels x Samples, filtered
+	int fftWindowSize;							// 0 with the FFT off
+	int fftHopSize;
+	int fftBins;								// Per spectrum, 0 with the FFT off
+	vector<uint64_t> fftSamples;				// Samples in when each spectrum was computed
+	vector<vector<float>> fft;					// Channels x (Spectra x fftBins), in dB like getLatestFft()
+};
+
+struct ofxOpenBciWifiBatchFile
+{
+	string inputPath;
+	string outputPath;							// Recording of the reprocessed samples, empty for none
+	bool loaded;
+	vector<ofxOpenBciWifiBatchHeadset> headsets;
+};
+
+class ofxOpenBciWifiBatchProcessor
+{
+private:
+	struct HeadsetJob
+	{
+		string bytes;							// Received bytes of a capture
+		vector<float> frames;					// Samples x OFX_OPENBCI_WIFI_MAX_CHANNELS before filtering
+		ofxOpenBciWifiMontage montage;
+		int nFilterChannels;					// Decoded channels when the montage comes after the filters
+		atomic<int> nGroupsLeft;
+	};
+
+	struct FileJob
+	{
+		vector<unique_ptr<HeadsetJob>> headsets;
+		atomic<int> nHeadsetsLeft;
+	};
+
+	int _Fs;
+	ofxOpenBciWifiDataFormat _dataFormat;
+	bool _hpFiltEnabled;
+	float _hpFiltFreq;
+	int _hpFiltOrder;
+	ofxOpenBciWifiFilterFamily _hpFiltFamily;
+	float _hpFiltRipple;
+	bool _notchFiltEnabled;
+	float _notchFiltFreq;
+	int _notchFiltHarmonics;
+	float _notchFiltQ;
+	bool _lpFiltEnabled;
+	float _lpFiltFreq;
+	int _lpFiltOrder;
+	ofxOpenBciWifiFilterFamily _lpFiltFamily;
+	float _lpFiltRipple;
+	bool _montageEnabled;
+	bool _montageBeforeFilters;
+	ofxOpenBciWifiMontage _montage;
+	bool _fftEnabled;
+	int _fftWindowSize;
+	int _fftHopSize;
+	fftWindowType _fftWindowType;
+	bool _efficientFftSizesEnabled;
+	bool _fftSmoothingEnabled;
+	float _fftSmoothingNewDataWeight;
+	int _welchSegments;
+	bool _multitaperEnabled;
+	float _timeHalfBandwidth;
+	int _nTapers;
+	int _nThreads;
+
+	vector<ofxOpenBciWifiBatchFile> _files;
+	vector<unique_ptr<FileJob>> _jobs;
+	ofxOpenBciWifiWorkPool _pool;
+	vector<unique_ptr<ofxOpenBciWifiFftEngine>> _fftEngines;	// One per worker
+	ofMutex _planMutex;							// Creating ofxFft plans is not thread safe
+	atomic<uint64_t> _nSamples;
+	float _runSeconds;
+
+	void loadFile(int f, int worker);
+	bool loadCapture(int f);
+	bool loadRecording(int f);
+	void parseHeadset(int f, int h, int worker);
+	void startChannels(int f, int h, int worker);
+	void processChannels(int f, int h, int firstChannel, int worker);
+	void rereferenceHeadset(int f, int h, int worker);
+	void transformChannels(int f, int h, int firstChannel, int worker);
+	void finishHeadset(int f);
+	void writeFile(int f);
+
+public:
+	ofxOpenBciWifiBatchProcessor(int samplingFreq = 250);	// Of captures and recordings without one
+
+	// The defaults match ofxOpenBciWifi
+	void setDataFormat(ofxOpenBciWifiDataFormat format);	// Of the captures
+	ofxOpenBciWifiDataFormat getDataFormat();
+	void enableHPFilter(float freq, int order = 2, ofxOpenBciWifiFilterFamily family = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH, float rippleDb = 0.5f);
+	void disableHPFilter();
+	void enableLPFilter(float freq, int order = 2, ofxOpenBciWifiFilterFamily family = OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH, float rippleDb = 0.5f);
+	void disableLPFilter();
+	void enableNotchFilter(float freq, int nHarmonics = 1, float Q = 0.7071f);
+	void disableNotchFilter();
+	void enableMontage(const ofxOpenBciWifiMontage& montage, bool beforeFilters = true);	// As in ofxOpenBciWifi
+	void disableMontage();
+	void enableFft();
+	void enableFft(int windowSize, int hopSize = 0, fftWindowType windowType = OF_FFT_WINDOW_HAMMING);	// As in ofxOpenBciWifi
+	void disableFft();
+	void enableEfficientFftSizes();				// Windows rounded up like ofxOpenBciWifi::enableEfficientFftSizes()
+	void disableEfficientFftSizes();
+	void enableFftSmoothing(float newDataWeight = 0.25f);
+	void disableFftSmoothing();
+	void enableWelchPsd(int nSegments = 4);			// As in ofxOpenBciWifi
+	void disableWelchPsd();
+	void enableMultitaperPsd(float timeHalfBandwidth = 2.f, int nTapers = 0);
+	void disableMultitaperPsd();
+	void setThreadCount(int nThreads);			// 0 = one per core (default)
+	int getThreadCount();
+
+	// Capture (.cap) or recording (anything else), run() fails on recordings made with filters on.
+	// The filtered samples are also written to outputPath as a recording if it is set.
+	int addFile(string inputPath, string outputPath = "");
+	void clearFiles();
+	int getFileCount();
+	const ofxOpenBciWifiBatchFile& getFile(int file);
+
+	// Processes every file and blocks until done. Returns false if a file could not be read.
+	bool run();
+	uint64_t getSampleCount();					// Samples of every headset of the last run
+	float getRunSeconds();
+	uint64_t getStealCount();					// Tasks moved between workers in the last run
+};
@@ -0,0 +1,257 @@
+//
+//  ofxOpenBciWifiBufferPool.cpp
+//
+//  Pooled, fixed size byte chunks for the receive path.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiBufferPool.h"
+
+ofxOpenBciWifiByteQueue::ofxOpenBciWifiByteQueue()
+{
+	_head = NULL;
+	_tail = NULL;
+	_size = 0;
+	_nChunks = 0;
+	_discontinuity = false;
+}
+
+char* ofxOpenBciWifiByteQueue::getWriteBuffer(ofxOpenBciWifiBufferPool& pool, size_t& nBytes)
+{
+	if (_tail == NULL || _tail->size == pool.getChunkSize())
+	{
+		ofxOpenBciWifiChunk* chunk = pool.acquire();
+		if (_tail == NULL)
+		{
+			_head = chunk;
+		}
+		else
+		{
+			_tail->next = chunk;
+		}
+		_tail = chunk;
+		_nChunks++;
+	}
+	nBytes = pool.getChunkSize() - _tail->size;
+	return _tail->data + _tail->size;
+}
+
+void ofxOpenBciWifiByteQueue::commit(size_t nBytes, uint64_t receiveTime)
+{
+	if (_tail->size == 0)
+	{
+		_tail->receiveTime = receiveTime;
+	}
+	_tail->size += nBytes;
+	_size += nBytes;
+}
+
+void ofxOpenBciWifiByteQueue::append(ofxOpenBciWifiByteQueue& other)
+{
+	_discontinuity = _discontinuity || other._discontinuity;
+	if (other._head != NULL)
+	{
+		if (_tail == NULL)
+		{
+			_head = other._head;
+		}
+		else
+		{
+			_tail->next = other._head;
+		}
+		_tail = other._tail;
+		_size += other._size;
+		_nChunks += other._nChunks;
+	}
+	other._head = NULL;
+	other._tail = NULL;
+	other._size = 0;
+	other._nChunks = 0;
+	other._discontinuity = false;
+}
+
+void ofxOpenBciWifiByteQueue::append(ofxOpenBciWifiByteQueue& other, ofxOpenBciWifiBufferPool& pool)
+{
+	_discontinuity = _discontinuity || other.takeDiscontinuity();
+	ofxOpenBciWifiChunk* chunk;
+	while ((chunk = other.popFront()) != NULL)
+	{
+		pushBack(chunk, pool);
+	}
+}
+
+void ofxOpenBciWifiByteQueue::pushBack(ofxOpenBciWifiChunk* chunk)
+{
+	chunk->next = NULL;
+	if (_tail == NULL)
+	{
+		_head = chunk;
+	}
+	else
+	{
+		_tail->next = chunk;
+	}
+	_tail = chunk;
+	_size += chunk->size;
+	_nChunks++;
+}
+
+void ofxOpenBciWifiByteQueue::pushBack(ofxOpenBciWifiChunk* chunk, ofxOpenBciWifiBufferPool& pool)
+{
+	if (_tail == NULL || chunk->size > pool.getChunkSize() - _tail->size)
+	{
+		pushBack(chunk);
+		return;
+	}
+	memcpy(_tail->data + _tail->size, chunk->data, chunk->size);
+	_tail->size += chunk->size;
+	_size += chunk->size;
+	pool.addBytesCopied(chunk->size);
+	pool.release(chunk);
+}
+
+ofxOpenBciWifiChunk* ofxOpenBciWifiByteQueue::getHead()
+{
+	return _head;
+}
+
+ofxOpenBciWifiChunk* ofxOpenBciWifiByteQueue::popFront()
+{
+	ofxOpenBciWifiChunk* chunk = _head;
+	if (chunk != NULL)
+	{
+		_head = chunk->next;
+		if (_head == NULL)
+		{
+			_tail = NULL;
+		}
+		chunk->next = NULL;
+		_size -= chunk->size;
+		_nChunks--;
+	}
+	return chunk;
+}
+
+size_t ofxOpenBciWifiByteQueue::size()
+{
+	return _size;
+}
+
+size_t ofxOpenBciWifiByteQueue::getChunkCount()
+{
+	return _nChunks;
+}
+
+bool ofxOpenBciWifiByteQueue::empty()
+{
+	return _head == NULL;
+}
+
+void ofxOpenBciWifiByteQueue::markDiscontinuity()
+{
+	_discontinuity = true;
+}
+
+bool ofxOpenBciWifiByteQueue::takeDiscontinuity()
+{
+	bool discontinuity = _discontinuity;
+	_discontinuity = false;
+	return discontinuity;
+}
+
+ofxOpenBciWifiBufferPool::ofxOpenBciWifiBufferPool(size_t chunkSize)
+{
+	_chunkSize = chunkSize;
+	_chunkAllocations = 0;
+	_bytesReceived = 0;
+	_bytesCopied = 0;
+}
+
+ofxOpenBciWifiBufferPool::~ofxOpenBciWifiBufferPool()
+{
+	for (int i = 0; i < _all.size(); i++)
+	{
+		delete[] _all.at(i)->data;
+		delete _all.at(i);
+	}
+}
+
+ofxOpenBciWifiChunk* ofxOpenBciWifiBufferPool::allocate()
+{
+	ofxOpenBciWifiChunk* chunk = new ofxOpenBciWifiChunk();
+	chunk->data = new char[_chunkSize];
+	chunk->size = 0;
+	chunk->receiveTime = 0;
+	chunk->next = NULL;
+	_all.push_back(chunk);
+	_free.reserve(_all.size());
+	_chunkAllocations++;
+	return chunk;
+}
+
+void ofxOpenBciWifiBufferPool::reserve(size_t nChunks)
+{
+	ofScopedLock lock(_mutex);
+	while (_all.size() < nChunks)
+	{
+		_free.push_back(allocate());
+	}
+}
+
+size_t ofxOpenBciWifiBufferPool::getChunkSize()
+{
+	return _chunkSize;
+}
+
+ofxOpenBciWifiChunk* ofxOpenBciWifiBufferPool::acquire()
+{
+	ofScopedLock lock(_mutex);
+	if (_free.empty())
+	{
+		return allocate();
+	}
+	ofxOpenBciWifiChunk* chunk = _free.back();
+	_free.pop_back();
+	return chunk;
+}
+
+void ofxOpenBciWifiBufferPool::release(ofxOpenBciWifiChunk* chunk)
+{
+	chunk->size = 0;
+	chunk->receiveTime = 0;
+	chunk->next = NULL;
+	ofScopedLock lock(_mutex);
+	_free.push_back(chunk);
+}
+
+void ofxOpenBciWifiBufferPool::release(ofxOpenBciWifiByteQueue& queue)
+{
+	ofxOpenBciWifiChunk* chunk;
+	while ((chunk = queue.popFront()) != NULL)
+	{
+		release(chunk);
+	}
+}
+
+void ofxOpenBciWifiBufferPool::addBytesReceived(size_t nBytes)
+{
+	_bytesReceived += nBytes;
+}
+
+void ofxOpenBciWifiBufferPool::addBytesCopied(size_t nBytes)
+{
+	_bytesCopied += nBytes;
+}
+
+ofxOpenBciWifiBufferStats ofxOpenBciWifiBufferPool::getStats()
+{
+	ofScopedLock lock(_mutex);
+	ofxOpenBciWifiBufferStats stats;
+	stats.chunkAllocations = _chunkAllocations;
+	stats.bytesReceived = _bytesReceived;
+	stats.bytesCopied = _bytesCopied;
+	stats.chunksFree = _free.size();
+	stats.chunksInUse = _all.size() - _free.size();
+	return stats;
+}
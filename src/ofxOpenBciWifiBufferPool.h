@@ -0,0 +1,104 @@
+//
+//  ofxOpenBciWifiBufferPool.h
+//
+//  Pooled, fixed size byte chunks for the receive path. Sockets read straight into
+//  the tail chunk of a per-headset queue, and whole queues are handed between the
+//  network, processing and update() threads by moving chunk pointers. Bytes are only copied
+//  to pack partly filled chunks into a queue that is backing up.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+struct ofxOpenBciWifiChunk
+{
+	char* data;
+	size_t size;							// Bytes used
+	uint64_t receiveTime;					// ofGetElapsedTimeMicros() when the first byte arrived
+	ofxOpenBciWifiChunk* next;
+};
+
+struct ofxOpenBciWifiBufferStats
+{
+	uint64_t chunkAllocations;				// Chunks allocated from the heap since setup
+	uint64_t bytesReceived;
+	uint64_t bytesCopied;					// Received bytes copied after the socket read
+	size_t chunksInUse;
+	size_t chunksFree;
+};
+
+class ofxOpenBciWifiBufferPool;
+
+// FIFO of chunks. Not thread safe, guard it with the lock of whoever owns it.
+class ofxOpenBciWifiByteQueue
+{
+private:
+	ofxOpenBciWifiChunk* _head;
+	ofxOpenBciWifiChunk* _tail;
+	size_t _size;
+	size_t _nChunks;
+	bool _discontinuity;
+
+public:
+	ofxOpenBciWifiByteQueue();
+
+	// Returns room at the end of the queue for at least one byte, taking a chunk from pool if needed
+	char* getWriteBuffer(ofxOpenBciWifiBufferPool& pool, size_t& nBytes);
+	// nBytes were written into the buffer returned by getWriteBuffer at receiveTime
+	void commit(size_t nBytes, uint64_t receiveTime);
+
+	// Moves every chunk of other onto the end of this queue
+	void append(ofxOpenBciWifiByteQueue& other);
+	// Same with pushBack(chunk, pool), for queues that are appended to while they back up
+	void append(ofxOpenBciWifiByteQueue& other, ofxOpenBciWifiBufferPool& pool);
+	void pushBack(ofxOpenBciWifiChunk* chunk);
+	// Copies chunk into the room left in the tail chunk and returns it to pool if it fits,
+	// otherwise moves it like pushBack(). Any two neighbouring chunks then hold more than a
+	// chunk's worth of bytes, so a size limit bounds the chunks held too.
+	void pushBack(ofxOpenBciWifiChunk* chunk, ofxOpenBciWifiBufferPool& pool);
+	ofxOpenBciWifiChunk* getHead();
+	ofxOpenBciWifiChunk* popFront();
+
+	size_t size();
+	size_t getChunkCount();
+	bool empty();
+
+	// Flags that bytes were dropped, so the parser has to resync
+	void markDiscontinuity();
+	bool takeDiscontinuity();
+};
+
+class ofxOpenBciWifiBufferPool
+{
+private:
+	size_t _chunkSize;
+	ofMutex _mutex;
+	vector<ofxOpenBciWifiChunk*> _all;
+	vector<ofxOpenBciWifiChunk*> _free;
+
+	atomic<uint64_t> _chunkAllocations;
+	atomic<uint64_t> _bytesReceived;
+	atomic<uint64_t> _bytesCopied;
+
+	ofxOpenBciWifiChunk* allocate();
+
+public:
+	ofxOpenBciWifiBufferPool(size_t chunkSize = 16384);
+	~ofxOpenBciWifiBufferPool();
+
+	// Preallocates chunks so the steady state never touches the heap
+	void reserve(size_t nChunks);
+	size_t getChunkSize();
+
+	ofxOpenBciWifiChunk* acquire();
+	void release(ofxOpenBciWifiChunk* chunk);
+	// Returns every chunk of queue to the pool and leaves it empty
+	void release(ofxOpenBciWifiByteQueue& queue);
+
+	void addBytesReceived(size_t nBytes);
+	void addBytesCopied(size_t nBytes);
+	ofxOpenBciWifiBufferStats getStats();
+};
@@ -0,0 +1,148 @@
+//
+//  ofxOpenBciWifiCapture.cpp
+//
+//  Records the bytes received from every headset.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiCapture.h"
+
+#define CAPTURE_MAX_PENDING (64 * 1024 * 1024)	// Bytes queued before records are dropped
+#define CAPTURE_WRITE_INTERVAL 100				// Milliseconds between batched writes
+
+ofxOpenBciWifiCaptureWriter::ofxOpenBciWifiCaptureWriter()
+{
+	_file = NULL;
+	_startTime = 0;
+	_maxPending = CAPTURE_MAX_PENDING;
+	_bytesWritten = 0;
+	_droppedBytes = 0;
+}
+
+ofxOpenBciWifiCaptureWriter::~ofxOpenBciWifiCaptureWriter()
+{
+	close();
+}
+
+bool ofxOpenBciWifiCaptureWriter::open(string filePath, uint64_t now)
+{
+	close();
+	_file = fopen(ofToDataPath(filePath).c_str(), "wb");
+	if (_file == NULL)
+	{
+		ofLogError("ofxOpenBciWifiCaptureWriter") << "Could not open " << filePath;
+		return false;
+	}
+	fwrite(OFX_OPENBCI_WIFI_CAPTURE_MAGIC, 1, OFX_OPENBCI_WIFI_CAPTURE_MAGIC_LEN, _file);
+	_startTime = now;
+	_bytesWritten = OFX_OPENBCI_WIFI_CAPTURE_MAGIC_LEN;
+	_droppedBytes = 0;
+	_pending.clear();
+	_pending.reserve(1024 * 1024);
+	startThread();
+	return true;
+}
+
+void ofxOpenBciWifiCaptureWriter::close()
+{
+	if (isThreadRunning())
+	{
+		waitForThread(true);
+	}
+	if (_file != NULL)
+	{
+		writePending();
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+bool ofxOpenBciWifiCaptureWriter::isOpen()
+{
+	return _file != NULL;
+}
+
+uint64_t ofxOpenBciWifiCaptureWriter::getBytesWritten()
+{
+	lock();
+	uint64_t n = _bytesWritten;
+	unlock();
+	return n;
+}
+
+uint64_t ofxOpenBciWifiCaptureWriter::getDroppedBytes()
+{
+	lock();
+	uint64_t n = _droppedBytes;
+	unlock();
+	return n;
+}
+
+void ofxOpenBciWifiCaptureWriter::writeRecord(ofxOpenBciWifiCaptureRecordType type, int headset, const char* payload, size_t nBytes, uint64_t now)
+{
+	if (_file == NULL)
+	{
+		return;
+	}
+	char header[OFX_OPENBCI_WIFI_CAPTURE_RECORD_HEADER];
+	uint64_t micros = now - _startTime;
+	uint32_t fields[3] = { (uint32_t)type, (uint32_t)headset, (uint32_t)nBytes };
+	memcpy(header, &micros, sizeof(micros));
+	memcpy(header + sizeof(micros), fields, sizeof(fields));
+	lock();
+	if (_pending.size() + sizeof(header) + nBytes > _maxPending)
+	{
+		_droppedBytes += sizeof(header) + nBytes;
+	}
+	else
+	{
+		_pending.append(header, sizeof(header));
+		if (nBytes > 0)
+		{
+			_pending.append(payload, nBytes);
+		}
+	}
+	unlock();
+}
+
+void ofxOpenBciWifiCaptureWriter::writePending()
+{
+	// Swap so the network thread never waits on the disk
+	lock();
+	swap(_pending, _writing);
+	unlock();
+	if (_writing.empty())
+	{
+		return;
+	}
+	fwrite(_writing.data(), 1, _writing.size(), _file);
+	lock();
+	_bytesWritten += _writing.size();
+	unlock();
+	_writing.clear();
+}
+
+void ofxOpenBciWifiCaptureWriter::threadedFunction()
+{
+	while (isThreadRunning())
+	{
+		writePending();
+		sleep(CAPTURE_WRITE_INTERVAL);
+	}
+}
+
+void ofxOpenBciWifiCaptureWriter::writeConnect(int headset, const string& ip, uint64_t now)
+{
+	writeRecord(OFX_OPENBCI_WIFI_CAPTURE_CONNECT, headset, ip.data(), ip.size(), now);
+}
+
+void ofxOpenBciWifiCaptureWriter::writeData(int headset, const char* bytes, size_t nBytes, uint64_t now)
+{
+	writeRecord(OFX_OPENBCI_WIFI_CAPTURE_DATA, headset, bytes, nBytes, now);
+}
+
+void ofxOpenBciWifiCaptureWriter::writeDisconnect(int headset, uint64_t now)
+{
+	writeRecord(OFX_OPENBCI_WIFI_CAPTURE_DISCONNECT, headset, NULL, 0, now);
+}
@@ -0,0 +1,62 @@
+//
+//  ofxOpenBciWifiCapture.h
+//
+//  Records the bytes received from every headset, with their arrival times, so a session
+//  can be played back through the same pipeline by ofxOpenBciWifiReplaySource.
+//  File layout, native byte order:
+//    "OBWCAP01"
+//    records of uint64 microseconds since the capture started, uint32 type,
+//    uint32 headset, uint32 nBytes, followed by nBytes of payload
+//  The payload is the ip address for OFX_OPENBCI_WIFI_CAPTURE_CONNECT and the received bytes
+//  for OFX_OPENBCI_WIFI_CAPTURE_DATA.
+//  Records are queued in memory and written by a background thread, like
+//  ofxOpenBciWifiRecordingWriter, so a slow disk never holds up the socket reads.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+#define OFX_OPENBCI_WIFI_CAPTURE_MAGIC "OBWCAP01"
+#define OFX_OPENBCI_WIFI_CAPTURE_MAGIC_LEN 8
+#define OFX_OPENBCI_WIFI_CAPTURE_RECORD_HEADER 20
+
+enum ofxOpenBciWifiCaptureRecordType
+{
+	OFX_OPENBCI_WIFI_CAPTURE_CONNECT,
+	OFX_OPENBCI_WIFI_CAPTURE_DATA,
+	OFX_OPENBCI_WIFI_CAPTURE_DISCONNECT
+};
+
+class ofxOpenBciWifiCaptureWriter : public ofThread
+{
+private:
+	FILE* _file;
+	uint64_t _startTime;
+	string _pending;					// Records waiting for the writer thread, guarded by lock()
+	string _writing;					// Records being written
+	size_t _maxPending;
+	uint64_t _bytesWritten;
+	uint64_t _droppedBytes;
+
+	void threadedFunction();
+	void writeRecord(ofxOpenBciWifiCaptureRecordType type, int headset, const char* payload, size_t nBytes, uint64_t now);
+	void writePending();
+
+public:
+	ofxOpenBciWifiCaptureWriter();
+	~ofxOpenBciWifiCaptureWriter();
+
+	bool open(string filePath, uint64_t now);
+	void close();						// Writes what is still pending
+	bool isOpen();
+	uint64_t getBytesWritten();
+	uint64_t getDroppedBytes();			// Records thrown away because the disk could not keep up
+
+	// now = ofGetElapsedTimeMicros()
+	void writeConnect(int headset, const string& ip, uint64_t now);
+	void writeData(int headset, const char* bytes, size_t nBytes, uint64_t now);
+	void writeDisconnect(int headset, uint64_t now);
+};
@@ -0,0 +1,162 @@
+//
+//  ofxOpenBciWifiChannelKernels.cpp
+//
+//  Per channel count loops of a headset's processing pass.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiChannelKernels.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OFX_OPENBCI_WIFI_KERNELS_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OFX_OPENBCI_WIFI_KERNELS_NEON
+#endif
+
+// 4 channels of 4 frames, stride floats apart, into 4 rows of the ring, rowStride floats apart
+static inline void transpose4x4(const float* in, int stride, float* out, int rowStride)
+{
+#if defined(OFX_OPENBCI_WIFI_KERNELS_SSE)
+	__m128 r0 = _mm_loadu_ps(in);
+	__m128 r1 = _mm_loadu_ps(in + stride);
+	__m128 r2 = _mm_loadu_ps(in + 2 * stride);
+	__m128 r3 = _mm_loadu_ps(in + 3 * stride);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(out, r0);
+	_mm_storeu_ps(out + rowStride, r1);
+	_mm_storeu_ps(out + 2 * rowStride, r2);
+	_mm_storeu_ps(out + 3 * rowStride, r3);
+#elif defined(OFX_OPENBCI_WIFI_KERNELS_NEON)
+	float32x4x2_t t01 = vtrnq_f32(vld1q_f32(in), vld1q_f32(in + stride));
+	float32x4x2_t t23 = vtrnq_f32(vld1q_f32(in + 2 * stride), vld1q_f32(in + 3 * stride));
+	vst1q_f32(out, vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+	vst1q_f32(out + rowStride, vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+	vst1q_f32(out + 2 * rowStride, vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+	vst1q_f32(out + 3 * rowStride, vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+#else
+	for (int ch = 0; ch < 4; ch++)
+	{
+		for (int s = 0; s < 4; s++)
+		{
+			out[ch * rowStride + s] = in[s * stride + ch];
+		}
+	}
+#endif
+}
+
+ofxOpenBciWifiChannelKernels::ofxOpenBciWifiChannelKernels()
+{
+	setup(0);
+}
+
+void ofxOpenBciWifiChannelKernels::setup(int nChannels, bool specialize)
+{
+	_nChannels = max(0, min(nChannels, OFX_OPENBCI_WIFI_MAX_CHANNELS));
+	_specialized = true;
+	switch (specialize ? _nChannels : 0)
+	{
+	case 4:
+		_gather = &gatherFrames<4>;
+		_scatter = &scatterFrames<4>;
+		break;
+	case 8:
+		_gather = &gatherFrames<8>;
+		_scatter = &scatterFrames<8>;
+		break;
+	case 16:
+		_gather = &gatherFrames<16>;
+		_scatter = &scatterFrames<16>;
+		break;
+	default:
+		_gather = &gatherFrames<0>;
+		_scatter = &scatterFrames<0>;
+		_specialized = false;
+		break;
+	}
+}
+
+int ofxOpenBciWifiChannelKernels::getChannelCount()
+{
+	return _nChannels;
+}
+
+bool ofxOpenBciWifiChannelKernels::isSpecialized()
+{
+	return _specialized;
+}
+
+void ofxOpenBciWifiChannelKernels::gather(const ofxOpenBciWifiSample* samples, int nSamples, float* frames, int stride)
+{
+	_gather(samples, nSamples, _nChannels, frames, stride);
+}
+
+void ofxOpenBciWifiChannelKernels::scatter(const float* frames, int nFrames, int stride, float* ring, int ringPos, int windowSize)
+{
+	_scatter(frames, nFrames, stride, _nChannels, ring + ringPos, windowSize);
+}
+
+template <int NChannels>
+void ofxOpenBciWifiChannelKernels::gatherFrames(const ofxOpenBciWifiSample* samples, int nSamples, int nChannels, float* frames, int stride)
+{
+	// Constant bounds when specialized, so the copies unroll into a few vector moves
+	const int C = NChannels > 0 ? NChannels : nChannels;
+	for (int s = 0; s < nSamples; s++)
+	{
+		const ofxOpenBciWifiSample& sample = samples[s];
+		float* frame = frames + s * stride;
+		if (sample.nChannels >= C)
+		{
+			for (int ch = 0; ch < C; ch++)
+			{
+				frame[ch] = sample.data[ch];
+			}
+		}
+		else
+		{
+			// A short sample, e.g. a truncated chunk
+			int n = max(sample.nChannels, 0);
+			for (int ch = 0; ch < n; ch++)
+			{
+				frame[ch] = sample.data[ch];
+			}
+			for (int ch = n; ch < C; ch++)
+			{
+				frame[ch] = 0.f;
+			}
+		}
+		for (int ch = C; ch < stride; ch++)
+		{
+			frame[ch] = 0.f;
+		}
+	}
+}
+
+template <int NChannels>
+void ofxOpenBciWifiChannelKernels::scatterFrames(const float* frames, int nFrames, int stride, int nChannels, float* ring, int windowSize)
+{
+	const int C = NChannels > 0 ? NChannels : nChannels;
+	int s = 0;
+	if (NChannels > 0)
+	{
+		// Specialized counts are multiples of 4, so 4 frames at a time go in as 4 x 4 transposes
+		for (; s + 4 <= nFrames; s += 4)
+		{
+			for (int ch = 0; ch < NChannels; ch += 4)
+			{
+				transpose4x4(frames + s * stride + ch, stride, ring + ch * windowSize + s, windowSize);
+			}
+		}
+	}
+	for (; s < nFrames; s++)
+	{
+		const float* frame = frames + s * stride;
+		float* column = ring + s;
+		for (int ch = 0; ch < C; ch++)
+		{
+			column[ch * windowSize] = frame[ch];
+		}
+	}
+}
@@ -0,0 +1,50 @@
+//
+//  ofxOpenBciWifiChannelKernels.h
+//
+//  The per channel loops of a headset's processing pass, moving decoded samples into the
+//  frame block and filtered frames into the FFT ring. Boards stream 4 (Ganglion), 8 (Cyton)
+//  or 16 (Cyton + Daisy) channels, so those counts get loops instantiated with a fixed bound
+//  the compiler fully unrolls, picked once when the headset's channel count is known. Any
+//  other count runs the generic loops.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+class ofxOpenBciWifiChannelKernels
+{
+private:
+	typedef void (*Gather)(const ofxOpenBciWifiSample* samples, int nSamples, int nChannels, float* frames, int stride);
+	typedef void (*Scatter)(const float* frames, int nFrames, int stride, int nChannels, float* ring, int windowSize);
+
+	int _nChannels;
+	bool _specialized;
+	Gather _gather;
+	Scatter _scatter;
+
+	// NChannels = 0 is the generic version, bounded by nChannels
+	template <int NChannels>
+	static void gatherFrames(const ofxOpenBciWifiSample* samples, int nSamples, int nChannels, float* frames, int stride);
+	template <int NChannels>
+	static void scatterFrames(const float* frames, int nFrames, int stride, int nChannels, float* ring, int windowSize);
+
+public:
+	ofxOpenBciWifiChannelKernels();
+
+	// Picks the loops for nChannels, clamped to OFX_OPENBCI_WIFI_MAX_CHANNELS.
+	// specialize = false always runs the generic loops, for comparison.
+	void setup(int nChannels, bool specialize = true);
+	int getChannelCount();
+	bool isSpecialized();							// False when nChannels runs the generic loops
+
+	// Writes nSamples frames stride floats apart (stride >= the channel count). A frame holds the
+	// sample's first channels, zeros for the ones it doesn't have and zeros up to stride.
+	void gather(const ofxOpenBciWifiSample* samples, int nSamples, float* frames, int stride);
+
+	// Writes nFrames frames into a channel major ring of windowSize samples per channel,
+	// starting at ringPos. The frames must fit before the end of the ring.
+	void scatter(const float* frames, int nFrames, int stride, float* ring, int ringPos, int windowSize);
+};
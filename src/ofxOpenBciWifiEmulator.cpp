@@ -0,0 +1,352 @@
+//
+//  ofxOpenBciWifiEmulator.cpp
+//
+//  Simulates OpenBci Wifi shields streaming to an ofxOpenBciWifi TCP port.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiEmulator.h"
+
+#ifndef TARGET_WIN32
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define EMULATOR_MAX_OUTGOING (4 * 1024 * 1024)	// Bytes held per shield before samples are dropped
+
+ofxOpenBciWifiEmulator::ofxOpenBciWifiEmulator()
+{
+	_port = 0;
+	_Fs = 250;
+	_nChannels = 8;
+	_samplesPerChunk = 2;
+	_format = OFX_OPENBCI_WIFI_FORMAT_JSON;
+	_startTime = 0;
+	_cpuSeconds = 0;
+	// Cyton ADS1299 at gain 24, same as ofxOpenBciWifiRawDecoder
+	_rawScale = (float)(4.5 / 24. / (pow(2., 23.) - 1.) * 1000000.);
+}
+
+ofxOpenBciWifiEmulator::~ofxOpenBciWifiEmulator()
+{
+	close();
+}
+
+bool ofxOpenBciWifiEmulator::setup(string host, int port, int nShields, int samplingFreq, int nChannels, ofxOpenBciWifiDataFormat format)
+{
+	close();
+	_host = host;
+	_port = port;
+	_Fs = samplingFreq;
+	_format = format;
+	_nChannels = min(nChannels, format == OFX_OPENBCI_WIFI_FORMAT_RAW ? 8 : OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	_samplesPerChunk = max(_Fs / 100, 1);
+
+	sockaddr_in server;
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	if (inet_pton(AF_INET, host.c_str(), &server.sin_addr) != 1)
+	{
+		ofLogError("ofxOpenBciWifiEmulator") << "Invalid host " << host;
+		return false;
+	}
+	// Every 127.x.x.x address is local, so each shield can get its own
+	bool loopback = (ntohl(server.sin_addr.s_addr) >> 24) == 127;
+	if (!loopback && nShields > 1)
+	{
+		ofLogWarning("ofxOpenBciWifiEmulator") << "Shields connecting to a remote host share one ip address and will look like one headset";
+	}
+
+	for (int i = 0; i < nShields; i++)
+	{
+		Shield shield;
+		shield.fd = socket(AF_INET, SOCK_STREAM, 0);
+		shield.sourceIp = loopback ? "127.0.0." + ofToString(2 + i % 253) : "";
+		if (shield.fd < 0)
+		{
+			ofLogError("ofxOpenBciWifiEmulator") << "socket() failed: " << strerror(errno);
+			close();
+			return false;
+		}
+		if (loopback)
+		{
+			sockaddr_in source;
+			memset(&source, 0, sizeof(source));
+			source.sin_family = AF_INET;
+			source.sin_port = 0;
+			inet_pton(AF_INET, shield.sourceIp.c_str(), &source.sin_addr);
+			bind(shield.fd, (sockaddr*)&source, sizeof(source));
+		}
+		if (connect(shield.fd, (sockaddr*)&server, sizeof(server)) < 0)
+		{
+			ofLogError("ofxOpenBciWifiEmulator") << "Shield " << i + 1 << " could not connect to " << host << ":" << port << ": " << strerror(errno);
+			::close(shield.fd);
+			close();
+			return false;
+		}
+		int noDelay = 1;
+		setsockopt(shield.fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+		fcntl(shield.fd, F_SETFL, fcntl(shield.fd, F_GETFL, 0) | O_NONBLOCK);
+
+		shield.samplesGenerated = 0;
+		shield.samplesSent = 0;
+		shield.bytesSent = 0;
+		shield.gapUntil = 0;
+		shield.burstUntil = 0;
+		shield.count = 0;
+		shield.random = 2463534242u + i;
+		shield.outgoingOffset = 0;
+		_shields.push_back(shield);
+	}
+	return true;
+}
+
+void ofxOpenBciWifiEmulator::setSamplesPerChunk(int nSamples)
+{
+	lock();
+	_samplesPerChunk = max(nSamples, 1);
+	unlock();
+}
+
+void ofxOpenBciWifiEmulator::start()
+{
+	_startTime = ofGetElapsedTimeMicros();
+	for (int i = 0; i < _shields.size(); i++)
+	{
+		_shields.at(i).samplesGenerated = 0;
+	}
+	startThread();
+}
+
+void ofxOpenBciWifiEmulator::stop()
+{
+	if (isThreadRunning())
+	{
+		waitForThread(true);
+	}
+}
+
+void ofxOpenBciWifiEmulator::close()
+{
+	stop();
+	for (int i = 0; i < _shields.size(); i++)
+	{
+		::close(_shields.at(i).fd);
+	}
+	_shields.clear();
+}
+
+int ofxOpenBciWifiEmulator::getShieldCount()
+{
+	return _shields.size();
+}
+
+string ofxOpenBciWifiEmulator::getShieldIpAddress(int shield)
+{
+	return _shields.at(shield).sourceIp;
+}
+
+void ofxOpenBciWifiEmulator::injectGap(int shield, float seconds)
+{
+	lock();
+	_shields.at(shield).gapUntil = ofGetElapsedTimeMicros() + (uint64_t)(seconds * 1000000);
+	unlock();
+}
+
+void ofxOpenBciWifiEmulator::injectBurst(int shield, float seconds)
+{
+	lock();
+	_shields.at(shield).burstUntil = ofGetElapsedTimeMicros() + (uint64_t)(seconds * 1000000);
+	unlock();
+}
+
+uint64_t ofxOpenBciWifiEmulator::getSamplesSent()
+{
+	lock();
+	uint64_t n = 0;
+	for (int i = 0; i < _shields.size(); i++)
+	{
+		n += _shields.at(i).samplesSent;
+	}
+	unlock();
+	return n;
+}
+
+uint64_t ofxOpenBciWifiEmulator::getBytesSent()
+{
+	lock();
+	uint64_t n = 0;
+	for (int i = 0; i < _shields.size(); i++)
+	{
+		n += _shields.at(i).bytesSent;
+	}
+	unlock();
+	return n;
+}
+
+double ofxOpenBciWifiEmulator::getCpuSeconds()
+{
+	lock();
+	double seconds = _cpuSeconds;
+	unlock();
+	return seconds;
+}
+
+void ofxOpenBciWifiEmulator::threadedFunction()
+{
+	while (isThreadRunning())
+	{
+		lock();
+		uint64_t now = ofGetElapsedTimeMicros();
+		uint64_t due = (now - _startTime) * _Fs / 1000000;
+		for (int i = 0; i < _shields.size(); i++)
+		{
+			Shield& shield = _shields.at(i);
+			while (shield.samplesGenerated + _samplesPerChunk <= due)
+			{
+				generateChunk(shield, now);
+			}
+			if (shield.burstUntil <= now)
+			{
+				flush(shield);
+			}
+		}
+
+		timespec cpu;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+		_cpuSeconds = cpu.tv_sec + cpu.tv_nsec / 1e9;
+		unlock();
+
+		sleep(1);
+	}
+}
+
+float ofxOpenBciWifiEmulator::noise(Shield& shield)
+{
+	// xorshift32, roughly uniform in [-1, 1)
+	shield.random ^= shield.random << 13;
+	shield.random ^= shield.random >> 17;
+	shield.random ^= shield.random << 5;
+	return (shield.random >> 8) / 8388608.f - 1.f;
+}
+
+void ofxOpenBciWifiEmulator::generateChunk(Shield& shield, uint64_t now)
+{
+	float data[OFX_OPENBCI_WIFI_MAX_CHANNELS * 256];
+	int nSamples = min(_samplesPerChunk, 256);
+	uint64_t first = shield.samplesGenerated;
+
+	// Alpha, 60 Hz line noise, a per-channel offset and broadband noise, in uV
+	for (int s = 0; s < nSamples; s++)
+	{
+		double t = (double)(first + s) / _Fs;
+		float alpha = 20.f * sin(TWO_PI * 10. * t);
+		float line = 8.f * sin(TWO_PI * 60. * t);
+		for (int ch = 0; ch < _nChannels; ch++)
+		{
+			data[s * _nChannels + ch] = alpha * (1.f - 0.05f * ch) + line + 100.f * ch + 5.f * noise(shield);
+		}
+	}
+	shield.samplesGenerated += nSamples;
+
+	if (shield.gapUntil > now)
+	{
+		// Lost samples, the sample numbers jump
+		return;
+	}
+	if (shield.outgoing.size() - shield.outgoingOffset > EMULATOR_MAX_OUTGOING)
+	{
+		// The receiver stopped reading, a shield would drop these too
+		return;
+	}
+
+	if (_format == OFX_OPENBCI_WIFI_FORMAT_RAW)
+	{
+		appendRawPackets(shield, data, nSamples, first);
+	}
+	else
+	{
+		appendJsonChunk(shield, data, nSamples, first);
+	}
+	shield.samplesSent += nSamples;
+}
+
+void ofxOpenBciWifiEmulator::appendJsonChunk(Shield& shield, const float* data, int nSamples, uint64_t firstSample)
+{
+	char buf[64];
+	double timestamp = (double)ofGetSystemTimeMillis();
+	shield.outgoing += "{\"chunk\":[";
+	for (int s = 0; s < nSamples; s++)
+	{
+		snprintf(buf, sizeof(buf), "%s{\"timestamp\":%.0f,\"sampleNumber\":%d,\"data\":[",
+			s > 0 ? "," : "", timestamp, (int)((firstSample + s) % 256));
+		shield.outgoing += buf;
+		for (int ch = 0; ch < _nChannels; ch++)
+		{
+			snprintf(buf, sizeof(buf), ch > 0 ? ",%.2f" : "%.2f", data[s * _nChannels + ch]);
+			shield.outgoing += buf;
+		}
+		shield.outgoing += "]}";
+	}
+	snprintf(buf, sizeof(buf), "],\"count\":%d}\r\n", shield.count++);
+	shield.outgoing += buf;
+}
+
+void ofxOpenBciWifiEmulator::appendRawPackets(Shield& shield, const float* data, int nSamples, uint64_t firstSample)
+{
+	unsigned char packet[OFX_OPENBCI_WIFI_RAW_PACKET_SIZE];
+	for (int s = 0; s < nSamples; s++)
+	{
+		memset(packet, 0, sizeof(packet));
+		packet[0] = 0xA0;
+		packet[1] = (unsigned char)((firstSample + s) % 256);
+		for (int ch = 0; ch < _nChannels; ch++)
+		{
+			int counts = (int)ofClamp(roundf(data[s * _nChannels + ch] / _rawScale), -8388608.f, 8388607.f);
+			packet[2 + ch * 3] = (counts >> 16) & 0xFF;
+			packet[3 + ch * 3] = (counts >> 8) & 0xFF;
+			packet[4 + ch * 3] = counts & 0xFF;
+		}
+		// Accelerometer at rest, 1 g on Z
+		packet[30] = (unsigned char)(8000 >> 8);
+		packet[31] = (unsigned char)(8000 & 0xFF);
+		packet[32] = 0xC0;
+		shield.outgoing.append((const char*)packet, sizeof(packet));
+	}
+}
+
+void ofxOpenBciWifiEmulator::flush(Shield& shield)
+{
+	while (shield.outgoingOffset < shield.outgoing.size())
+	{
+		ssize_t n = send(shield.fd, shield.outgoing.data() + shield.outgoingOffset,
+			shield.outgoing.size() - shield.outgoingOffset, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			// EAGAIN: the receiver is applying backpressure, try again next loop
+			break;
+		}
+		shield.outgoingOffset += n;
+		shield.bytesSent += n;
+	}
+	if (shield.outgoingOffset == shield.outgoing.size())
+	{
+		shield.outgoing.clear();
+		shield.outgoingOffset = 0;
+	}
+	else if (shield.outgoingOffset > shield.outgoing.size() / 2)
+	{
+		shield.outgoing.erase(0, shield.outgoingOffset);
+		shield.outgoingOffset = 0;
+	}
+}
+
+#endif
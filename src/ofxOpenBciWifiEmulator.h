@@ -0,0 +1,77 @@
+//
+//  ofxOpenBciWifiEmulator.h
+//
+//  Simulates OpenBci Wifi shields streaming to an ofxOpenBciWifi TCP port, for load testing
+//  without boards. Each shield connects from its own 127.0.0.x address so the receiver sees
+//  separate headsets, and sends {"chunk":[...]} JSON or raw 33 byte packets in real time.
+//  Gaps (samples never sent) and bursts (samples held back, then sent at once) can be injected.
+//  POSIX sockets only.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+#ifndef TARGET_WIN32
+
+class ofxOpenBciWifiEmulator : public ofThread
+{
+private:
+	struct Shield
+	{
+		int fd;
+		string sourceIp;
+		uint64_t samplesGenerated;
+		uint64_t samplesSent;
+		uint64_t bytesSent;
+		uint64_t gapUntil;					// ofGetElapsedTimeMicros(), 0 = none
+		uint64_t burstUntil;
+		int count;							// JSON chunk counter
+		uint32_t random;					// xorshift state for the noise
+		string outgoing;
+		size_t outgoingOffset;				// Bytes of outgoing already sent
+	};
+
+	string _host;
+	int _port;
+	int _Fs;
+	int _nChannels;
+	int _samplesPerChunk;
+	ofxOpenBciWifiDataFormat _format;
+	vector<Shield> _shields;
+	uint64_t _startTime;
+	double _cpuSeconds;						// CPU time used by the emulator thread
+	float _rawScale;						// uV per count of a raw packet
+
+	void threadedFunction();
+	void generateChunk(Shield& shield, uint64_t now);
+	void appendJsonChunk(Shield& shield, const float* data, int nSamples, uint64_t firstSample);
+	void appendRawPackets(Shield& shield, const float* data, int nSamples, uint64_t firstSample);
+	void flush(Shield& shield);
+	float noise(Shield& shield);
+
+public:
+	ofxOpenBciWifiEmulator();
+	~ofxOpenBciWifiEmulator();
+
+	// Connects nShields shields to host:port. Raw packets carry at most 8 channels.
+	bool setup(string host, int port, int nShields, int samplingFreq = 250, int nChannels = 8,
+		ofxOpenBciWifiDataFormat format = OFX_OPENBCI_WIFI_FORMAT_JSON);
+	void setSamplesPerChunk(int nSamples);	// Default = Fs / 100, like the shield's 10 ms latency setting
+	void start();
+	void stop();
+	void close();
+
+	int getShieldCount();
+	string getShieldIpAddress(int shield);
+	void injectGap(int shield, float seconds);
+	void injectBurst(int shield, float seconds);
+
+	uint64_t getSamplesSent();
+	uint64_t getBytesSent();
+	double getCpuSeconds();
+};
+
+#endif
@@ -0,0 +1,559 @@
+//
+//  ofxOpenBciWifiFftEngine.cpp
+//
+//  Batched spectra for every channel of every headset.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiFftEngine.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OFX_OPENBCI_WIFI_FFT_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OFX_OPENBCI_WIFI_FFT_NEON
+#endif
+
+// Natural log polynomial (Cephes logf), accurate to a couple of ulps for normal floats
+#define LOG_SQRTHF 0.707106781186547524f
+#define LOG_P0 7.0376836292e-2f
+#define LOG_P1 -1.1514610310e-1f
+#define LOG_P2 1.1676998740e-1f
+#define LOG_P3 -1.2420140846e-1f
+#define LOG_P4 1.4249322787e-1f
+#define LOG_P5 -1.6668057665e-1f
+#define LOG_P6 2.0000714765e-1f
+#define LOG_P7 -2.4999993993e-1f
+#define LOG_P8 3.3333331174e-1f
+#define LOG_Q1 -2.12194440e-4f
+#define LOG_Q2 0.693359375f
+#define DB_PER_NEPER 4.34294481903f			// 10 / ln(10)
+
+ofxOpenBciWifiFftEngine::ofxOpenBciWifiFftEngine()
+{
+	_welchSegments = 1;
+	_timeHalfBandwidth = 2.f;
+	_nTapers = 0;
+}
+
+ofxOpenBciWifiFftEngine::~ofxOpenBciWifiFftEngine()
+{
+	for (map<pair<int, int>, ofxFft*>::iterator it = _plans.begin(); it != _plans.end(); ++it)
+	{
+		delete it->second;
+	}
+}
+
+ofxFft* ofxOpenBciWifiFftEngine::getPlan(int windowSize, fftWindowType windowType)
+{
+	pair<int, int> key(windowSize, windowType);
+	map<pair<int, int>, ofxFft*>::iterator it = _plans.find(key);
+	if (it != _plans.end())
+	{
+		return it->second;
+	}
+	ofxFft* plan = ofxFft::create(windowSize, windowType);
+	_plans[key] = plan;
+	return plan;
+}
+
+void ofxOpenBciWifiFftEngine::prepare(int windowSize, fftWindowType windowType)
+{
+	getPlan(windowSize, windowType);
+	if (_nTapers > 0)
+	{
+		getPlan(windowSize, OF_FFT_WINDOW_RECTANGULAR);
+		if (_tapers.find(windowSize) == _tapers.end())
+		{
+			getDpss(windowSize, _timeHalfBandwidth, _nTapers, _tapers[windowSize]);
+		}
+	}
+}
+
+void ofxOpenBciWifiFftEngine::setWelchSegments(int nSegments)
+{
+	// The histories start over the next time they are used
+	_welchSegments = max(nSegments, 1);
+}
+
+int ofxOpenBciWifiFftEngine::getWelchSegments()
+{
+	return _welchSegments;
+}
+
+void ofxOpenBciWifiFftEngine::enableMultitaper(float timeHalfBandwidth, int nTapers)
+{
+	if (nTapers <= 0)
+	{
+		nTapers = max((int)(2.f * timeHalfBandwidth) - 1, 1);
+	}
+	if (timeHalfBandwidth != _timeHalfBandwidth || nTapers != _nTapers)
+	{
+		_tapers.clear();
+	}
+	_timeHalfBandwidth = timeHalfBandwidth;
+	_nTapers = nTapers;
+}
+
+void ofxOpenBciWifiFftEngine::disableMultitaper()
+{
+	_nTapers = 0;
+	_tapers.clear();
+}
+
+int ofxOpenBciWifiFftEngine::getTaperCount()
+{
+	return _nTapers;
+}
+
+void ofxOpenBciWifiFftEngine::queue(const float* signal, int windowSize, float* spectrum, fftWindowType windowType,
+	ofxOpenBciWifiWelchHistory* history)
+{
+	queue(signal, windowSize, NULL, 0, spectrum, windowType, history);
+}
+
+void ofxOpenBciWifiFftEngine::queue(const float* first, int nFirst, const float* second, int nSecond, float* spectrum,
+	fftWindowType windowType, ofxOpenBciWifiWelchHistory* history)
+{
+	Job job;
+	job.offset = _staging.size();
+	job.windowSize = nFirst + nSecond;
+	job.windowType = windowType;
+	job.spectrum = spectrum;
+	job.history = history;
+	// Gathered into one contiguous window here, the copy queuing makes anyway
+	_staging.insert(_staging.end(), first, first + nFirst);
+	_staging.insert(_staging.end(), second, second + nSecond);
+	_jobs.push_back(job);
+}
+
+int ofxOpenBciWifiFftEngine::getQueuedCount()
+{
+	return _jobs.size();
+}
+
+void ofxOpenBciWifiFftEngine::run(bool smoothing, float newDataWeight)
+{
+	for (int j = 0; j < _jobs.size(); j++)
+	{
+		const Job& job = _jobs[j];
+		int nBins = job.windowSize / 2;
+		const float* amplitude;
+		if (_nTapers > 0)
+		{
+			amplitude = getMultitaperAmplitude(&_staging[job.offset], job.windowSize);
+		}
+		else
+		{
+			ofxFft* plan = getPlan(job.windowSize, job.windowType);
+			plan->setSignal(&_staging[job.offset]);
+			amplitude = plan->getAmplitude();
+		}
+		if (job.history != NULL && _welchSegments > 1)
+		{
+			amplitude = average(*job.history, amplitude, nBins);
+		}
+		toDecibels(amplitude, job.spectrum, nBins, smoothing, newDataWeight);
+	}
+	// Keep the capacity so steady state doesn't allocate
+	_jobs.clear();
+	_staging.clear();
+}
+
+const float* ofxOpenBciWifiFftEngine::getMultitaperAmplitude(const float* signal, int windowSize)
+{
+	// Root of the mean power of the tapered FFTs, in the amplitude units of a single FFT
+	prepare(windowSize, OF_FFT_WINDOW_RECTANGULAR);
+	const float* tapers = &_tapers[windowSize][0];
+	ofxFft* plan = getPlan(windowSize, OF_FFT_WINDOW_RECTANGULAR);
+	int nBins = windowSize / 2;
+	_tapered.resize(windowSize);
+	_taperPower.assign(nBins, 0.);
+	_amplitude.resize(nBins);
+	for (int t = 0; t < _nTapers; t++)
+	{
+		const float* taper = tapers + t * windowSize;
+		for (int i = 0; i < windowSize; i++)
+		{
+			_tapered[i] = signal[i] * taper[i];
+		}
+		plan->setSignal(&_tapered[0]);
+		const float* amplitude = plan->getAmplitude();
+		for (int b = 0; b < nBins; b++)
+		{
+			_taperPower[b] += (double)amplitude[b] * amplitude[b];
+		}
+	}
+	for (int b = 0; b < nBins; b++)
+	{
+		_amplitude[b] = sqrt(_taperPower[b] / _nTapers);
+	}
+	return &_amplitude[0];
+}
+
+const float* ofxOpenBciWifiFftEngine::average(ofxOpenBciWifiWelchHistory& history, const float* amplitude, int n)
+{
+	if (history.power.size() != (size_t)_welchSegments * n)
+	{
+		history.power.assign(_welchSegments * n, 0.f);
+		history.sum.assign(n, 0.);
+		history.pos = 0;
+		history.count = 0;
+	}
+
+	// Replace the oldest spectrum in the running sum
+	float* oldest = &history.power[history.pos * n];
+	double* sum = &history.sum[0];
+	for (int b = 0; b < n; b++)
+	{
+		float power = amplitude[b] * amplitude[b];
+		sum[b] += (double)power - oldest[b];
+		oldest[b] = power;
+	}
+	history.count = min(history.count + 1, _welchSegments);
+	if (++history.pos == _welchSegments)
+	{
+		// Summed afresh once per lap so rounding can't build up
+		history.pos = 0;
+		fill(sum, sum + n, 0.);
+		for (int s = 0; s < _welchSegments; s++)
+		{
+			const float* power = &history.power[s * n];
+			for (int b = 0; b < n; b++)
+			{
+				sum[b] += power[b];
+			}
+		}
+	}
+
+	_amplitude.resize(n);
+	double scale = 1. / history.count;
+	for (int b = 0; b < n; b++)
+	{
+		_amplitude[b] = sqrt(max(sum[b], 0.) * scale);
+	}
+	return &_amplitude[0];
+}
+
+int ofxOpenBciWifiFftEngine::getEfficientSize(int minSize)
+{
+	for (int n = max(minSize, 1); ; n++)
+	{
+		int m = n;
+		const int factors[] = { 2, 3, 5 };
+		for (int f = 0; f < 3; f++)
+		{
+			while (m % factors[f] == 0)
+			{
+				m /= factors[f];
+			}
+		}
+		if (m == 1)
+		{
+			return n;
+		}
+	}
+}
+
+namespace
+{
+	// Eigenvalues of the symmetric tridiagonal matrix (diag, off) below x, from the Sturm sequence
+	int countEigenvaluesBelow(const vector<double>& diag, const vector<double>& off, double x)
+	{
+		int count = 0;
+		double q = 1.;
+		for (int i = 0; i < diag.size(); i++)
+		{
+			q = diag[i] - x - (i > 0 ? off[i - 1] * off[i - 1] / q : 0.);
+			if (q == 0.)
+			{
+				q = numeric_limits<double>::min();
+			}
+			if (q < 0.)
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+
+	// Solves (T - shift I) x = b in place for the symmetric tridiagonal T, LU with partial pivoting
+	void solveShifted(const vector<double>& diag, const vector<double>& off, double shift, vector<double>& x)
+	{
+		int n = diag.size();
+		vector<double> d(n), du(n, 0.), du2(n, 0.), dl(n, 0.);
+		vector<bool> swapped(n, false);
+		for (int i = 0; i < n; i++)
+		{
+			d[i] = diag[i] - shift;
+			if (i + 1 < n)
+			{
+				du[i] = off[i];
+				dl[i] = off[i];
+			}
+		}
+		for (int i = 0; i + 1 < n; i++)
+		{
+			if (fabs(d[i]) >= fabs(dl[i]))
+			{
+				if (d[i] == 0.)
+				{
+					d[i] = numeric_limits<double>::epsilon();
+				}
+				dl[i] /= d[i];
+				d[i + 1] -= dl[i] * du[i];
+			}
+			else
+			{
+				// Swap rows i and i + 1
+				double factor = d[i] / dl[i];
+				d[i] = dl[i];
+				dl[i] = factor;
+				double temp = du[i];
+				du[i] = d[i + 1];
+				d[i + 1] = temp - factor * d[i + 1];
+				if (i + 2 < n)
+				{
+					du2[i] = du[i + 1];
+					du[i + 1] = -factor * du[i + 1];
+				}
+				swapped[i] = true;
+			}
+		}
+		if (d[n - 1] == 0.)
+		{
+			d[n - 1] = numeric_limits<double>::epsilon();
+		}
+
+		for (int i = 0; i + 1 < n; i++)
+		{
+			if (swapped[i])
+			{
+				swap(x[i], x[i + 1]);
+			}
+			x[i + 1] -= dl[i] * x[i];
+		}
+		for (int i = n - 1; i >= 0; i--)
+		{
+			double sum = x[i];
+			if (i + 1 < n)
+			{
+				sum -= du[i] * x[i + 1];
+			}
+			if (i + 2 < n)
+			{
+				sum -= du2[i] * x[i + 2];
+			}
+			x[i] = sum / d[i];
+		}
+	}
+}
+
+void ofxOpenBciWifiFftEngine::getDpss(int windowSize, float timeHalfBandwidth, int nTapers, vector<float>& tapers)
+{
+	// Eigenvectors of the largest eigenvalues of the tridiagonal matrix that commutes with the
+	// concentration problem (Percival & Walden 8.3), by bisection and inverse iteration
+	int N = max(windowSize, 1);
+	int K = min(max(nTapers, 0), N);
+	tapers.assign(K * N, 0.f);
+	double cosW = cos(TWO_PI * timeHalfBandwidth / N);
+	vector<double> diag(N);
+	vector<double> off(N - 1);
+	for (int i = 0; i < N; i++)
+	{
+		double t = (N - 1 - 2. * i) / 2.;
+		diag[i] = t * t * cosW;
+		if (i + 1 < N)
+		{
+			off[i] = (i + 1.) * (N - 1. - i) / 2.;
+		}
+	}
+	// Gershgorin bounds of the eigenvalues
+	double lo = numeric_limits<double>::max();
+	double hi = -numeric_limits<double>::max();
+	for (int i = 0; i < N; i++)
+	{
+		double radius = (i > 0 ? fabs(off[i - 1]) : 0.) + (i + 1 < N ? fabs(off[i]) : 0.);
+		lo = min(lo, diag[i] - radius);
+		hi = max(hi, diag[i] + radius);
+	}
+
+	vector<double> v(N);
+	for (int k = 0; k < K; k++)
+	{
+		// The (N - 1 - k)th smallest eigenvalue
+		int index = N - 1 - k;
+		double a = lo;
+		double b = hi;
+		for (int i = 0; i < 200 && b - a > 1e-15 * max(max(fabs(a), fabs(b)), 1.); i++)
+		{
+			double mid = 0.5 * (a + b);
+			if (countEigenvaluesBelow(diag, off, mid) > index)
+			{
+				b = mid;
+			}
+			else
+			{
+				a = mid;
+			}
+		}
+		double eigenvalue = 0.5 * (a + b);
+
+		// Neither symmetric nor antisymmetric, so no taper is orthogonal to the start
+		for (int i = 0; i < N; i++)
+		{
+			v[i] = 1. + 0.5 * sin(i + 1.);
+		}
+		for (int iteration = 0; iteration < 3; iteration++)
+		{
+			solveShifted(diag, off, eigenvalue, v);
+			double norm = 0.;
+			for (int i = 0; i < N; i++)
+			{
+				norm += v[i] * v[i];
+			}
+			norm = sqrt(norm);
+			for (int i = 0; i < N; i++)
+			{
+				v[i] /= norm;
+			}
+		}
+
+		// Even tapers sum positive, odd ones start positive, energy N like a rectangular window
+		double moment = 0.;
+		for (int i = 0; i < N; i++)
+		{
+			moment += v[i] * (k % 2 == 0 ? 1. : N - 1 - 2. * i);
+		}
+		double scale = (moment < 0. ? -1. : 1.) * sqrt((double)N);
+		for (int i = 0; i < N; i++)
+		{
+			tapers[k * N + i] = v[i] * scale;
+		}
+	}
+}
+
+void ofxOpenBciWifiFftEngine::toDecibels(const float* amplitude, float* spectrum, int n, bool smoothing, float newDataWeight)
+{
+	int i = 0;
+#if defined(OFX_OPENBCI_WIFI_FFT_SSE)
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 inf = _mm_set1_ps(numeric_limits<float>::infinity());
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 weight = _mm_set1_ps(newDataWeight);
+	const __m128 oldWeight = _mm_set1_ps(1.f - newDataWeight);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(amplitude + i);
+		__m128 isZero = _mm_cmpeq_ps(x, zero);
+		__m128 isInvalid = _mm_or_ps(_mm_cmplt_ps(x, zero), _mm_cmpunord_ps(x, x));
+		__m128 isInf = _mm_cmpeq_ps(x, inf);
+
+		// Split into mantissa in [0.5, 1) and exponent, denormals are clamped to FLT_MIN
+		__m128 m = _mm_max_ps(x, _mm_set1_ps(numeric_limits<float>::min()));
+		__m128i bits = _mm_castps_si128(m);
+		__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+		m = _mm_or_ps(_mm_and_ps(m, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000))), _mm_set1_ps(0.5f));
+		__m128 small = _mm_cmplt_ps(m, _mm_set1_ps(LOG_SQRTHF));
+		e = _mm_sub_ps(e, _mm_and_ps(one, small));
+		m = _mm_sub_ps(_mm_add_ps(m, _mm_and_ps(m, small)), one);
+
+		__m128 z = _mm_mul_ps(m, m);
+		__m128 y = _mm_set1_ps(LOG_P0);
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P1));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P2));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P3));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P4));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P5));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P6));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P7));
+		y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(LOG_P8));
+		y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+		y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(LOG_Q1)));
+		y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+		__m128 ln = _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(LOG_Q2)));
+		__m128 db = _mm_mul_ps(ln, _mm_set1_ps(DB_PER_NEPER));
+
+		// Same special values as log10()
+		db = _mm_or_ps(_mm_andnot_ps(isZero, db), _mm_and_ps(isZero, _mm_sub_ps(zero, inf)));
+		db = _mm_or_ps(_mm_andnot_ps(isInf, db), _mm_and_ps(isInf, inf));
+		db = _mm_or_ps(db, isInvalid);
+
+		if (smoothing)
+		{
+			// Handle case when the old data ran off into the weeds
+			__m128 old = _mm_loadu_ps(spectrum + i);
+			__m128 finite = _mm_cmplt_ps(_mm_and_ps(old, absMask), inf);
+			__m128 smoothed = _mm_add_ps(_mm_mul_ps(db, weight), _mm_mul_ps(old, oldWeight));
+			db = _mm_or_ps(_mm_and_ps(finite, smoothed), _mm_andnot_ps(finite, db));
+		}
+		_mm_storeu_ps(spectrum + i, db);
+	}
+#elif defined(OFX_OPENBCI_WIFI_FFT_NEON)
+	const float32x4_t one = vdupq_n_f32(1.f);
+	const float32x4_t zero = vdupq_n_f32(0.f);
+	const float32x4_t inf = vdupq_n_f32(numeric_limits<float>::infinity());
+	const float32x4_t nan = vdupq_n_f32(numeric_limits<float>::quiet_NaN());
+	const float32x4_t weight = vdupq_n_f32(newDataWeight);
+	const float32x4_t oldWeight = vdupq_n_f32(1.f - newDataWeight);
+	for (; i + 4 <= n; i += 4)
+	{
+		float32x4_t x = vld1q_f32(amplitude + i);
+		uint32x4_t isZero = vceqq_f32(x, zero);
+		uint32x4_t isValid = vcgeq_f32(x, zero);
+		uint32x4_t isInf = vceqq_f32(x, inf);
+
+		// Split into mantissa in [0.5, 1) and exponent, denormals are clamped to FLT_MIN
+		float32x4_t m = vmaxq_f32(x, vdupq_n_f32(numeric_limits<float>::min()));
+		uint32x4_t bits = vreinterpretq_u32_f32(m);
+		float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(126)));
+		m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(~0x7f800000u)), vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+		uint32x4_t small = vcltq_f32(m, vdupq_n_f32(LOG_SQRTHF));
+		e = vsubq_f32(e, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(one), small)));
+		m = vsubq_f32(vaddq_f32(m, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(m), small))), one);
+
+		float32x4_t z = vmulq_f32(m, m);
+		float32x4_t y = vdupq_n_f32(LOG_P0);
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P1));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P2));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P3));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P4));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P5));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P6));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P7));
+		y = vaddq_f32(vmulq_f32(y, m), vdupq_n_f32(LOG_P8));
+		y = vmulq_f32(vmulq_f32(y, m), z);
+		y = vaddq_f32(y, vmulq_f32(e, vdupq_n_f32(LOG_Q1)));
+		y = vsubq_f32(y, vmulq_f32(z, vdupq_n_f32(0.5f)));
+		float32x4_t ln = vaddq_f32(vaddq_f32(m, y), vmulq_f32(e, vdupq_n_f32(LOG_Q2)));
+		float32x4_t db = vmulq_f32(ln, vdupq_n_f32(DB_PER_NEPER));
+
+		// Same special values as log10()
+		db = vbslq_f32(isZero, vnegq_f32(inf), db);
+		db = vbslq_f32(isInf, inf, db);
+		db = vbslq_f32(isValid, db, nan);
+
+		if (smoothing)
+		{
+			// Handle case when the old data ran off into the weeds
+			float32x4_t old = vld1q_f32(spectrum + i);
+			uint32x4_t finite = vcltq_f32(vabsq_f32(old), inf);
+			float32x4_t smoothed = vaddq_f32(vmulq_f32(db, weight), vmulq_f32(old, oldWeight));
+			db = vbslq_f32(finite, smoothed, db);
+		}
+		vst1q_f32(spectrum + i, db);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		float db = 10.f * log10(amplitude[i]);
+		if (smoothing && isfinite(spectrum[i]))
+		{
+			db = db * newDataWeight + spectrum[i] * (1.f - newDataWeight);
+		}
+		spectrum[i] = db;
+	}
+}
@@ -0,0 +1,103 @@
+//
+//  ofxOpenBciWifiFftEngine.h
+//
+//  Batched spectra for every channel of every headset. Windows that fill during a
+//  processing pass are queued and transformed together at the end of the pass with
+//  one cached ofxFft plan per window size, then converted to dB and smoothed with
+//  SSE / NEON (4 bins at a time).
+//  The power of each window can be estimated with DPSS tapers (multitaper) instead of the
+//  window function, and averaged over the last spectra of the channel (Welch) before the
+//  conversion to dB. Both average linear power, which lowers the variance of the spectrum
+//  without the bias of smoothing in dB.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxFft.h"
+
+// Power of the last spectra of one channel for Welch averaging, set up on first use
+struct ofxOpenBciWifiWelchHistory
+{
+	vector<float> power;				// Segments x Bins, written circularly
+	vector<double> sum;					// Of the spectra in power, per bin
+	int pos;
+	int count;
+
+	ofxOpenBciWifiWelchHistory() : pos(0), count(0) {}
+};
+
+class ofxOpenBciWifiFftEngine
+{
+private:
+	struct Job
+	{
+		size_t offset;					// Start of the windowed signal in _staging
+		int windowSize;
+		fftWindowType windowType;
+		float* spectrum;				// windowSize / 2 bins, in dB
+		ofxOpenBciWifiWelchHistory* history;	// NULL = no Welch averaging
+	};
+
+	map<pair<int, int>, ofxFft*> _plans;	// Keyed by window size and window type
+	vector<float> _staging;
+	vector<Job> _jobs;
+
+	int _welchSegments;
+	float _timeHalfBandwidth;
+	int _nTapers;						// 0 = the window function of each job
+	map<int, vector<float>> _tapers;	// Tapers x windowSize, keyed by window size
+
+	// Scratch reused by every window so steady state doesn't allocate
+	vector<float> _tapered;
+	vector<double> _taperPower;
+	vector<float> _amplitude;
+
+	const float* getMultitaperAmplitude(const float* signal, int windowSize);
+	const float* average(ofxOpenBciWifiWelchHistory& history, const float* amplitude, int n);
+
+public:
+	ofxOpenBciWifiFftEngine();
+	~ofxOpenBciWifiFftEngine();
+
+	// Returns the shared plan for windowSize, creating it on first use
+	ofxFft* getPlan(int windowSize, fftWindowType windowType = OF_FFT_WINDOW_HAMMING);
+
+	// Creates the plan and tapers run() uses for windowSize with the current settings
+	void prepare(int windowSize, fftWindowType windowType = OF_FFT_WINDOW_HAMMING);
+
+	// Averages the power of the last nSegments spectra of each history, 1 = off. With a hop of
+	// half a window this is Welch's method at no extra FFTs, as the windows are transformed anyway.
+	void setWelchSegments(int nSegments);
+	int getWelchSegments();
+	// Averages the power of nTapers DPSS tapered FFTs of each window in place of its window
+	// function, nTapers 0 = 2 NW - 1. Costs nTapers FFTs per window.
+	void enableMultitaper(float timeHalfBandwidth = 2.f, int nTapers = 0);
+	void disableMultitaper();
+	int getTaperCount();						// 0 = off
+
+	// Copies windowSize samples of signal to be transformed into spectrum by the next run().
+	// spectrum and history must stay valid until then.
+	void queue(const float* signal, int windowSize, float* spectrum, fftWindowType windowType = OF_FFT_WINDOW_HAMMING,
+		ofxOpenBciWifiWelchHistory* history = NULL);
+	// Same for a window split in two, e.g. by the wrap of a ring buffer
+	void queue(const float* first, int nFirst, const float* second, int nSecond, float* spectrum,
+		fftWindowType windowType = OF_FFT_WINDOW_HAMMING, ofxOpenBciWifiWelchHistory* history = NULL);
+	int getQueuedCount();
+
+	// Transforms every queued window in queue order. With smoothing, finite bins already in
+	// the spectrum are blended with the new ones by newDataWeight.
+	void run(bool smoothing, float newDataWeight);
+
+	// Smallest size >= minSize with no prime factors but 2, 3 and 5, which FFTs handle fastest
+	static int getEfficientSize(int minSize);
+
+	// First nTapers discrete prolate spheroidal sequences of windowSize samples, as tapers x windowSize.
+	// Each is scaled to the energy of a rectangular window so the power matches its spectrum.
+	static void getDpss(int windowSize, float timeHalfBandwidth, int nTapers, vector<float>& tapers);
+
+	// spectrum = 10 * log10(amplitude), optionally smoothed against the finite values already in spectrum
+	static void toDecibels(const float* amplitude, float* spectrum, int n, bool smoothing, float newDataWeight);
+};
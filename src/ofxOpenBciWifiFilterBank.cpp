@@ -0,0 +1,281 @@
+//
+//  ofxOpenBciWifiFilterBank.cpp
+//
+//  Cascade of biquad sections that filters every channel of a headset at once.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiFilterBank.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OFX_OPENBCI_WIFI_FILTER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OFX_OPENBCI_WIFI_FILTER_NEON
+#endif
+
+// Four lanes of samples and the arithmetic a section needs on them
+#if defined(OFX_OPENBCI_WIFI_FILTER_SSE)
+typedef __m128 Lanes;
+static inline Lanes loadLanes(const float* p) { return _mm_loadu_ps(p); }
+static inline void storeLanes(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+static inline Lanes addLanes(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes subLanes(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes mulLanes(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+#elif defined(OFX_OPENBCI_WIFI_FILTER_NEON)
+typedef float32x4_t Lanes;
+static inline Lanes loadLanes(const float* p) { return vld1q_f32(p); }
+static inline void storeLanes(float* p, Lanes v) { vst1q_f32(p, v); }
+static inline Lanes addLanes(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+static inline Lanes subLanes(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+static inline Lanes mulLanes(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+#else
+struct Lanes
+{
+	float v[OFX_OPENBCI_WIFI_FILTER_LANES];
+};
+static inline Lanes loadLanes(const float* p)
+{
+	Lanes r;
+	for (int l = 0; l < OFX_OPENBCI_WIFI_FILTER_LANES; l++)
+	{
+		r.v[l] = p[l];
+	}
+	return r;
+}
+static inline void storeLanes(float* p, Lanes a)
+{
+	for (int l = 0; l < OFX_OPENBCI_WIFI_FILTER_LANES; l++)
+	{
+		p[l] = a.v[l];
+	}
+}
+static inline Lanes addLanes(Lanes a, Lanes b)
+{
+	for (int l = 0; l < OFX_OPENBCI_WIFI_FILTER_LANES; l++)
+	{
+		a.v[l] += b.v[l];
+	}
+	return a;
+}
+static inline Lanes subLanes(Lanes a, Lanes b)
+{
+	for (int l = 0; l < OFX_OPENBCI_WIFI_FILTER_LANES; l++)
+	{
+		a.v[l] -= b.v[l];
+	}
+	return a;
+}
+static inline Lanes mulLanes(Lanes a, Lanes b)
+{
+	for (int l = 0; l < OFX_OPENBCI_WIFI_FILTER_LANES; l++)
+	{
+		a.v[l] *= b.v[l];
+	}
+	return a;
+}
+#endif
+
+template <int NSections, int NGroups>
+void ofxOpenBciWifiFilterBank::processFused(float* frames, int nFrames, int stride, Section* const* sections, int firstLane)
+{
+	Lanes a0[NSections][NGroups], a1[NSections][NGroups], a2[NSections][NGroups];
+	Lanes b1[NSections][NGroups], b2[NSections][NGroups];
+	Lanes z1[NSections][NGroups], z2[NSections][NGroups];
+	for (int i = 0; i < NSections; i++)
+	{
+		for (int g = 0; g < NGroups; g++)
+		{
+			int lane = firstLane + g * OFX_OPENBCI_WIFI_FILTER_LANES;
+			a0[i][g] = loadLanes(sections[i]->a0 + lane);
+			a1[i][g] = loadLanes(sections[i]->a1 + lane);
+			a2[i][g] = loadLanes(sections[i]->a2 + lane);
+			b1[i][g] = loadLanes(sections[i]->b1 + lane);
+			b2[i][g] = loadLanes(sections[i]->b2 + lane);
+			z1[i][g] = loadLanes(sections[i]->z1 + lane);
+			z2[i][g] = loadLanes(sections[i]->z2 + lane);
+		}
+	}
+	float* x = frames + firstLane;
+	for (int n = 0; n < nFrames; n++, x += stride)
+	{
+		// The loops have constant bounds and unroll, section i + 1 of this frame only waits
+		// on section i, so the recursions of the sections and groups run side by side
+		for (int g = 0; g < NGroups; g++)
+		{
+			Lanes value = loadLanes(x + g * OFX_OPENBCI_WIFI_FILTER_LANES);
+			for (int i = 0; i < NSections; i++)
+			{
+				Lanes in = value;
+				value = addLanes(mulLanes(in, a0[i][g]), z1[i][g]);
+				z1[i][g] = subLanes(addLanes(mulLanes(in, a1[i][g]), z2[i][g]), mulLanes(b1[i][g], value));
+				z2[i][g] = subLanes(mulLanes(in, a2[i][g]), mulLanes(b2[i][g], value));
+			}
+			storeLanes(x + g * OFX_OPENBCI_WIFI_FILTER_LANES, value);
+		}
+	}
+	for (int i = 0; i < NSections; i++)
+	{
+		for (int g = 0; g < NGroups; g++)
+		{
+			int lane = firstLane + g * OFX_OPENBCI_WIFI_FILTER_LANES;
+			storeLanes(sections[i]->z1 + lane, z1[i][g]);
+			storeLanes(sections[i]->z2 + lane, z2[i][g]);
+		}
+	}
+}
+
+ofxOpenBciWifiFilterBank::Kernel ofxOpenBciWifiFilterBank::getKernel(int nSections, int nGroups)
+{
+	// Rows are section counts and columns 4, 8, 12 and 16 channels
+	static const Kernel kernels[OFX_OPENBCI_WIFI_FILTER_MAX_FUSED][4] =
+	{
+		{ &processFused<1, 1>, &processFused<1, 2>, &processFused<1, 3>, &processFused<1, 4> },
+		{ &processFused<2, 1>, &processFused<2, 2>, &processFused<2, 3>, &processFused<2, 4> },
+		{ &processFused<3, 1>, &processFused<3, 2>, &processFused<3, 3>, &processFused<3, 4> },
+		{ &processFused<4, 1>, &processFused<4, 2>, &processFused<4, 3>, &processFused<4, 4> },
+		{ &processFused<5, 1>, &processFused<5, 2>, &processFused<5, 3>, &processFused<5, 4> },
+		{ &processFused<6, 1>, &processFused<6, 2>, &processFused<6, 3>, &processFused<6, 4> },
+		{ &processFused<7, 1>, &processFused<7, 2>, &processFused<7, 3>, &processFused<7, 4> },
+		{ &processFused<8, 1>, &processFused<8, 2>, &processFused<8, 3>, &processFused<8, 4> }
+	};
+	return kernels[nSections - 1][nGroups - 1];
+}
+
+ofxOpenBciWifiFilterBank::ofxOpenBciWifiFilterBank()
+{
+	_nChannels = 0;
+	_nGroups = 0;
+}
+
+void ofxOpenBciWifiFilterBank::setup(int nChannels)
+{
+	_nChannels = min(nChannels, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+	_nGroups = (_nChannels + OFX_OPENBCI_WIFI_FILTER_LANES - 1) / OFX_OPENBCI_WIFI_FILTER_LANES;
+	reset();
+}
+
+int ofxOpenBciWifiFilterBank::getChannelCount()
+{
+	return _nChannels;
+}
+
+int ofxOpenBciWifiFilterBank::addStage(const vector<ofxOpenBciWifiBiquad>& sections)
+{
+	_stages.push_back(Stage());
+	_stages.back().enabled = true;
+	setStage(_stages.size() - 1, sections);
+	return _stages.size() - 1;
+}
+
+void ofxOpenBciWifiFilterBank::setStage(int stage, const vector<ofxOpenBciWifiBiquad>& sections)
+{
+	Stage& st = _stages.at(stage);
+	st.sections.resize(sections.size());
+	for (int i = 0; i < sections.size(); i++)
+	{
+		const ofxOpenBciWifiBiquad& design = sections.at(i);
+		Section& s = st.sections.at(i);
+		for (int ch = 0; ch < OFX_OPENBCI_WIFI_MAX_CHANNELS; ch++)
+		{
+			s.a0[ch] = (float)design.a0;
+			s.a1[ch] = (float)design.a1;
+			s.a2[ch] = (float)design.a2;
+			s.b1[ch] = (float)design.b1;
+			s.b2[ch] = (float)design.b2;
+			s.z1[ch] = 0.f;
+			s.z2[ch] = 0.f;
+		}
+	}
+}
+
+int ofxOpenBciWifiFilterBank::addBiquad(ofxOpenBciWifiBiquadType type, double normalizedFreq, double Q)
+{
+	return addStage(vector<ofxOpenBciWifiBiquad>(1, ofxOpenBciWifiFilterDesign::biquad(type, normalizedFreq, Q)));
+}
+
+void ofxOpenBciWifiFilterBank::setBiquad(int stage, ofxOpenBciWifiBiquadType type, double normalizedFreq, double Q)
+{
+	setStage(stage, vector<ofxOpenBciWifiBiquad>(1, ofxOpenBciWifiFilterDesign::biquad(type, normalizedFreq, Q)));
+}
+
+void ofxOpenBciWifiFilterBank::setCoefficients(int stage, double a0, double a1, double a2, double b1, double b2)
+{
+	ofxOpenBciWifiBiquad s = { a0, a1, a2, b1, b2 };
+	setStage(stage, vector<ofxOpenBciWifiBiquad>(1, s));
+}
+
+void ofxOpenBciWifiFilterBank::setEnabled(int stage, bool enabled)
+{
+	_stages.at(stage).enabled = enabled;
+}
+
+bool ofxOpenBciWifiFilterBank::isEnabled(int stage)
+{
+	return _stages.at(stage).enabled;
+}
+
+int ofxOpenBciWifiFilterBank::getStageCount()
+{
+	return _stages.size();
+}
+
+int ofxOpenBciWifiFilterBank::getSectionCount()
+{
+	int n = 0;
+	for (int i = 0; i < _stages.size(); i++)
+	{
+		n += _stages.at(i).sections.size();
+	}
+	return n;
+}
+
+void ofxOpenBciWifiFilterBank::clearSections()
+{
+	_stages.clear();
+}
+
+void ofxOpenBciWifiFilterBank::reset()
+{
+	for (int i = 0; i < _stages.size(); i++)
+	{
+		for (int j = 0; j < _stages.at(i).sections.size(); j++)
+		{
+			Section& s = _stages.at(i).sections.at(j);
+			memset(s.z1, 0, sizeof(s.z1));
+			memset(s.z2, 0, sizeof(s.z2));
+		}
+	}
+}
+
+void ofxOpenBciWifiFilterBank::process(float* frames, int nFrames, int stride)
+{
+	_active.clear();
+	for (int i = 0; i < _stages.size(); i++)
+	{
+		if (_stages[i].enabled)
+		{
+			for (int j = 0; j < _stages[i].sections.size(); j++)
+			{
+				_active.push_back(&_stages[i].sections[j]);
+			}
+		}
+	}
+	if (_active.empty() || nFrames <= 0)
+	{
+		return;
+	}
+
+	// Longer cascades run OFX_OPENBCI_WIFI_FILTER_MAX_FUSED sections at a time
+	for (int g = 0; g < _nGroups; g += 4)
+	{
+		int nGroups = min(_nGroups - g, 4);
+		for (int first = 0; first < _active.size(); first += OFX_OPENBCI_WIFI_FILTER_MAX_FUSED)
+		{
+			int nSections = min((int)_active.size() - first, OFX_OPENBCI_WIFI_FILTER_MAX_FUSED);
+			getKernel(nSections, nGroups)(frames, nFrames, stride, &_active[first], g * OFX_OPENBCI_WIFI_FILTER_LANES);
+		}
+	}
+}
@@ -0,0 +1,83 @@
+//
+//  ofxOpenBciWifiFilterBank.h
+//
+//  Cascade of biquad sections that filters every channel of a headset at once.
+//  Coefficients and state are kept structure-of-arrays, one lane per channel, and
+//  the block runs through SSE / NEON (4 lanes at a time), falling back to plain loops
+//  elsewhere. Sections are grouped into stages (e.g. a 4th order highpass) that are
+//  designed and switched on and off together.
+//  The enabled sections run in one pass over the block with a kernel specialized at compile
+//  time for up to OFX_OPENBCI_WIFI_FILTER_MAX_FUSED sections and 16 channels: each frame is
+//  loaded once, goes through every section with the state in registers and is stored once,
+//  and the sections' recursions overlap instead of each waiting on its own.
+//  Coefficients follow the same design as ofxBiquadFilter (transposed direct form II).
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiFilterDesign.h"
+
+#define OFX_OPENBCI_WIFI_FILTER_LANES 4		// Channels per SIMD register
+#define OFX_OPENBCI_WIFI_FILTER_MAX_FUSED 8	// Sections per pass of the specialized kernels
+
+class ofxOpenBciWifiFilterBank
+{
+private:
+	struct Section
+	{
+		alignas(16) float a0[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+		alignas(16) float a1[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+		alignas(16) float a2[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+		alignas(16) float b1[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+		alignas(16) float b2[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+		alignas(16) float z1[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+		alignas(16) float z2[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+	};
+
+	struct Stage
+	{
+		bool enabled;
+		vector<Section> sections;
+	};
+
+	typedef void (*Kernel)(float* frames, int nFrames, int stride, Section* const* sections, int firstLane);
+
+	int _nChannels;
+	int _nGroups;							// Lane groups covering _nChannels
+	vector<Stage> _stages;
+	vector<Section*> _active;				// Enabled sections in order, gathered by process()
+
+	// Runs NSections sections over NGroups lane groups starting at firstLane, frame by frame
+	template <int NSections, int NGroups>
+	static void processFused(float* frames, int nFrames, int stride, Section* const* sections, int firstLane);
+	static Kernel getKernel(int nSections, int nGroups);
+
+public:
+	ofxOpenBciWifiFilterBank();
+
+	// Sets the number of channels and clears the filter state
+	void setup(int nChannels);
+	int getChannelCount();
+
+	// Appends a stage of sections and returns its index
+	int addStage(const vector<ofxOpenBciWifiBiquad>& sections);
+	// Redesigns a stage, which may change its number of sections, and clears its state
+	void setStage(int stage, const vector<ofxOpenBciWifiBiquad>& sections);
+	// Stage of one section. normalizedFreq = cutoff / sampling frequency.
+	int addBiquad(ofxOpenBciWifiBiquadType type, double normalizedFreq, double Q = 0.7071);
+	void setBiquad(int stage, ofxOpenBciWifiBiquadType type, double normalizedFreq, double Q = 0.7071);
+	// Sets a stage to one section with raw coefficients for every channel, b1/b2 are the feedback terms
+	void setCoefficients(int stage, double a0, double a1, double a2, double b1, double b2);
+	void setEnabled(int stage, bool enabled);
+	bool isEnabled(int stage);
+	int getStageCount();
+	int getSectionCount();					// Of every stage, enabled or not
+	void clearSections();
+	void reset();
+
+	// Filters nFrames interleaved frames in place. stride is the number of floats from one frame
+	// to the next and must leave room for the channel count rounded up to OFX_OPENBCI_WIFI_FILTER_LANES.
+	void process(float* frames, int nFrames, int stride);
+};
@@ -0,0 +1,135 @@
+//
+//  ofxOpenBciWifiFilterDesign.cpp
+//
+//  Second order sections of Butterworth and Chebyshev filters and line noise notch combs.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiFilterDesign.h"
+
+namespace
+{
+	// Poles of the analog lowpass prototype with a cutoff of 1 rad/s in the upper left quadrant,
+	// one per conjugate pair plus the real pole of odd orders, lowest Q first
+	vector<pair<double, double>> getPrototypePoles(ofxOpenBciWifiFilterFamily family, int order, double rippleDb)
+	{
+		double sigma = 1.;
+		double omega = 1.;
+		if (family == OFX_OPENBCI_WIFI_FILTER_CHEBYSHEV)
+		{
+			double epsilon = sqrt(pow(10., max(rippleDb, 1e-6) / 10.) - 1.);
+			double mu = asinh(1. / epsilon) / order;
+			sigma = sinh(mu);
+			omega = cosh(mu);
+		}
+		vector<pair<double, double>> poles;
+		if (order % 2 == 1)
+		{
+			poles.push_back(make_pair(-sigma, 0.));
+		}
+		for (int k = order / 2 - 1; k >= 0; k--)
+		{
+			double theta = PI * (2. * k + 1.) / (2. * order);
+			poles.push_back(make_pair(-sigma * sin(theta), omega * cos(theta)));
+		}
+		return poles;
+	}
+
+	vector<ofxOpenBciWifiBiquad> design(ofxOpenBciWifiFilterFamily family, int order, double normalizedFreq, double rippleDb, bool highpass)
+	{
+		order = max(order, 1);
+		double K = tan(PI * normalizedFreq);
+		vector<pair<double, double>> poles = getPrototypePoles(family, order, rippleDb);
+		vector<ofxOpenBciWifiBiquad> sections;
+		for (int i = 0; i < poles.size(); i++)
+		{
+			// A highpass pole is the reciprocal of the lowpass one, so its pair has the same Q
+			double magnitude = sqrt(poles.at(i).first * poles.at(i).first + poles.at(i).second * poles.at(i).second);
+			double w = highpass ? K / magnitude : K * magnitude;
+			ofxOpenBciWifiBiquad s;
+			if (poles.at(i).second == 0.)
+			{
+				double norm = 1. / (1. + w);
+				s.a0 = highpass ? norm : w * norm;
+				s.a1 = highpass ? -s.a0 : s.a0;
+				s.a2 = 0.;
+				s.b1 = (w - 1.) * norm;
+				s.b2 = 0.;
+			}
+			else
+			{
+				double Q = magnitude / (-2. * poles.at(i).first);
+				double norm = 1. / (1. + w / Q + w * w);
+				s.a0 = highpass ? norm : w * w * norm;
+				s.a1 = highpass ? -2. * s.a0 : 2. * s.a0;
+				s.a2 = s.a0;
+				s.b1 = 2. * (w * w - 1.) * norm;
+				s.b2 = (1. - w / Q + w * w) * norm;
+			}
+			sections.push_back(s);
+		}
+		if (family == OFX_OPENBCI_WIFI_FILTER_CHEBYSHEV && order % 2 == 0)
+		{
+			// Even orders start the passband at the bottom of the ripple
+			double gain = pow(10., -max(rippleDb, 1e-6) / 20.);
+			sections.front().a0 *= gain;
+			sections.front().a1 *= gain;
+			sections.front().a2 *= gain;
+		}
+		return sections;
+	}
+}
+
+ofxOpenBciWifiBiquad ofxOpenBciWifiFilterDesign::biquad(ofxOpenBciWifiBiquadType type, double normalizedFreq, double Q)
+{
+	double K = tan(PI * normalizedFreq);
+	double norm = 1. / (1. + K / Q + K * K);
+	ofxOpenBciWifiBiquad s;
+	switch (type)
+	{
+	case OFX_OPENBCI_WIFI_BIQUAD_LOWPASS:
+		s.a0 = K * K * norm;
+		s.a1 = 2. * s.a0;
+		s.a2 = s.a0;
+		break;
+	case OFX_OPENBCI_WIFI_BIQUAD_HIGHPASS:
+		s.a0 = norm;
+		s.a1 = -2. * s.a0;
+		s.a2 = s.a0;
+		break;
+	case OFX_OPENBCI_WIFI_BIQUAD_NOTCH:
+	default:
+		s.a0 = (1. + K * K) * norm;
+		s.a1 = 2. * (K * K - 1.) * norm;
+		s.a2 = s.a0;
+		break;
+	}
+	s.b1 = 2. * (K * K - 1.) * norm;
+	s.b2 = (1. - K / Q + K * K) * norm;
+	return s;
+}
+
+vector<ofxOpenBciWifiBiquad> ofxOpenBciWifiFilterDesign::lowpass(ofxOpenBciWifiFilterFamily family, int order, double normalizedFreq, double rippleDb)
+{
+	return design(family, order, normalizedFreq, rippleDb, false);
+}
+
+vector<ofxOpenBciWifiBiquad> ofxOpenBciWifiFilterDesign::highpass(ofxOpenBciWifiFilterFamily family, int order, double normalizedFreq, double rippleDb)
+{
+	return design(family, order, normalizedFreq, rippleDb, true);
+}
+
+vector<ofxOpenBciWifiBiquad> ofxOpenBciWifiFilterDesign::harmonicNotch(double normalizedFreq, int nHarmonics, double Q)
+{
+	vector<ofxOpenBciWifiBiquad> sections;
+	for (int k = 1; normalizedFreq > 0. && k * normalizedFreq < 0.5; k++)
+	{
+		if (nHarmonics > 0 && k > nHarmonics)
+		{
+			break;
+		}
+		sections.push_back(biquad(OFX_OPENBCI_WIFI_BIQUAD_NOTCH, k * normalizedFreq, k * Q));
+	}
+	return sections;
+}
@@ -0,0 +1,52 @@
+//
+//  ofxOpenBciWifiFilterDesign.h
+//
+//  Second order sections of Butterworth and Chebyshev (type I) low / high-pass filters of any
+//  order and of line noise notch combs, for ofxOpenBciWifiFilterBank. The analog prototype
+//  poles are paired into biquads and mapped with the prewarped bilinear transform, the same
+//  mapping as ofxBiquadFilter.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+enum ofxOpenBciWifiBiquadType
+{
+	OFX_OPENBCI_WIFI_BIQUAD_LOWPASS,
+	OFX_OPENBCI_WIFI_BIQUAD_HIGHPASS,
+	OFX_OPENBCI_WIFI_BIQUAD_NOTCH
+};
+
+enum ofxOpenBciWifiFilterFamily
+{
+	OFX_OPENBCI_WIFI_FILTER_BUTTERWORTH,		// Maximally flat, -3 dB at the cutoff
+	OFX_OPENBCI_WIFI_FILTER_CHEBYSHEV			// Steeper, rippleDb of passband ripple, -rippleDb at the cutoff
+};
+
+// Transposed direct form II section, a are the feedforward and b the feedback terms
+struct ofxOpenBciWifiBiquad
+{
+	double a0;
+	double a1;
+	double a2;
+	double b1;
+	double b2;
+};
+
+class ofxOpenBciWifiFilterDesign
+{
+public:
+	// normalizedFreq = frequency / sampling frequency
+	static ofxOpenBciWifiBiquad biquad(ofxOpenBciWifiBiquadType type, double normalizedFreq, double Q = 0.7071);
+
+	// order / 2 biquads, plus a first order section for odd orders, lowest Q first
+	static vector<ofxOpenBciWifiBiquad> lowpass(ofxOpenBciWifiFilterFamily family, int order, double normalizedFreq, double rippleDb = 0.5);
+	static vector<ofxOpenBciWifiBiquad> highpass(ofxOpenBciWifiFilterFamily family, int order, double normalizedFreq, double rippleDb = 0.5);
+
+	// Notches at the first nHarmonics multiples of normalizedFreq below Nyquist (0 = all of them).
+	// Q is the fundamental's, the harmonics get the same width in Hz.
+	static vector<ofxOpenBciWifiBiquad> harmonicNotch(double normalizedFreq, int nHarmonics = 0, double Q = 30.);
+};
@@ -0,0 +1,158 @@
+//
+//  ofxOpenBciWifiInstrumentation.cpp
+//
+//  Per-headset stage latencies and throughput.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiInstrumentation.h"
+
+ofxOpenBciWifiHistogram::ofxOpenBciWifiHistogram()
+{
+	reset();
+}
+
+int ofxOpenBciWifiHistogram::getBucket(uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+	{
+		return (int)value;
+	}
+	int msb = SUB_BITS;
+	while (msb < MAX_BITS && (value >> (msb + 1)) != 0)
+	{
+		msb++;
+	}
+	if (msb >= MAX_BITS)
+	{
+		return N_BUCKETS - 1;
+	}
+	int shift = msb - SUB_BITS;
+	return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t ofxOpenBciWifiHistogram::getBucketValue(int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+	{
+		return bucket;
+	}
+	int shift = bucket / SUB_BUCKETS - 1;
+	uint64_t base = (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	return base + ((uint64_t)1 << shift) - 1;
+}
+
+void ofxOpenBciWifiHistogram::add(uint64_t value)
+{
+	_buckets[getBucket(value)]++;
+	_count++;
+	_max = max(_max, value);
+}
+
+uint64_t ofxOpenBciWifiHistogram::getCount()
+{
+	return _count;
+}
+
+uint64_t ofxOpenBciWifiHistogram::getMax()
+{
+	return _max;
+}
+
+uint64_t ofxOpenBciWifiHistogram::getPercentile(double percentile)
+{
+	if (_count == 0)
+	{
+		return 0;
+	}
+	uint64_t target = (uint64_t)ceil(percentile / 100. * _count);
+	target = max(target, (uint64_t)1);
+	uint64_t seen = 0;
+	for (int b = 0; b < N_BUCKETS; b++)
+	{
+		seen += _buckets[b];
+		if (seen >= target)
+		{
+			return min(getBucketValue(b), _max);
+		}
+	}
+	return _max;
+}
+
+void ofxOpenBciWifiHistogram::reset()
+{
+	memset(_buckets, 0, sizeof(_buckets));
+	_count = 0;
+	_max = 0;
+}
+
+ofxOpenBciWifiInstrumentation::ofxOpenBciWifiInstrumentation()
+{
+	reset(0);
+}
+
+void ofxOpenBciWifiInstrumentation::reset(uint64_t now)
+{
+	for (int i = 0; i < OFX_OPENBCI_WIFI_STAGE_COUNT; i++)
+	{
+		_stages[i].reset();
+	}
+	_startTime = now;
+	_samples = 0;
+	_bytes = 0;
+	_fftFrames = 0;
+}
+
+void ofxOpenBciWifiInstrumentation::record(ofxOpenBciWifiStage stage, uint64_t micros)
+{
+	_stages[stage].add(micros);
+}
+
+void ofxOpenBciWifiInstrumentation::addSamples(uint64_t n)
+{
+	_samples += n;
+}
+
+void ofxOpenBciWifiInstrumentation::addBytes(uint64_t n)
+{
+	_bytes += n;
+}
+
+void ofxOpenBciWifiInstrumentation::addFftFrames(uint64_t n)
+{
+	_fftFrames += n;
+}
+
+ofxOpenBciWifiInstrumentationSnapshot ofxOpenBciWifiInstrumentation::getSnapshot(uint64_t now)
+{
+	ofxOpenBciWifiInstrumentationSnapshot snapshot;
+	snapshot.seconds = (now - _startTime) / 1000000.;
+	for (int i = 0; i < OFX_OPENBCI_WIFI_STAGE_COUNT; i++)
+	{
+		snapshot.stages[i].count = _stages[i].getCount();
+		snapshot.stages[i].p50Micros = _stages[i].getPercentile(50);
+		snapshot.stages[i].p99Micros = _stages[i].getPercentile(99);
+		snapshot.stages[i].maxMicros = _stages[i].getMax();
+	}
+	double seconds = max(snapshot.seconds, 1e-6);
+	snapshot.samplesPerSecond = _samples / seconds;
+	snapshot.bytesPerSecond = _bytes / seconds;
+	snapshot.fftFramesPerSecond = _fftFrames / seconds;
+	return snapshot;
+}
+
+string ofxOpenBciWifiInstrumentation::toString(const ofxOpenBciWifiInstrumentationSnapshot& snapshot)
+{
+	static const char* names[OFX_OPENBCI_WIFI_STAGE_COUNT] = { "receive", "parse", "filter", "fft", "delivery" };
+	string str = ofToString(snapshot.samplesPerSecond, 1) + " samples/s, "
+		+ ofToString(snapshot.bytesPerSecond, 0) + " bytes/s, "
+		+ ofToString(snapshot.fftFramesPerSecond, 2) + " fft/s";
+	for (int i = 0; i < OFX_OPENBCI_WIFI_STAGE_COUNT; i++)
+	{
+		const ofxOpenBciWifiStageStats& stage = snapshot.stages[i];
+		str += " | " + string(names[i]) + " p50 " + ofToString(stage.p50Micros)
+			+ " p99 " + ofToString(stage.p99Micros) + " max " + ofToString(stage.maxMicros) + " us";
+	}
+	return str;
+}
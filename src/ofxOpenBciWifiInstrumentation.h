@@ -0,0 +1,61 @@
+//
+//  ofxOpenBciWifiInstrumentation.h
+//
+//  Per-headset stage latencies and throughput. Latencies go into fixed log-linear
+//  histograms (8 buckets per power of two, so percentiles are within 12.5%) and
+//  recording a value is a handful of integer operations with no allocation.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+class ofxOpenBciWifiHistogram
+{
+private:
+	static const int SUB_BITS = 3;
+	static const int SUB_BUCKETS = 1 << SUB_BITS;
+	static const int MAX_BITS = 40;				// Values are clamped to 2^40 us (~12 days)
+	static const int N_BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+	uint32_t _buckets[N_BUCKETS];
+	uint64_t _count;
+	uint64_t _max;
+
+	static int getBucket(uint64_t value);
+	static uint64_t getBucketValue(int bucket);	// Largest value that falls into bucket
+
+public:
+	ofxOpenBciWifiHistogram();
+
+	void add(uint64_t value);
+	uint64_t getCount();
+	uint64_t getMax();
+	uint64_t getPercentile(double percentile);	// 0 - 100
+	void reset();
+};
+
+class ofxOpenBciWifiInstrumentation
+{
+private:
+	ofxOpenBciWifiHistogram _stages[OFX_OPENBCI_WIFI_STAGE_COUNT];
+	uint64_t _startTime;
+	uint64_t _samples;
+	uint64_t _bytes;
+	uint64_t _fftFrames;
+
+public:
+	ofxOpenBciWifiInstrumentation();
+
+	void reset(uint64_t now);
+	void record(ofxOpenBciWifiStage stage, uint64_t micros);
+	void addSamples(uint64_t n);
+	void addBytes(uint64_t n);
+	void addFftFrames(uint64_t n);
+	ofxOpenBciWifiInstrumentationSnapshot getSnapshot(uint64_t now);
+
+	// One line summary for the periodic dump
+	static string toString(const ofxOpenBciWifiInstrumentationSnapshot& snapshot);
+};
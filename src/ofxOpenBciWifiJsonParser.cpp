@@ -0,0 +1,305 @@
+//
+//  ofxOpenBciWifiJsonParser.cpp
+//
+//  Incremental parser for the {"chunk":[...]} JSON stream sent by the OpenBci Wifi shield.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiJsonParser.h"
+
+static const char CHUNK_PREFIX[] = "{\"chunk\":";
+static const int CHUNK_PREFIX_LEN = sizeof(CHUNK_PREFIX) - 1;
+
+ofxOpenBciWifiJsonParser::ofxOpenBciWifiJsonParser()
+{
+	_errorCount = 0;
+	_pending.reserve(64);
+	reset();
+	_resync = false; // A fresh stream starts on a chunk boundary
+}
+
+void ofxOpenBciWifiJsonParser::reset()
+{
+	_depth = 0;
+	_expectKey = false;
+	_inString = false;
+	_stringIsKey = false;
+	_escape = false;
+	_keyLen = 0;
+	_tokenLen = 0;
+	_inSample = false;
+	_dataIndex = 0;
+	_count = 0;
+	_pending.clear();
+	startResync();
+}
+
+unsigned int ofxOpenBciWifiJsonParser::getErrorCount()
+{
+	return _errorCount;
+}
+
+int ofxOpenBciWifiJsonParser::parse(const char* bytes, size_t nBytes, vector<ofxOpenBciWifiSample>& samples)
+{
+	int nNew = 0;
+	for (size_t i = 0; i < nBytes; i++)
+	{
+		char c = bytes[i];
+
+		if (_resync)
+		{
+			resyncByte(c);
+			continue;
+		}
+
+		if (_inString)
+		{
+			if (_escape)
+			{
+				_escape = false;
+			}
+			else if (c == '\\')
+			{
+				_escape = true;
+			}
+			else if (c == '"')
+			{
+				_inString = false;
+				if (_stringIsKey)
+				{
+					_keys[_depth - 1] = lookupKey();
+				}
+			}
+			else if (_stringIsKey && _keyLen <= MAX_KEY_LEN)
+			{
+				if (_keyLen < MAX_KEY_LEN)
+				{
+					_keyBuf[_keyLen] = c;
+				}
+				_keyLen++;
+			}
+			continue;
+		}
+
+		switch (c)
+		{
+		case ' ':
+		case '\t':
+		case '\r':
+		case '\n':
+			endToken();
+			break;
+		case '"':
+			if (_depth == 0) break;
+			endToken();
+			_inString = true;
+			_escape = false;
+			_stringIsKey = _expectKey && _containers[_depth - 1] == '{';
+			_keyLen = 0;
+			break;
+		case '{':
+		case '[':
+			pushContainer(c);
+			break;
+		case '}':
+		case ']':
+			if (_depth == 0) break;
+			endToken();
+			popContainer(c, samples, nNew);
+			break;
+		case ':':
+			if (_depth == 0) break;
+			_expectKey = false;
+			break;
+		case ',':
+			if (_depth == 0) break;
+			endToken();
+			if (_containers[_depth - 1] == '{')
+			{
+				_expectKey = true;
+				_keys[_depth - 1] = KEY_OTHER;
+			}
+			break;
+		default:
+			if (_depth == 0) break;
+			if (_tokenLen == MAX_TOKEN_LEN)
+			{
+				fail();
+				break;
+			}
+			_token[_tokenLen++] = c;
+			break;
+		}
+	}
+	return nNew;
+}
+
+void ofxOpenBciWifiJsonParser::pushContainer(char c)
+{
+	if (_depth == MAX_DEPTH)
+	{
+		fail();
+		return;
+	}
+	if (_depth == 0 && c != '{')
+	{
+		return;
+	}
+	endToken();
+
+	_containers[_depth] = c;
+	_keys[_depth] = KEY_OTHER;
+	_depth++;
+	_expectKey = (c == '{');
+
+	if (_depth == 1)
+	{
+		_count = 0;
+		_pending.clear();
+	}
+	else if (c == '{' && _depth == 3 && _keys[0] == KEY_CHUNK && _containers[1] == '[')
+	{
+		// Start of a sample object inside the chunk array
+		_inSample = true;
+		_dataIndex = 0;
+		_sample.timestamp = 0;
+		_sample.sampleNumber = 0;
+		_sample.count = 0;
+		_sample.nChannels = 0;
+		memset(_sample.data, 0, sizeof(_sample.data));
+		_sample.nAux = 0;
+		memset(_sample.aux, 0, sizeof(_sample.aux));
+	}
+	else if (c == '[' && _depth == 4 && _inSample && _keys[2] == KEY_DATA)
+	{
+		_dataIndex = 0;
+	}
+}
+
+void ofxOpenBciWifiJsonParser::popContainer(char c, vector<ofxOpenBciWifiSample>& samples, int& nNew)
+{
+	char open = (c == '}') ? '{' : '[';
+	if (_containers[_depth - 1] != open)
+	{
+		fail();
+		return;
+	}
+	_depth--;
+	_expectKey = false;
+
+	if (_depth == 2 && _inSample)
+	{
+		// End of a sample object
+		_inSample = false;
+		_sample.nChannels = min(_dataIndex, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		_pending.push_back(_sample);
+	}
+	else if (_depth == 0)
+	{
+		// End of the chunk, hand its samples over
+		for (size_t s = 0; s < _pending.size(); s++)
+		{
+			_pending[s].count = _count;
+			samples.push_back(_pending[s]);
+		}
+		nNew += _pending.size();
+		_pending.clear();
+	}
+}
+
+void ofxOpenBciWifiJsonParser::endToken()
+{
+	if (_tokenLen == 0)
+	{
+		return;
+	}
+	_token[_tokenLen] = '\0';
+	_tokenLen = 0;
+
+	char* end;
+	double value = strtod(_token, &end);
+	if (end == _token)
+	{
+		// true, false, null
+		return;
+	}
+
+	if (_inSample)
+	{
+		if (_depth == 3)
+		{
+			if (_keys[2] == KEY_TIMESTAMP)
+			{
+				_sample.timestamp = value;
+			}
+			else if (_keys[2] == KEY_SAMPLE_NUMBER)
+			{
+				_sample.sampleNumber = (int)value;
+			}
+		}
+		else if (_depth == 4 && _keys[2] == KEY_DATA && _containers[3] == '[')
+		{
+			if (_dataIndex < OFX_OPENBCI_WIFI_MAX_CHANNELS)
+			{
+				_sample.data[_dataIndex] = (float)value;
+			}
+			_dataIndex++;
+		}
+	}
+	else if (_depth == 1 && _keys[0] == KEY_COUNT)
+	{
+		_count = (int)value;
+	}
+}
+
+ofxOpenBciWifiJsonParser::Key ofxOpenBciWifiJsonParser::lookupKey()
+{
+	if (_keyLen > MAX_KEY_LEN)
+	{
+		return KEY_OTHER;
+	}
+	if (_keyLen == 5 && memcmp(_keyBuf, "chunk", 5) == 0) return KEY_CHUNK;
+	if (_keyLen == 9 && memcmp(_keyBuf, "timestamp", 9) == 0) return KEY_TIMESTAMP;
+	if (_keyLen == 12 && memcmp(_keyBuf, "sampleNumber", 12) == 0) return KEY_SAMPLE_NUMBER;
+	if (_keyLen == 4 && memcmp(_keyBuf, "data", 4) == 0) return KEY_DATA;
+	if (_keyLen == 5 && memcmp(_keyBuf, "count", 5) == 0) return KEY_COUNT;
+	return KEY_OTHER;
+}
+
+void ofxOpenBciWifiJsonParser::fail()
+{
+	_errorCount++;
+	reset();
+}
+
+void ofxOpenBciWifiJsonParser::startResync()
+{
+	_resync = true;
+	_resyncMatched = 0;
+}
+
+void ofxOpenBciWifiJsonParser::resyncByte(char c)
+{
+	if (c == CHUNK_PREFIX[_resyncMatched])
+	{
+		_resyncMatched++;
+	}
+	else
+	{
+		// '{' only appears at the start of the prefix
+		_resyncMatched = (c == CHUNK_PREFIX[0]) ? 1 : 0;
+	}
+
+	if (_resyncMatched == CHUNK_PREFIX_LEN)
+	{
+		// Continue as if {"chunk": had just been parsed
+		_resync = false;
+		_depth = 1;
+		_containers[0] = '{';
+		_keys[0] = KEY_CHUNK;
+		_expectKey = false;
+		_count = 0;
+		_pending.clear();
+	}
+}
@@ -0,0 +1,78 @@
+//
+//  ofxOpenBciWifiJsonParser.h
+//
+//  Incremental parser for the {"chunk":[...]} JSON stream sent by the OpenBci Wifi shield.
+//  Bytes can be fed in arbitrary pieces, partial chunks are kept until the rest arrives
+//  and samples are written straight into ofxOpenBciWifiSample structs.
+//  Nothing is allocated once the output vectors have grown to the largest chunk size.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+class ofxOpenBciWifiJsonParser
+{
+private:
+	static const int MAX_DEPTH = 8;
+	static const int MAX_KEY_LEN = 16;
+	static const int MAX_TOKEN_LEN = 40;
+
+	enum Key
+	{
+		KEY_OTHER,
+		KEY_CHUNK,
+		KEY_TIMESTAMP,
+		KEY_SAMPLE_NUMBER,
+		KEY_DATA,
+		KEY_COUNT
+	};
+
+	int _depth;
+	char _containers[MAX_DEPTH];			// '{' or '[' for each open container
+	Key _keys[MAX_DEPTH];					// Key of the current value in each open object
+	bool _expectKey;
+
+	bool _inString;
+	bool _stringIsKey;
+	bool _escape;
+	char _keyBuf[MAX_KEY_LEN];
+	int _keyLen;
+
+	char _token[MAX_TOKEN_LEN + 1];
+	int _tokenLen;
+
+	bool _resync;							// Skip bytes until the next {"chunk": is found
+	int _resyncMatched;
+
+	bool _inSample;
+	int _dataIndex;
+	int _count;
+	ofxOpenBciWifiSample _sample;
+	vector<ofxOpenBciWifiSample> _pending;	// Samples of the chunk currently being parsed
+
+	unsigned int _errorCount;
+
+	void pushContainer(char c);
+	void popContainer(char c, vector<ofxOpenBciWifiSample>& samples, int& nNew);
+	void endToken();
+	Key lookupKey();
+	void fail();
+	void startResync();
+	void resyncByte(char c);
+
+public:
+	ofxOpenBciWifiJsonParser();
+
+	// Parses the next nBytes of the stream and appends each sample of every completed chunk to samples.
+	// Returns the number of samples appended.
+	int parse(const char* bytes, size_t nBytes, vector<ofxOpenBciWifiSample>& samples);
+
+	// Drops any partial chunk and waits for the start of the next one
+	void reset();
+
+	// Number of malformed chunks that were skipped
+	unsigned int getErrorCount();
+};
@@ -0,0 +1,324 @@
+//
+//  ofxOpenBciWifiMontage.cpp
+//
+//  Spatial re-referencing of a headset's channels.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiMontage.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OFX_OPENBCI_WIFI_MONTAGE_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define OFX_OPENBCI_WIFI_MONTAGE_NEON
+#endif
+
+// Four output channels and the multiply-add a dense montage needs on them
+#if defined(OFX_OPENBCI_WIFI_MONTAGE_SSE)
+typedef __m128 Lanes;
+static inline Lanes zeroLanes() { return _mm_setzero_ps(); }
+static inline Lanes broadcastLanes(float x) { return _mm_set1_ps(x); }
+static inline Lanes loadLanes(const float* p) { return _mm_loadu_ps(p); }
+static inline void storeLanes(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+static inline Lanes mulAddLanes(Lanes acc, Lanes a, Lanes b) { return _mm_add_ps(acc, _mm_mul_ps(a, b)); }
+#elif defined(OFX_OPENBCI_WIFI_MONTAGE_NEON)
+typedef float32x4_t Lanes;
+static inline Lanes zeroLanes() { return vdupq_n_f32(0.f); }
+static inline Lanes broadcastLanes(float x) { return vdupq_n_f32(x); }
+static inline Lanes loadLanes(const float* p) { return vld1q_f32(p); }
+static inline void storeLanes(float* p, Lanes v) { vst1q_f32(p, v); }
+static inline Lanes mulAddLanes(Lanes acc, Lanes a, Lanes b) { return vaddq_f32(acc, vmulq_f32(a, b)); }
+#else
+struct Lanes
+{
+	float v[OFX_OPENBCI_WIFI_MONTAGE_LANES];
+};
+static inline Lanes zeroLanes()
+{
+	Lanes r;
+	for (int l = 0; l < OFX_OPENBCI_WIFI_MONTAGE_LANES; l++)
+	{
+		r.v[l] = 0.f;
+	}
+	return r;
+}
+static inline Lanes broadcastLanes(float x)
+{
+	Lanes r;
+	for (int l = 0; l < OFX_OPENBCI_WIFI_MONTAGE_LANES; l++)
+	{
+		r.v[l] = x;
+	}
+	return r;
+}
+static inline Lanes loadLanes(const float* p)
+{
+	Lanes r;
+	for (int l = 0; l < OFX_OPENBCI_WIFI_MONTAGE_LANES; l++)
+	{
+		r.v[l] = p[l];
+	}
+	return r;
+}
+static inline void storeLanes(float* p, Lanes a)
+{
+	for (int l = 0; l < OFX_OPENBCI_WIFI_MONTAGE_LANES; l++)
+	{
+		p[l] = a.v[l];
+	}
+}
+static inline Lanes mulAddLanes(Lanes acc, Lanes a, Lanes b)
+{
+	for (int l = 0; l < OFX_OPENBCI_WIFI_MONTAGE_LANES; l++)
+	{
+		acc.v[l] += a.v[l] * b.v[l];
+	}
+	return acc;
+}
+#endif
+
+ofxOpenBciWifiMontage::ofxOpenBciWifiMontage()
+{
+	_commonAverage = false;
+	_nOutputs = 0;
+	setup(0);
+}
+
+ofxOpenBciWifiMontage ofxOpenBciWifiMontage::commonAverage()
+{
+	ofxOpenBciWifiMontage montage;
+	montage._commonAverage = true;
+	return montage;
+}
+
+ofxOpenBciWifiMontage ofxOpenBciWifiMontage::bipolar(const vector<pair<int, int>>& pairs)
+{
+	vector<ofxOpenBciWifiMontageTerm> terms;
+	for (int p = 0; p < pairs.size(); p++)
+	{
+		terms.push_back({ p, pairs.at(p).first, 1.f });
+		terms.push_back({ p, pairs.at(p).second, -1.f });
+	}
+	return sparse(pairs.size(), terms);
+}
+
+ofxOpenBciWifiMontage ofxOpenBciWifiMontage::laplacian(const vector<vector<int>>& neighbours)
+{
+	vector<ofxOpenBciWifiMontageTerm> terms;
+	for (int ch = 0; ch < neighbours.size(); ch++)
+	{
+		terms.push_back({ ch, ch, 1.f });
+		for (int n = 0; n < neighbours.at(ch).size(); n++)
+		{
+			terms.push_back({ ch, neighbours.at(ch).at(n), -1.f / neighbours.at(ch).size() });
+		}
+	}
+	return sparse(neighbours.size(), terms);
+}
+
+ofxOpenBciWifiMontage ofxOpenBciWifiMontage::matrix(int nOutputs, int nInputs, const vector<float>& weights)
+{
+	vector<ofxOpenBciWifiMontageTerm> terms;
+	for (int o = 0; o < nOutputs; o++)
+	{
+		for (int i = 0; i < nInputs && o * nInputs + i < weights.size(); i++)
+		{
+			if (weights.at(o * nInputs + i) != 0.f)
+			{
+				terms.push_back({ o, i, weights.at(o * nInputs + i) });
+			}
+		}
+	}
+	return sparse(nOutputs, terms);
+}
+
+ofxOpenBciWifiMontage ofxOpenBciWifiMontage::sparse(int nOutputs, const vector<ofxOpenBciWifiMontageTerm>& terms)
+{
+	ofxOpenBciWifiMontage montage;
+	montage._nOutputs = max(nOutputs, 0);
+	montage._terms = terms;
+	return montage;
+}
+
+void ofxOpenBciWifiMontage::setup(int nInputChannels)
+{
+	_nInputs = max(0, min(nInputChannels, OFX_OPENBCI_WIFI_MAX_CHANNELS));
+	vector<ofxOpenBciWifiMontageTerm> terms;
+	if (_commonAverage)
+	{
+		// Subtracts the mean instead of running the N x N matrix
+		_nChannels = _nInputs;
+	}
+	else
+	{
+		_nChannels = min(_nOutputs, OFX_OPENBCI_WIFI_MAX_CHANNELS);
+		for (int t = 0; t < _terms.size(); t++)
+		{
+			const ofxOpenBciWifiMontageTerm& term = _terms.at(t);
+			if (term.output >= 0 && term.output < _nChannels && term.input >= 0 && term.input < _nInputs)
+			{
+				terms.push_back(term);
+			}
+		}
+	}
+	_nGroups = (_nChannels + OFX_OPENBCI_WIFI_MONTAGE_LANES - 1) / OFX_OPENBCI_WIFI_MONTAGE_LANES;
+
+	// Dense costs a vector multiply-add per input and lane group, sparse a scalar one per term
+	_dense = !_commonAverage && terms.size() > _nGroups * _nInputs;
+	_weights.clear();
+	_rowStarts.assign(_nChannels + 1, 0);
+	_columns.clear();
+	_values.clear();
+	if (_dense)
+	{
+		_weights.assign(_nInputs * _nGroups * OFX_OPENBCI_WIFI_MONTAGE_LANES, 0.f);
+		for (int t = 0; t < terms.size(); t++)
+		{
+			_weights.at(terms.at(t).input * _nGroups * OFX_OPENBCI_WIFI_MONTAGE_LANES + terms.at(t).output) += terms.at(t).weight;
+		}
+	}
+	else
+	{
+		// Grouped by output, each output's terms keep their order
+		for (int o = 0; o < _nChannels; o++)
+		{
+			_rowStarts.at(o) = _columns.size();
+			for (int t = 0; t < terms.size(); t++)
+			{
+				if (terms.at(t).output == o)
+				{
+					_columns.push_back(terms.at(t).input);
+					_values.push_back(terms.at(t).weight);
+				}
+			}
+		}
+		_rowStarts.at(_nChannels) = _columns.size();
+	}
+}
+
+int ofxOpenBciWifiMontage::getInputCount()
+{
+	return _nInputs;
+}
+
+int ofxOpenBciWifiMontage::getOutputCount()
+{
+	return _nChannels;
+}
+
+bool ofxOpenBciWifiMontage::isDense()
+{
+	return _dense;
+}
+
+void ofxOpenBciWifiMontage::process(float* frames, int nFrames, int stride)
+{
+	if (_commonAverage)
+	{
+		processCommonAverage(frames, nFrames, stride);
+	}
+	else if (_dense && _nGroups > 0)
+	{
+		getKernel(_nGroups)(frames, nFrames, stride, &_weights[0], _nInputs);
+	}
+	else
+	{
+		processSparse(frames, nFrames, stride);
+	}
+}
+
+template <int NGroups>
+void ofxOpenBciWifiMontage::processDense(float* frames, int nFrames, int stride, const float* weights, int nInputs)
+{
+	for (int f = 0; f < nFrames; f++)
+	{
+		// Every input is read before the outputs overwrite the frame
+		float* frame = frames + f * stride;
+		Lanes acc[NGroups];
+		for (int g = 0; g < NGroups; g++)
+		{
+			acc[g] = zeroLanes();
+		}
+		const float* w = weights;
+		for (int i = 0; i < nInputs; i++, w += NGroups * OFX_OPENBCI_WIFI_MONTAGE_LANES)
+		{
+			Lanes x = broadcastLanes(frame[i]);
+			for (int g = 0; g < NGroups; g++)
+			{
+				acc[g] = mulAddLanes(acc[g], loadLanes(w + g * OFX_OPENBCI_WIFI_MONTAGE_LANES), x);
+			}
+		}
+		for (int g = 0; g < NGroups; g++)
+		{
+			storeLanes(frame + g * OFX_OPENBCI_WIFI_MONTAGE_LANES, acc[g]);
+		}
+		for (int ch = NGroups * OFX_OPENBCI_WIFI_MONTAGE_LANES; ch < stride; ch++)
+		{
+			frame[ch] = 0.f;
+		}
+	}
+}
+
+ofxOpenBciWifiMontage::Kernel ofxOpenBciWifiMontage::getKernel(int nGroups)
+{
+	switch (nGroups)
+	{
+	case 1:
+		return &processDense<1>;
+	case 2:
+		return &processDense<2>;
+	case 3:
+		return &processDense<3>;
+	case 4:
+	default:
+		return &processDense<4>;
+	}
+}
+
+void ofxOpenBciWifiMontage::processCommonAverage(float* frames, int nFrames, int stride)
+{
+	float scale = _nInputs > 0 ? 1.f / _nInputs : 0.f;
+	for (int f = 0; f < nFrames; f++)
+	{
+		float* frame = frames + f * stride;
+		float sum = 0.f;
+		for (int ch = 0; ch < _nInputs; ch++)
+		{
+			sum += frame[ch];
+		}
+		float mean = sum * scale;
+		for (int ch = 0; ch < _nInputs; ch++)
+		{
+			frame[ch] -= mean;
+		}
+		for (int ch = _nInputs; ch < stride; ch++)
+		{
+			frame[ch] = 0.f;
+		}
+	}
+}
+
+void ofxOpenBciWifiMontage::processSparse(float* frames, int nFrames, int stride)
+{
+	for (int f = 0; f < nFrames; f++)
+	{
+		float* frame = frames + f * stride;
+		for (int o = 0; o < _nChannels; o++)
+		{
+			float sum = 0.f;
+			for (int t = _rowStarts[o]; t < _rowStarts[o + 1]; t++)
+			{
+				sum += _values[t] * frame[_columns[t]];
+			}
+			_row[o] = sum;
+		}
+		memcpy(frame, _row, _nChannels * sizeof(float));
+		for (int ch = _nChannels; ch < stride; ch++)
+		{
+			frame[ch] = 0.f;
+		}
+	}
+}
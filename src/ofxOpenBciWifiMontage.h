@@ -0,0 +1,78 @@
+//
+//  ofxOpenBciWifiMontage.h
+//
+//  Spatial re-referencing of a headset's channels: common average, bipolar pairs, Laplacian
+//  or any M x N matrix, applied to blocks of interleaved frames in place. setup() builds the
+//  kernel for the headset's channel count: a dense one, with the outputs in 4 channel lane
+//  groups held in SSE / NEON registers while every input is multiplied in, or a sparse one
+//  that only visits the nonzero weights, whichever does less work. The common average
+//  subtracts the mean of the channels rather than running its N x N matrix.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+#define OFX_OPENBCI_WIFI_MONTAGE_LANES 4		// Output channels per SIMD register
+
+// One weight of a montage, an output channel is the sum of its terms' weight x input channel
+struct ofxOpenBciWifiMontageTerm
+{
+	int output;
+	int input;
+	float weight;
+};
+
+class ofxOpenBciWifiMontage
+{
+private:
+	typedef void (*Kernel)(float* frames, int nFrames, int stride, const float* weights, int nInputs);
+
+	bool _commonAverage;						// Sized by setup() from the input count
+	int _nOutputs;
+	vector<ofxOpenBciWifiMontageTerm> _terms;
+
+	// Built by setup()
+	int _nInputs;
+	int _nChannels;								// Outputs
+	int _nGroups;								// Lane groups covering _nChannels
+	bool _dense;
+	vector<float> _weights;						// Dense: Inputs x Groups x OFX_OPENBCI_WIFI_MONTAGE_LANES
+	vector<int> _rowStarts;						// Sparse: terms of output o are [_rowStarts[o], _rowStarts[o + 1])
+	vector<int> _columns;
+	vector<float> _values;
+	float _row[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+
+	template <int NGroups>
+	static void processDense(float* frames, int nFrames, int stride, const float* weights, int nInputs);
+	static Kernel getKernel(int nGroups);
+	void processCommonAverage(float* frames, int nFrames, int stride);
+	void processSparse(float* frames, int nFrames, int stride);
+
+public:
+	ofxOpenBciWifiMontage();					// No outputs, see the montages below
+
+	// Every channel minus the mean of all the headset's channels
+	static ofxOpenBciWifiMontage commonAverage();
+	// One output per pair, first minus second
+	static ofxOpenBciWifiMontage bipolar(const vector<pair<int, int>>& pairs);
+	// Channel i minus the mean of neighbours[i], e.g. a small Laplacian around each electrode
+	static ofxOpenBciWifiMontage laplacian(const vector<vector<int>>& neighbours);
+	// nOutputs x nInputs weights, row major
+	static ofxOpenBciWifiMontage matrix(int nOutputs, int nInputs, const vector<float>& weights);
+	static ofxOpenBciWifiMontage sparse(int nOutputs, const vector<ofxOpenBciWifiMontageTerm>& terms);
+
+	// Builds the kernel for nInputChannels. Terms of inputs the headset doesn't have are dropped,
+	// outputs stop at OFX_OPENBCI_WIFI_MAX_CHANNELS.
+	void setup(int nInputChannels);
+	int getInputCount();
+	int getOutputCount();
+	bool isDense();								// False for sparse matrices and the common average
+
+	// Replaces the first channels of nFrames interleaved frames with the outputs and zeros the
+	// rest of each frame. stride is the number of floats from one frame to the next and must
+	// leave room for the input and output counts rounded up to OFX_OPENBCI_WIFI_MONTAGE_LANES.
+	void process(float* frames, int nFrames, int stride);
+};
@@ -0,0 +1,150 @@
+//
+//  ofxOpenBciWifiRawDecoder.cpp
+//
+//  Decoder for the raw 33 byte Cyton packets the OpenBci Wifi shield sends in raw output mode.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiRawDecoder.h"
+
+static const unsigned char PACKET_HEADER = 0xA0;
+static const unsigned char PACKET_FOOTER = 0xC0;	// Upper nibble, lower nibble is the aux type
+static const unsigned char FOOTER_ACCEL = 0xC0;
+
+static inline bool isPacketStart(const unsigned char* p)
+{
+	return p[0] == PACKET_HEADER && (p[32] & 0xF0) == PACKET_FOOTER;
+}
+
+static inline int int24(const unsigned char* p)
+{
+	// Shift into the top of an int32 and back down to sign extend
+	return ((int)(((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8))) >> 8;
+}
+
+static inline int int16(const unsigned char* p)
+{
+	return (short)(((unsigned short)p[0] << 8) | p[1]);
+}
+
+ofxOpenBciWifiRawDecoder::ofxOpenBciWifiRawDecoder(float gain)
+{
+	_carryLen = 0;
+	_errorCount = 0;
+	_accelScale = 0.002f / 16.f;
+	setGain(gain);
+}
+
+void ofxOpenBciWifiRawDecoder::setGain(float gain)
+{
+	// ADS1299 Vref = 4.5 V over a 24 bit range
+	_channelScale = (float)(4.5 / gain / (pow(2., 23.) - 1.) * 1000000.);
+}
+
+void ofxOpenBciWifiRawDecoder::reset()
+{
+	_carryLen = 0;
+}
+
+unsigned int ofxOpenBciWifiRawDecoder::getErrorCount()
+{
+	return _errorCount;
+}
+
+void ofxOpenBciWifiRawDecoder::decodePacket(const unsigned char* packet, ofxOpenBciWifiSample& sample)
+{
+	sample.timestamp = 0;
+	sample.sampleNumber = packet[1];
+	sample.count = 0;
+	sample.nChannels = PACKET_CHANNELS;
+
+	const unsigned char* p = packet + 2;
+	for (int ch = 0; ch < PACKET_CHANNELS; ch++, p += 3)
+	{
+		sample.data[ch] = int24(p) * _channelScale;
+	}
+	for (int ch = PACKET_CHANNELS; ch < OFX_OPENBCI_WIFI_MAX_CHANNELS; ch++)
+	{
+		sample.data[ch] = 0.f;
+	}
+
+	// Other footers carry board specific aux data, pass it through unscaled
+	float auxScale = (packet[32] == FOOTER_ACCEL) ? _accelScale : 1.f;
+	sample.nAux = OFX_OPENBCI_WIFI_AUX_CHANNELS;
+	for (int a = 0; a < OFX_OPENBCI_WIFI_AUX_CHANNELS; a++, p += 2)
+	{
+		sample.aux[a] = int16(p) * auxScale;
+	}
+}
+
+int ofxOpenBciWifiRawDecoder::parse(const char* bytes, size_t nBytes, vector<ofxOpenBciWifiSample>& samples)
+{
+	const unsigned char* in = (const unsigned char*)bytes;
+	const unsigned char* end = in + nBytes;
+	ofxOpenBciWifiSample sample;
+	int nNew = 0;
+
+	// Finish the packet left over from the last call
+	while (_carryLen > 0 && in < end)
+	{
+		int n = min((int)(end - in), OFX_OPENBCI_WIFI_RAW_PACKET_SIZE - _carryLen);
+		memcpy(_carry + _carryLen, in, n);
+		_carryLen += n;
+		in += n;
+		if (_carryLen < OFX_OPENBCI_WIFI_RAW_PACKET_SIZE)
+		{
+			return nNew;
+		}
+
+		if (isPacketStart(_carry))
+		{
+			decodePacket(_carry, sample);
+			samples.push_back(sample);
+			nNew++;
+			_carryLen = 0;
+		}
+		else
+		{
+			// Out of sync, slide to the next header inside the carry
+			int next = 1;
+			while (next < OFX_OPENBCI_WIFI_RAW_PACKET_SIZE && _carry[next] != PACKET_HEADER)
+			{
+				next++;
+			}
+			_errorCount += next;
+			memmove(_carry, _carry + next, OFX_OPENBCI_WIFI_RAW_PACKET_SIZE - next);
+			_carryLen = OFX_OPENBCI_WIFI_RAW_PACKET_SIZE - next;
+		}
+	}
+
+	// Decode whole packets straight out of the receive bytes
+	while (end - in >= OFX_OPENBCI_WIFI_RAW_PACKET_SIZE)
+	{
+		if (isPacketStart(in))
+		{
+			decodePacket(in, sample);
+			samples.push_back(sample);
+			nNew++;
+			in += OFX_OPENBCI_WIFI_RAW_PACKET_SIZE;
+		}
+		else
+		{
+			_errorCount++;
+			in++;
+		}
+	}
+
+	// Keep the tail for the next call
+	if (in < end && _carryLen == 0)
+	{
+		while (in < end && *in != PACKET_HEADER)
+		{
+			_errorCount++;
+			in++;
+		}
+		_carryLen = (int)(end - in);
+		memcpy(_carry, in, _carryLen);
+	}
+	return nNew;
+}
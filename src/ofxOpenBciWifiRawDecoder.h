@@ -0,0 +1,50 @@
+//
+//  ofxOpenBciWifiRawDecoder.h
+//
+//  Decoder for the raw 33 byte Cyton packets the OpenBci Wifi shield sends in raw output mode.
+//  Packet layout:
+//    0      0xA0 header
+//    1      sample number
+//    2-25   8 channels, 24 bit signed big endian
+//    26-31  3 aux values, 16 bit signed big endian (accelerometer when the footer is 0xC0)
+//    32     0xCX footer
+//  Raw packets carry no timestamp, so decoded samples have timestamp = 0.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+class ofxOpenBciWifiRawDecoder
+{
+private:
+	static const int PACKET_CHANNELS = 8;
+
+	unsigned char _carry[OFX_OPENBCI_WIFI_RAW_PACKET_SIZE];		// Partial packet left over from the previous call
+	int _carryLen;
+
+	float _channelScale;					// Microvolts per count
+	float _accelScale;						// G per count
+
+	unsigned int _errorCount;
+
+	void decodePacket(const unsigned char* packet, ofxOpenBciWifiSample& sample);
+
+public:
+	ofxOpenBciWifiRawDecoder(float gain = 24.f);
+
+	// Sets the ADS1299 channel gain used to scale counts to microvolts
+	void setGain(float gain);
+
+	// Decodes the next nBytes of the stream and appends each complete packet to samples.
+	// Returns the number of samples appended.
+	int parse(const char* bytes, size_t nBytes, vector<ofxOpenBciWifiSample>& samples);
+
+	// Drops any partial packet
+	void reset();
+
+	// Number of bytes skipped while searching for a valid packet
+	unsigned int getErrorCount();
+};
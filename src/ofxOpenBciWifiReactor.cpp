@@ -0,0 +1,274 @@
+//
+//  ofxOpenBciWifiReactor.cpp
+//
+//  Event driven TCP server for Linux built on epoll and non-blocking sockets.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiReactor.h"
+
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+
+ofxOpenBciWifiReactor::ofxOpenBciWifiReactor()
+{
+	_epollFd = -1;
+	_listenFd = -1;
+	_port = 0;
+	_readyFds.reserve(MAX_EVENTS);
+}
+
+ofxOpenBciWifiReactor::~ofxOpenBciWifiReactor()
+{
+	close();
+}
+
+bool ofxOpenBciWifiReactor::setup(int port)
+{
+	close();
+
+	_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (_epollFd < 0)
+	{
+		ofLogError("ofxOpenBciWifiReactor") << "epoll_create1 failed: " << strerror(errno);
+		return false;
+	}
+
+	_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	int reuse = 1;
+	setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (_listenFd < 0
+		|| ::bind(_listenFd, (sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(_listenFd, SOMAXCONN) < 0)
+	{
+		ofLogError("ofxOpenBciWifiReactor") << "Could not listen on port " << port << ": " << strerror(errno);
+		close();
+		return false;
+	}
+
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = _listenFd;
+	epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenFd, &ev);
+
+	_port = port;
+	return true;
+}
+
+void ofxOpenBciWifiReactor::close()
+{
+	for (int fd = 0; fd < _fdHeadsets.size(); fd++)
+	{
+		if (_fdHeadsets.at(fd) >= 0)
+		{
+			closeConnection(fd, NULL);
+		}
+	}
+	if (_listenFd >= 0)
+	{
+		::close(_listenFd);
+		_listenFd = -1;
+	}
+	if (_epollFd >= 0)
+	{
+		::close(_epollFd);
+		_epollFd = -1;
+	}
+	_readyFds.clear();
+	_pausedFds.clear();
+}
+
+bool ofxOpenBciWifiReactor::isSetup()
+{
+	return _epollFd >= 0;
+}
+
+int ofxOpenBciWifiReactor::getPort()
+{
+	return _port;
+}
+
+int ofxOpenBciWifiReactor::getConnectionCount()
+{
+	int n = 0;
+	for (int fd = 0; fd < _fdHeadsets.size(); fd++)
+	{
+		if (_fdHeadsets.at(fd) >= 0) n++;
+	}
+	return n;
+}
+
+int ofxOpenBciWifiReactor::wait(int timeoutMs)
+{
+	_readyFds.clear();
+	if (_epollFd < 0)
+	{
+		return 0;
+	}
+
+	epoll_event events[MAX_EVENTS];
+	int n = epoll_wait(_epollFd, events, MAX_EVENTS, timeoutMs);
+	for (int i = 0; i < n; i++)
+	{
+		_readyFds.push_back(events[i].data.fd);
+	}
+	return max(n, 0);
+}
+
+void ofxOpenBciWifiReactor::dispatch(ofxOpenBciWifiConnectionListener& listener)
+{
+	// Resume the sockets that were paused for backpressure once the listener has room again
+	for (int i = 0; i < _pausedFds.size(); )
+	{
+		int fd = _pausedFds.at(i);
+		size_t space;
+		if (_fdHeadsets.at(fd) >= 0 && listener.getReceiveBuffer(_fdHeadsets.at(fd), space) == NULL)
+		{
+			i++;
+			continue;
+		}
+		_pausedFds.at(i) = _pausedFds.back();
+		_pausedFds.pop_back();
+		_fdPaused.at(fd) = false;
+		if (_fdHeadsets.at(fd) >= 0)
+		{
+			setPaused(fd, false);
+			readConnection(fd, listener);
+		}
+	}
+
+	for (int i = 0; i < _readyFds.size(); i++)
+	{
+		int fd = _readyFds.at(i);
+		if (fd == _listenFd)
+		{
+			acceptConnections(listener);
+		}
+		else if (fd < _fdHeadsets.size() && _fdHeadsets.at(fd) >= 0 && !_fdPaused.at(fd))
+		{
+			readConnection(fd, listener);
+		}
+	}
+	_readyFds.clear();
+}
+
+void ofxOpenBciWifiReactor::acceptConnections(ofxOpenBciWifiConnectionListener& listener)
+{
+	while (true)
+	{
+		sockaddr_in addr;
+		socklen_t addrLen = sizeof(addr);
+		int fd = accept4(_listenFd, (sockaddr*)&addr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			return;		// EAGAIN, no more pending connections
+		}
+
+		char ip[INET_ADDRSTRLEN];
+		inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+		int h = listener.onConnect(ip, 0);
+		if (h < 0)
+		{
+			::close(fd);
+			continue;
+		}
+
+		if (fd >= _fdHeadsets.size())
+		{
+			_fdHeadsets.resize(fd + 1, -1);
+			_fdPaused.resize(fd + 1, false);
+		}
+		_fdHeadsets.at(fd) = h;
+		_fdPaused.at(fd) = false;
+
+		epoll_event ev;
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.fd = fd;
+		epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+void ofxOpenBciWifiReactor::readConnection(int fd, ofxOpenBciWifiConnectionListener& listener)
+{
+	int h = _fdHeadsets.at(fd);
+	while (true)
+	{
+		size_t space;
+		char* buffer = listener.getReceiveBuffer(h, space);
+		if (buffer == NULL || space == 0)
+		{
+			// Stop polling the socket so the kernel buffer fills and TCP pauses the sender
+			setPaused(fd, true);
+			return;
+		}
+
+		ssize_t n = recv(fd, buffer, space, 0);
+		if (n > 0)
+		{
+			listener.onReceive(h, n);
+			if (n < space)
+			{
+				return;		// Drained, epoll reports the socket again when more arrives
+			}
+		}
+		else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+		{
+			closeConnection(fd, &listener);
+			return;
+		}
+		else if (errno != EINTR)
+		{
+			return;		// Drained
+		}
+	}
+}
+
+void ofxOpenBciWifiReactor::setPaused(int fd, bool paused)
+{
+	if (paused)
+	{
+		// Out of the epoll set, as a level triggered hangup or error would wake every wait() until
+		// the listener has room. The hangup is read once the socket is resumed and drained.
+		epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+		if (!_fdPaused.at(fd))
+		{
+			_fdPaused.at(fd) = true;
+			_pausedFds.push_back(fd);
+		}
+	}
+	else
+	{
+		epoll_event ev;
+		ev.events = EPOLLIN | EPOLLRDHUP;
+		ev.data.fd = fd;
+		epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+void ofxOpenBciWifiReactor::closeConnection(int fd, ofxOpenBciWifiConnectionListener* listener)
+{
+	int h = _fdHeadsets.at(fd);
+	_fdHeadsets.at(fd) = -1;
+	_fdPaused.at(fd) = false;
+	epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+	::close(fd);
+	if (listener != NULL)
+	{
+		listener->onDisconnect(h);
+	}
+}
+
+#endif
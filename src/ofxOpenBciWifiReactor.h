@@ -0,0 +1,55 @@
+//
+//  ofxOpenBciWifiReactor.h
+//
+//  Event driven TCP server for Linux built on epoll and non-blocking sockets.
+//  Wakes only when a shield connects or sends data, reads straight into buffers
+//  supplied by the listener and maps sockets to headsets in O(1).
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiSource.h"
+
+#if defined(TARGET_LINUX) && !defined(OFX_OPENBCI_WIFI_NO_EPOLL)
+#define OFX_OPENBCI_WIFI_USE_EPOLL
+#endif
+
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+
+class ofxOpenBciWifiReactor
+{
+private:
+	static const int MAX_EVENTS = 64;
+
+	int _epollFd;
+	int _listenFd;
+	int _port;
+	vector<int> _fdHeadsets;			// Headset number indexed by socket, -1 when unused
+	vector<int> _readyFds;				// Sockets reported by the last wait()
+	vector<int> _pausedFds;				// Sockets whose listener had no room, retried on every dispatch()
+	vector<bool> _fdPaused;				// Indexed by socket, true while in _pausedFds
+
+	void acceptConnections(ofxOpenBciWifiConnectionListener& listener);
+	void readConnection(int fd, ofxOpenBciWifiConnectionListener& listener);
+	void closeConnection(int fd, ofxOpenBciWifiConnectionListener* listener);
+	void setPaused(int fd, bool paused);
+
+public:
+	ofxOpenBciWifiReactor();
+	~ofxOpenBciWifiReactor();
+
+	bool setup(int port);
+	void close();
+	bool isSetup();
+	int getPort();
+	int getConnectionCount();
+
+	// Blocks until a socket is ready or timeoutMs passes. Returns the number of ready sockets.
+	int wait(int timeoutMs);
+	// Accepts new connections and drains every socket reported by the last wait() into the listener
+	void dispatch(ofxOpenBciWifiConnectionListener& listener);
+};
+
+#endif
@@ -0,0 +1,495 @@
+//
+//  ofxOpenBciWifiRecording.cpp
+//
+//  Binary recordings of the filtered samples.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiRecording.h"
+#include "ofxOpenBciWifiRecordingCodec.h"
+
+#define RECORDING_MAX_PENDING (64 * 1024 * 1024)	// Bytes queued before blocks are dropped
+#define RECORDING_WRITE_INTERVAL 100				// Milliseconds between batched writes
+
+static size_t padRecord(size_t nBytes)
+{
+	return (nBytes + 7) & ~(size_t)7;
+}
+
+ofxOpenBciWifiRecordingWriter::ofxOpenBciWifiRecordingWriter()
+{
+	_file = NULL;
+	_maxPending = RECORDING_MAX_PENDING;
+	_bytesWritten = 0;
+	_droppedBytes = 0;
+	_blockingEnabled = false;
+	_compressionEnabled = false;
+	_maxBlockSamples = 256;
+}
+
+ofxOpenBciWifiRecordingWriter::~ofxOpenBciWifiRecordingWriter()
+{
+	close();
+}
+
+bool ofxOpenBciWifiRecordingWriter::open(string filePath)
+{
+	close();
+	_file = fopen(ofToDataPath(filePath).c_str(), "wb");
+	if (_file == NULL)
+	{
+		ofLogError("ofxOpenBciWifiRecordingWriter") << "Could not open " << filePath;
+		return false;
+	}
+	fwrite(OFX_OPENBCI_WIFI_RECORDING_MAGIC, 1, OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN, _file);
+	_bytesWritten = OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN;
+	_droppedBytes = 0;
+	_pending.clear();
+	_pending.reserve(1024 * 1024);
+	_staged.clear();
+	startThread();
+	return true;
+}
+
+void ofxOpenBciWifiRecordingWriter::close()
+{
+	if (isThreadRunning())
+	{
+		waitForThread(true);
+	}
+	if (_file != NULL)
+	{
+		writePending();
+		if (_compressionEnabled)
+		{
+			for (int h = 0; h < _staged.size(); h++)
+			{
+				flushStaged(h);
+			}
+			fwrite(_encoded.data(), 1, _encoded.size(), _file);
+			_bytesWritten += _encoded.size();
+			_encoded.clear();
+		}
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+bool ofxOpenBciWifiRecordingWriter::isOpen()
+{
+	return _file != NULL;
+}
+
+void ofxOpenBciWifiRecordingWriter::enableCompression()
+{
+	_compressionEnabled = true;
+}
+
+void ofxOpenBciWifiRecordingWriter::disableCompression()
+{
+	_compressionEnabled = false;
+}
+
+void ofxOpenBciWifiRecordingWriter::enableBlocking()
+{
+	_blockingEnabled = true;
+}
+
+void ofxOpenBciWifiRecordingWriter::disableBlocking()
+{
+	_blockingEnabled = false;
+}
+
+void ofxOpenBciWifiRecordingWriter::setMaxBlockSamples(int nSamples)
+{
+	_maxBlockSamples = max(nSamples, 1);
+}
+
+int ofxOpenBciWifiRecordingWriter::getMaxBlockSamples()
+{
+	return _maxBlockSamples;
+}
+
+char* ofxOpenBciWifiRecordingWriter::appendRecord(ofxOpenBciWifiRecordingRecordType type, int headset, size_t nBytes)
+{
+	// Called with lock() held
+	size_t padded = padRecord(nBytes);
+	while (_blockingEnabled && !_pending.empty() && isThreadRunning()
+		&& _pending.size() + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + padded > _maxPending)
+	{
+		// Let the writer thread take the pending records
+		unlock();
+		sleep(1);
+		lock();
+	}
+	if (_pending.size() + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + padded > _maxPending)
+	{
+		_droppedBytes += OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + padded;
+		return NULL;
+	}
+	size_t pos = _pending.size();
+	_pending.resize(pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + padded, '\0');
+	uint32_t header[4] = { (uint32_t)type, (uint32_t)headset, (uint32_t)padded, 0 };
+	memcpy(&_pending[pos], header, sizeof(header));
+	return &_pending[pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER];
+}
+
+void ofxOpenBciWifiRecordingWriter::writeConfig(int headset, const ofxOpenBciWifiRecordingConfig& config)
+{
+	lock();
+	char* payload = appendRecord(OFX_OPENBCI_WIFI_RECORDING_CONFIG, headset, sizeof(config));
+	if (payload != NULL)
+	{
+		memcpy(payload, &config, sizeof(config));
+	}
+	unlock();
+}
+
+void ofxOpenBciWifiRecordingWriter::writeBlock(int headset, const ofxOpenBciWifiSample* samples, const float* frames, int nSamples, int nChannels, int frameStride)
+{
+	size_t nBytes = OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER
+		+ nSamples * (sizeof(double) + 2 * sizeof(int32_t) + nChannels * sizeof(float));
+	lock();
+	char* payload = appendRecord(OFX_OPENBCI_WIFI_RECORDING_BLOCK, headset, nBytes);
+	if (payload != NULL)
+	{
+		uint32_t header[2] = { (uint32_t)nSamples, (uint32_t)nChannels };
+		memcpy(payload, header, sizeof(header));
+		double* timestamps = (double*)(payload + OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER);
+		int32_t* sampleNumbers = (int32_t*)(timestamps + nSamples);
+		int32_t* counts = sampleNumbers + nSamples;
+		float* data = (float*)(counts + nSamples);
+		for (int s = 0; s < nSamples; s++)
+		{
+			timestamps[s] = samples[s].timestamp;
+			sampleNumbers[s] = samples[s].sampleNumber;
+			counts[s] = samples[s].count;
+			memcpy(data + s * nChannels, frames + s * frameStride, nChannels * sizeof(float));
+		}
+	}
+	unlock();
+}
+
+uint64_t ofxOpenBciWifiRecordingWriter::getBytesWritten()
+{
+	lock();
+	uint64_t n = _bytesWritten;
+	unlock();
+	return n;
+}
+
+uint64_t ofxOpenBciWifiRecordingWriter::getDroppedBytes()
+{
+	lock();
+	uint64_t n = _droppedBytes;
+	unlock();
+	return n;
+}
+
+void ofxOpenBciWifiRecordingWriter::writePending()
+{
+	// Swap so the processing thread never waits on the disk
+	lock();
+	swap(_pending, _writing);
+	unlock();
+	if (_writing.empty())
+	{
+		return;
+	}
+	const string* out = &_writing;
+	if (_compressionEnabled)
+	{
+		compressRecords();
+		out = &_encoded;
+	}
+	fwrite(out->data(), 1, out->size(), _file);
+	lock();
+	_bytesWritten += out->size();
+	unlock();
+	_writing.clear();
+	_encoded.clear();
+}
+
+void ofxOpenBciWifiRecordingWriter::compressRecords()
+{
+	// On the writer thread, the processing thread only ever copies raw blocks
+	size_t pos = 0;
+	while (pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER <= _writing.size())
+	{
+		uint32_t header[4];
+		memcpy(header, &_writing[pos], sizeof(header));
+		const char* payload = &_writing[pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER];
+		if (header[0] == OFX_OPENBCI_WIFI_RECORDING_BLOCK)
+		{
+			stageBlock(header[1], payload);
+		}
+		else
+		{
+			// Blocks before a config change belong to the old config
+			flushStaged(header[1]);
+			_encoded.append(&_writing[pos], OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + header[2]);
+		}
+		pos += OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + header[2];
+	}
+}
+
+void ofxOpenBciWifiRecordingWriter::stageBlock(int headset, const char* payload)
+{
+	uint32_t sizes[2];
+	memcpy(sizes, payload, sizeof(sizes));
+	int nSamples = sizes[0];
+	int nChannels = sizes[1];
+	if (headset >= _staged.size())
+	{
+		_staged.resize(headset + 1);
+		_staged.at(headset).headset = headset;
+		_staged.at(headset).nSamples = 0;
+		_staged.at(headset).nChannels = nChannels;
+	}
+	ofxOpenBciWifiRecordingBlock& block = _staged.at(headset);
+	if (block.nChannels != nChannels)
+	{
+		flushStaged(headset);
+		block.nChannels = nChannels;
+	}
+
+	const double* timestamps = (const double*)(payload + OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER);
+	const int32_t* sampleNumbers = (const int32_t*)(timestamps + nSamples);
+	const int32_t* counts = sampleNumbers + nSamples;
+	const float* data = (const float*)(counts + nSamples);
+	for (int s = 0; s < nSamples; s++)
+	{
+		block.timestamps.push_back(timestamps[s]);
+		block.sampleNumbers.push_back(sampleNumbers[s]);
+		block.counts.push_back(counts[s]);
+		block.data.insert(block.data.end(), data + s * nChannels, data + (s + 1) * nChannels);
+		block.nSamples++;
+		if (block.nSamples >= _maxBlockSamples)
+		{
+			flushStaged(headset);
+		}
+	}
+}
+
+void ofxOpenBciWifiRecordingWriter::flushStaged(int headset)
+{
+	if (headset >= _staged.size() || _staged.at(headset).nSamples == 0)
+	{
+		return;
+	}
+	ofxOpenBciWifiRecordingBlock& block = _staged.at(headset);
+	size_t rawBytes = OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER
+		+ block.nSamples * (sizeof(double) + 2 * sizeof(int32_t) + block.nChannels * sizeof(float));
+
+	size_t pos = _encoded.size();
+	_encoded.resize(pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER);
+	ofxOpenBciWifiRecordingCodec::encode(block, _encoded);
+	size_t nBytes = _encoded.size() - pos - OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER;
+	uint32_t type = OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK;
+	if (nBytes >= rawBytes)
+	{
+		// Noise doesn't compress, store it as it came
+		type = OFX_OPENBCI_WIFI_RECORDING_BLOCK;
+		nBytes = rawBytes;
+		_encoded.resize(pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + rawBytes);
+		char* payload = &_encoded[pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER];
+		uint32_t sizes[2] = { (uint32_t)block.nSamples, (uint32_t)block.nChannels };
+		memcpy(payload, sizes, sizeof(sizes));
+		payload += OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER;
+		memcpy(payload, &block.timestamps[0], block.nSamples * sizeof(double));
+		payload += block.nSamples * sizeof(double);
+		memcpy(payload, &block.sampleNumbers[0], block.nSamples * sizeof(int32_t));
+		payload += block.nSamples * sizeof(int32_t);
+		memcpy(payload, &block.counts[0], block.nSamples * sizeof(int32_t));
+		payload += block.nSamples * sizeof(int32_t);
+		if (!block.data.empty())
+		{
+			memcpy(payload, &block.data[0], block.data.size() * sizeof(float));
+		}
+	}
+	size_t padded = padRecord(nBytes);
+	_encoded.resize(pos + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + padded, '\0');
+	uint32_t header[4] = { type, (uint32_t)headset, (uint32_t)padded, 0 };
+	memcpy(&_encoded[pos], header, sizeof(header));
+
+	block.nSamples = 0;
+	block.timestamps.clear();
+	block.sampleNumbers.clear();
+	block.counts.clear();
+	block.data.clear();
+}
+
+void ofxOpenBciWifiRecordingWriter::threadedFunction()
+{
+	while (isThreadRunning())
+	{
+		writePending();
+		sleep(RECORDING_WRITE_INTERVAL);
+	}
+}
+
+ofxOpenBciWifiRecordingReader::ofxOpenBciWifiRecordingReader()
+{
+	_file = NULL;
+}
+
+ofxOpenBciWifiRecordingReader::~ofxOpenBciWifiRecordingReader()
+{
+	close();
+}
+
+bool ofxOpenBciWifiRecordingReader::open(string filePath)
+{
+	close();
+	_file = fopen(ofToDataPath(filePath).c_str(), "rb");
+	char magic[OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN];
+	if (_file == NULL || fread(magic, 1, sizeof(magic), _file) != sizeof(magic)
+		|| memcmp(magic, OFX_OPENBCI_WIFI_RECORDING_MAGIC, sizeof(magic)) != 0)
+	{
+		ofLogError("ofxOpenBciWifiRecordingReader") << filePath << " is not a recording";
+		close();
+		return false;
+	}
+	_configs.clear();
+	return true;
+}
+
+void ofxOpenBciWifiRecordingReader::close()
+{
+	if (_file != NULL)
+	{
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+bool ofxOpenBciWifiRecordingReader::readBlock(ofxOpenBciWifiRecordingBlock& block)
+{
+	uint32_t header[4];
+	while (_file != NULL && fread(header, 1, sizeof(header), _file) == sizeof(header))
+	{
+		_payload.resize(header[2]);
+		if (header[2] > 0 && fread(&_payload[0], 1, header[2], _file) != header[2])
+		{
+			// The recording was cut off mid record
+			return false;
+		}
+		int headset = header[1];
+		if (header[0] == OFX_OPENBCI_WIFI_RECORDING_CONFIG && header[2] >= sizeof(ofxOpenBciWifiRecordingConfig))
+		{
+			if (headset >= _configs.size())
+			{
+				_configs.resize(headset + 1);
+			}
+			memcpy(&_configs.at(headset), &_payload[0], sizeof(ofxOpenBciWifiRecordingConfig));
+			_configs.at(headset).ipAddress[sizeof(_configs.at(headset).ipAddress) - 1] = '\0';
+		}
+		else if (header[0] == OFX_OPENBCI_WIFI_RECORDING_BLOCK || header[0] == OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK)
+		{
+			if (!decodeBlock((ofxOpenBciWifiRecordingRecordType)header[0], &_payload[0], header[2], block))
+			{
+				ofLogWarning("ofxOpenBciWifiRecordingReader") << "Skipping a corrupt block";
+				continue;
+			}
+			block.headset = headset;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ofxOpenBciWifiRecordingReader::decodeBlock(ofxOpenBciWifiRecordingRecordType type, const char* payload, size_t nBytes, ofxOpenBciWifiRecordingBlock& block)
+{
+	if (type == OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK)
+	{
+		return ofxOpenBciWifiRecordingCodec::decode(payload, nBytes, block);
+	}
+	if (nBytes < OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER)
+	{
+		return false;
+	}
+	uint32_t sizes[2];
+	memcpy(sizes, payload, sizeof(sizes));
+	size_t nSamples = sizes[0];
+	size_t nChannels = sizes[1];
+	if (OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER + nSamples * (sizeof(double) + 2 * sizeof(int32_t) + nChannels * sizeof(float)) > nBytes)
+	{
+		return false;
+	}
+	block.nSamples = nSamples;
+	block.nChannels = nChannels;
+	block.timestamps.resize(nSamples);
+	block.sampleNumbers.resize(nSamples);
+	block.counts.resize(nSamples);
+	block.data.resize(nSamples * nChannels);
+	const char* pos = payload + OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER;
+	if (nSamples > 0)
+	{
+		memcpy(&block.timestamps[0], pos, nSamples * sizeof(double));
+		pos += nSamples * sizeof(double);
+		memcpy(&block.sampleNumbers[0], pos, nSamples * sizeof(int32_t));
+		pos += nSamples * sizeof(int32_t);
+		memcpy(&block.counts[0], pos, nSamples * sizeof(int32_t));
+		pos += nSamples * sizeof(int32_t);
+	}
+	if (!block.data.empty())
+	{
+		memcpy(&block.data[0], pos, block.data.size() * sizeof(float));
+	}
+	return true;
+}
+
+int ofxOpenBciWifiRecordingReader::getHeadsetCount()
+{
+	return _configs.size();
+}
+
+ofxOpenBciWifiRecordingConfig ofxOpenBciWifiRecordingReader::getConfig(int headset)
+{
+	if (headset < 0 || headset >= _configs.size())
+	{
+		ofxOpenBciWifiRecordingConfig config;
+		memset(&config, 0, sizeof(config));
+		return config;
+	}
+	return _configs.at(headset);
+}
+
+bool ofxOpenBciWifiRecordingReader::convertToCsv(string recordingPath, string csvPath)
+{
+	ofxOpenBciWifiRecordingReader reader;
+	if (!reader.open(recordingPath))
+	{
+		return false;
+	}
+	ofstream csv(ofToDataPath(csvPath).c_str(), ios::binary);
+	if (!csv.is_open())
+	{
+		ofLogError("ofxOpenBciWifiRecordingReader") << "Could not open " << csvPath;
+		return false;
+	}
+
+	// Same text as the per-value logging this format replaced
+	csv << "ip,timestamps,sample_numbers,count,data0,...,dataN\n";
+	ofxOpenBciWifiRecordingBlock block;
+	string line;
+	while (reader.readBlock(block))
+	{
+		string ip = reader.getConfig(block.headset).ipAddress;
+		for (int s = 0; s < block.nSamples; s++)
+		{
+			line = ip + ",";
+			line += ofToString(block.timestamps.at(s), 0) + ",";
+			line += ofToString(block.sampleNumbers.at(s)) + ",";
+			line += ofToString(block.counts.at(s)) + ",";
+			for (int ch = 0; ch < block.nChannels; ch++)
+			{
+				line += ofToString(block.data.at(s * block.nChannels + ch)) + ",";
+			}
+			line += "\n";
+			csv << line;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,133 @@
+//
+//  ofxOpenBciWifiRecording.h
+//
+//  Binary recordings of the filtered samples, written by ofxOpenBciWifi::enableDataLogging().
+//  The processing thread copies each block of samples into memory once and a background thread
+//  writes them to disk in large batches. convertToCsv() turns a recording back into the
+//  ip,timestamps,sample_numbers,count,data0,...,dataN text layout of the old logs.
+//  File layout, native byte order:
+//    "OBWREC01"
+//    records of uint32 type, uint32 headset, uint32 nBytes, uint32 reserved, followed by
+//    nBytes of payload padded to a multiple of 8 bytes
+//  CONFIG payload: ofxOpenBciWifiRecordingConfig, written before a headset's first block and
+//  whenever its channels or filters change.
+//  BLOCK payload: uint32 nSamples, uint32 nChannels, then double timestamps[nSamples],
+//  int32 sampleNumbers[nSamples], int32 counts[nSamples], float data[nSamples][nChannels]
+//  COMPRESSED_BLOCK payload: the same samples coded by ofxOpenBciWifiRecordingCodec. With
+//  compression on the writer thread gathers up to getMaxBlockSamples() samples per headset
+//  into each block, so the work per block is bounded.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+#define OFX_OPENBCI_WIFI_RECORDING_MAGIC "OBWREC01"
+#define OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN 8
+#define OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER 16
+#define OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER 8
+
+enum ofxOpenBciWifiRecordingRecordType
+{
+	OFX_OPENBCI_WIFI_RECORDING_CONFIG,
+	OFX_OPENBCI_WIFI_RECORDING_BLOCK,
+	OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK
+};
+
+struct ofxOpenBciWifiRecordingConfig
+{
+	float Fs;
+	int32_t nChannels;
+	int32_t dataFormat;					// ofxOpenBciWifiDataFormat the shield streamed
+	uint8_t hpFiltEnabled;
+	uint8_t notchFiltEnabled;
+	uint8_t lpFiltEnabled;
+	uint8_t montageEnabled;				// nChannels are the montage's outputs
+	float hpFiltFreq;
+	float notchFiltFreq;
+	float lpFiltFreq;
+	char ipAddress[52];					// Null terminated
+};
+
+// One block of samples read back from a recording
+struct ofxOpenBciWifiRecordingBlock
+{
+	int headset;
+	int nSamples;
+	int nChannels;
+	vector<double> timestamps;
+	vector<int32_t> sampleNumbers;
+	vector<int32_t> counts;
+	vector<float> data;					// nSamples x nChannels
+};
+
+class ofxOpenBciWifiRecordingWriter : public ofThread
+{
+private:
+	FILE* _file;
+	string _pending;					// Records waiting for the writer thread, guarded by lock()
+	string _writing;					// Records being written
+	size_t _maxPending;
+	uint64_t _bytesWritten;
+	uint64_t _droppedBytes;
+
+	bool _blockingEnabled;
+	bool _compressionEnabled;
+	int _maxBlockSamples;
+	vector<ofxOpenBciWifiRecordingBlock> _staged;	// Samples gathered per headset for the next compressed block
+	string _encoded;								// Compressed records ready for the file
+
+	void threadedFunction();
+	char* appendRecord(ofxOpenBciWifiRecordingRecordType type, int headset, size_t nBytes);
+	void writePending();
+	void compressRecords();
+	void stageBlock(int headset, const char* payload);
+	void flushStaged(int headset);
+
+public:
+	ofxOpenBciWifiRecordingWriter();
+	~ofxOpenBciWifiRecordingWriter();
+
+	bool open(string filePath);
+	void close();						// Writes what is still pending
+	bool isOpen();
+	void enableCompression();			// Before open()
+	void disableCompression();
+	void setMaxBlockSamples(int nSamples);	// Default = 256
+	void enableBlocking();				// Waits for the disk instead of dropping blocks, for offline writers
+	void disableBlocking();
+	int getMaxBlockSamples();
+
+	void writeConfig(int headset, const ofxOpenBciWifiRecordingConfig& config);
+	// frames holds nSamples frames of frameStride floats, the first nChannels are recorded
+	void writeBlock(int headset, const ofxOpenBciWifiSample* samples, const float* frames, int nSamples, int nChannels, int frameStride);
+
+	uint64_t getBytesWritten();
+	uint64_t getDroppedBytes();			// Blocks thrown away because the disk could not keep up
+};
+
+class ofxOpenBciWifiRecordingReader
+{
+private:
+	FILE* _file;
+	vector<char> _payload;
+	vector<ofxOpenBciWifiRecordingConfig> _configs;
+
+public:
+	ofxOpenBciWifiRecordingReader();
+	~ofxOpenBciWifiRecordingReader();
+
+	bool open(string filePath);
+	void close();
+
+	// Reads the next block, taking in the configs on the way. Returns false at the end of the file.
+	bool readBlock(ofxOpenBciWifiRecordingBlock& block);
+	int getHeadsetCount();
+	ofxOpenBciWifiRecordingConfig getConfig(int headset);	// Of the block read last
+
+	static bool convertToCsv(string recordingPath, string csvPath);
+	// Decodes the payload of a BLOCK or COMPRESSED_BLOCK record
+	static bool decodeBlock(ofxOpenBciWifiRecordingRecordType type, const char* payload, size_t nBytes, ofxOpenBciWifiRecordingBlock& block);
+};
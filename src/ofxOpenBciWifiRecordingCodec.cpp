@@ -0,0 +1,390 @@
+//
+//  ofxOpenBciWifiRecordingCodec.cpp
+//
+//  Lossless compression of recording blocks.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiRecordingCodec.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define CODEC_MAX_ORDER 2
+#define CODEC_ESCAPE 32					// Unary length that marks a residual stored in 64 bits
+#define CODEC_MAX_CHANNELS 1024
+
+namespace
+{
+	// ** Value mappings, the integers keep the ordering of the floats **
+	uint64_t fromFloat(float value)
+	{
+		uint32_t u;
+		memcpy(&u, &value, sizeof(u));
+		return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+	}
+
+	float toFloat(uint64_t value)
+	{
+		uint32_t m = (uint32_t)value;
+		uint32_t u = (m & 0x80000000u) ? (m ^ 0x80000000u) : ~m;
+		float f;
+		memcpy(&f, &u, sizeof(f));
+		return f;
+	}
+
+	uint64_t fromDouble(double value)
+	{
+		uint64_t u;
+		memcpy(&u, &value, sizeof(u));
+		return (u >> 63) ? ~u : (u | (1ull << 63));
+	}
+
+	double toDouble(uint64_t m)
+	{
+		uint64_t u = (m >> 63) ? (m ^ (1ull << 63)) : ~m;
+		double d;
+		memcpy(&d, &u, sizeof(d));
+		return d;
+	}
+
+	int countTrailingOnes(uint64_t x)
+	{
+		if (~x == 0)
+		{
+			return 64;
+		}
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, ~x);
+		return (int)index;
+#else
+		return __builtin_ctzll(~x);
+#endif
+	}
+
+	class BitWriter
+	{
+	private:
+		string& _out;
+		uint64_t _bits;
+		int _nBits;
+
+	public:
+		BitWriter(string& out) : _out(out), _bits(0), _nBits(0) {}
+
+		// n <= 32
+		void write(uint64_t value, int n)
+		{
+			_bits |= (value & ((1ull << n) - 1)) << _nBits;
+			_nBits += n;
+			while (_nBits >= 8)
+			{
+				_out.push_back((char)(_bits & 0xFF));
+				_bits >>= 8;
+				_nBits -= 8;
+			}
+		}
+
+		void writeLong(uint64_t value, int n)
+		{
+			if (n > 32)
+			{
+				write(value, 32);
+				write(value >> 32, n - 32);
+			}
+			else
+			{
+				write(value, n);
+			}
+		}
+
+		void flush()
+		{
+			if (_nBits > 0)
+			{
+				_out.push_back((char)(_bits & 0xFF));
+				_bits = 0;
+				_nBits = 0;
+			}
+		}
+	};
+
+	class BitReader
+	{
+	private:
+		const unsigned char* _pos;
+		const unsigned char* _end;
+		uint64_t _bits;
+		int _nBits;
+
+		void refill()
+		{
+			while (_nBits <= 56 && _pos < _end)
+			{
+				_bits |= (uint64_t)*_pos++ << _nBits;
+				_nBits += 8;
+			}
+		}
+
+	public:
+		bool failed;
+
+		BitReader(const char* pos, const char* end) :
+			_pos((const unsigned char*)pos), _end((const unsigned char*)end), _bits(0), _nBits(0), failed(false) {}
+
+		// n <= 32
+		uint64_t read(int n)
+		{
+			refill();
+			if (_nBits < n)
+			{
+				failed = true;
+				return 0;
+			}
+			uint64_t value = _bits & ((1ull << n) - 1);
+			_bits >>= n;
+			_nBits -= n;
+			return value;
+		}
+
+		uint64_t readLong(int n)
+		{
+			if (n > 32)
+			{
+				uint64_t low = read(32);
+				return low | (read(n - 32) << 32);
+			}
+			return read(n);
+		}
+
+		// Number of ones before the next zero, CODEC_ESCAPE for an escaped residual
+		int readUnary()
+		{
+			refill();
+			int ones = min(countTrailingOnes(_bits), CODEC_ESCAPE);
+			if (ones == CODEC_ESCAPE && _nBits >= CODEC_ESCAPE)
+			{
+				_bits >>= CODEC_ESCAPE;
+				_nBits -= CODEC_ESCAPE;
+				return ones;
+			}
+			if (ones >= _nBits)
+			{
+				failed = true;
+				return 0;
+			}
+			_bits >>= ones + 1;
+			_nBits -= ones + 1;
+			return ones;
+		}
+	};
+
+	uint64_t predict(const uint64_t* x, int i, int order)
+	{
+		// Wrapping arithmetic, the decoder undoes it exactly
+		order = min(order, i);
+		switch (order)
+		{
+		case 0: return 0;
+		case 1: return x[i - 1];
+		default: return 2 * x[i - 1] - x[i - 2];
+		}
+	}
+
+	uint64_t zigzag(uint64_t residual)
+	{
+		return (residual << 1) ^ (uint64_t)((int64_t)residual >> 63);
+	}
+
+	uint64_t unzigzag(uint64_t value)
+	{
+		return (value >> 1) ^ (0 - (value & 1));
+	}
+
+	void encodeColumn(const vector<uint64_t>& x, BitWriter& writer)
+	{
+		int n = x.size();
+
+		// Pick the predictor with the smallest residuals
+		int order = 0;
+		double bestSum = -1;
+		for (int o = 0; o <= CODEC_MAX_ORDER; o++)
+		{
+			double sum = 0;
+			for (int i = 0; i < n; i++)
+			{
+				sum += (double)zigzag(x[i] - predict(&x[0], i, o));
+			}
+			if (bestSum < 0 || sum < bestSum)
+			{
+				bestSum = sum;
+				order = o;
+			}
+		}
+
+		// Rice parameter from the mean residual
+		double mean = n > 0 ? bestSum / n : 0;
+		int k = 0;
+		while (k < 63 && (double)(1ull << (k + 1)) <= mean)
+		{
+			k++;
+		}
+
+		writer.write(order, 2);
+		writer.write(k, 6);
+		for (int i = 0; i < n; i++)
+		{
+			uint64_t value = zigzag(x[i] - predict(&x[0], i, order));
+			uint64_t q = value >> k;
+			if (q < CODEC_ESCAPE)
+			{
+				writer.write((1ull << q) - 1, (int)q + 1);
+				writer.writeLong(value, k);
+			}
+			else
+			{
+				writer.write(0xFFFFFFFFull, CODEC_ESCAPE);
+				writer.writeLong(value, 64);
+			}
+		}
+	}
+
+	bool decodeColumn(BitReader& reader, vector<uint64_t>& x, int n)
+	{
+		x.resize(n);
+		int order = (int)reader.read(2);
+		int k = (int)reader.read(6);
+		if (order > CODEC_MAX_ORDER)
+		{
+			return false;
+		}
+		for (int i = 0; i < n && !reader.failed; i++)
+		{
+			int q = reader.readUnary();
+			uint64_t value = (q == CODEC_ESCAPE) ? reader.readLong(64) : (((uint64_t)q << k) | reader.readLong(k));
+			x[i] = unzigzag(value) + predict(&x[0], i, order);
+		}
+		return !reader.failed;
+	}
+}
+
+void ofxOpenBciWifiRecordingCodec::encode(const ofxOpenBciWifiRecordingBlock& block, string& out)
+{
+	uint32_t sizes[2] = { (uint32_t)block.nSamples, (uint32_t)block.nChannels };
+	out.append((const char*)sizes, sizeof(sizes));
+
+	BitWriter writer(out);
+	vector<uint64_t> column(block.nSamples);
+	for (int s = 0; s < block.nSamples; s++)
+	{
+		column[s] = fromDouble(block.timestamps[s]);
+	}
+	encodeColumn(column, writer);
+	for (int s = 0; s < block.nSamples; s++)
+	{
+		column[s] = (uint64_t)(int64_t)block.sampleNumbers[s];
+	}
+	encodeColumn(column, writer);
+	for (int s = 0; s < block.nSamples; s++)
+	{
+		column[s] = (uint64_t)(int64_t)block.counts[s];
+	}
+	encodeColumn(column, writer);
+	for (int ch = 0; ch < block.nChannels; ch++)
+	{
+		for (int s = 0; s < block.nSamples; s++)
+		{
+			column[s] = fromFloat(block.data[s * block.nChannels + ch]);
+		}
+		encodeColumn(column, writer);
+	}
+	writer.flush();
+}
+
+bool ofxOpenBciWifiRecordingCodec::decode(const char* payload, size_t nBytes, ofxOpenBciWifiRecordingBlock& block)
+{
+	uint32_t sizes[2];
+	if (nBytes < sizeof(sizes))
+	{
+		return false;
+	}
+	memcpy(sizes, payload, sizeof(sizes));
+	// Every value takes at least one bit
+	if (sizes[1] > CODEC_MAX_CHANNELS || (uint64_t)sizes[0] * (sizes[1] + 3) > (uint64_t)nBytes * 8)
+	{
+		return false;
+	}
+	int nSamples = sizes[0];
+	int nChannels = sizes[1];
+	block.nSamples = nSamples;
+	block.nChannels = nChannels;
+	block.timestamps.resize(nSamples);
+	block.sampleNumbers.resize(nSamples);
+	block.counts.resize(nSamples);
+	block.data.resize(nSamples * nChannels);
+
+	BitReader reader(payload + sizeof(sizes), payload + nBytes);
+	vector<uint64_t> column;
+	if (!decodeColumn(reader, column, nSamples))
+	{
+		return false;
+	}
+	for (int s = 0; s < nSamples; s++)
+	{
+		block.timestamps[s] = toDouble(column[s]);
+	}
+	if (!decodeColumn(reader, column, nSamples))
+	{
+		return false;
+	}
+	for (int s = 0; s < nSamples; s++)
+	{
+		block.sampleNumbers[s] = (int32_t)column[s];
+	}
+	if (!decodeColumn(reader, column, nSamples))
+	{
+		return false;
+	}
+	for (int s = 0; s < nSamples; s++)
+	{
+		block.counts[s] = (int32_t)column[s];
+	}
+	for (int ch = 0; ch < nChannels; ch++)
+	{
+		if (!decodeColumn(reader, column, nSamples))
+		{
+			return false;
+		}
+		for (int s = 0; s < nSamples; s++)
+		{
+			block.data[s * nChannels + ch] = toFloat(column[s]);
+		}
+	}
+	return true;
+}
+
+bool ofxOpenBciWifiRecordingCodec::decodeFirstTimestamp(const char* payload, size_t nBytes, double& timestamp)
+{
+	uint32_t sizes[2];
+	if (nBytes < sizeof(sizes))
+	{
+		return false;
+	}
+	memcpy(sizes, payload, sizeof(sizes));
+	if (sizes[0] == 0)
+	{
+		return false;
+	}
+
+	// The timestamps are the first column and nothing predicts the first value
+	BitReader reader(payload + sizeof(sizes), payload + nBytes);
+	int order = (int)reader.read(2);
+	int k = (int)reader.read(6);
+	int q = reader.readUnary();
+	uint64_t value = (q == CODEC_ESCAPE) ? reader.readLong(64) : (((uint64_t)q << k) | reader.readLong(k));
+	timestamp = toDouble(unzigzag(value));
+	return order <= CODEC_MAX_ORDER && !reader.failed;
+}
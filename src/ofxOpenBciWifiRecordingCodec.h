@@ -0,0 +1,28 @@
+//
+//  ofxOpenBciWifiRecordingCodec.h
+//
+//  Lossless compression of recording blocks, along the lines of FLAC. Every column (timestamps,
+//  sample numbers, counts and each channel) is mapped to integers that keep the ordering of the
+//  values, predicted with the best fixed polynomial of order 0 to 2 and the residuals are Rice
+//  coded. Floats are compared bit for bit, so decoding gives back exactly what was recorded.
+//  Blocks are independent and cost O(samples x channels).
+//  Payload: uint32 nSamples, uint32 nChannels, then per column 2 bits order, 6 bits Rice
+//  parameter and the coded residuals, least significant bit first.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiRecording.h"
+
+class ofxOpenBciWifiRecordingCodec
+{
+public:
+	// Appends the compressed block to out
+	static void encode(const ofxOpenBciWifiRecordingBlock& block, string& out);
+	// Returns false if the payload is corrupt
+	static bool decode(const char* payload, size_t nBytes, ofxOpenBciWifiRecordingBlock& block);
+	// Timestamp of the first sample without decoding the rest of the block
+	static bool decodeFirstTimestamp(const char* payload, size_t nBytes, double& timestamp);
+};
@@ -0,0 +1,465 @@
+//
+//  ofxOpenBciWifiRecordingIndex.cpp
+//
+//  Random access to memory mapped recordings.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiRecordingIndex.h"
+#include "ofxOpenBciWifiRecordingCodec.h"
+#include <cfloat>
+
+#ifdef TARGET_WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define INDEX_MAX_HEADSETS 4096					// Larger headset numbers are taken as corrupt records
+
+ofxOpenBciWifiRecordingIndex::ofxOpenBciWifiRecordingIndex()
+{
+	_data = NULL;
+	_size = 0;
+	_fileHandle = NULL;
+	_mappingHandle = NULL;
+}
+
+ofxOpenBciWifiRecordingIndex::~ofxOpenBciWifiRecordingIndex()
+{
+	close();
+}
+
+bool ofxOpenBciWifiRecordingIndex::open(string filePath)
+{
+	close();
+	if (!map(filePath))
+	{
+		ofLogError("ofxOpenBciWifiRecordingIndex") << "Could not map " << filePath;
+		return false;
+	}
+	if (_size < OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN
+		|| memcmp(_data, OFX_OPENBCI_WIFI_RECORDING_MAGIC, OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN) != 0)
+	{
+		ofLogError("ofxOpenBciWifiRecordingIndex") << filePath << " is not a recording";
+		close();
+		return false;
+	}
+	buildIndex();
+	return true;
+}
+
+void ofxOpenBciWifiRecordingIndex::close()
+{
+	unmap();
+	_headsets.clear();
+	_decoded.clear();
+}
+
+bool ofxOpenBciWifiRecordingIndex::isOpen()
+{
+	return _data != NULL;
+}
+
+bool ofxOpenBciWifiRecordingIndex::map(string filePath)
+{
+	string path = ofToDataPath(filePath);
+#ifdef TARGET_WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	_fileHandle = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		unmap();
+		return false;
+	}
+	_mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mappingHandle == NULL)
+	{
+		unmap();
+		return false;
+	}
+	_data = (const char*)MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (_data == NULL)
+	{
+		unmap();
+		return false;
+	}
+	_size = (size_t)size.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping keeps the file open
+	::close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	_data = (const char*)data;
+	_size = info.st_size;
+#endif
+	return true;
+}
+
+void ofxOpenBciWifiRecordingIndex::unmap()
+{
+#ifdef TARGET_WIN32
+	if (_data != NULL)
+	{
+		UnmapViewOfFile(_data);
+	}
+	if (_mappingHandle != NULL)
+	{
+		CloseHandle(_mappingHandle);
+	}
+	if (_fileHandle != NULL)
+	{
+		CloseHandle(_fileHandle);
+	}
+#else
+	if (_data != NULL)
+	{
+		munmap((void*)_data, _size);
+	}
+#endif
+	_data = NULL;
+	_size = 0;
+	_fileHandle = NULL;
+	_mappingHandle = NULL;
+}
+
+void ofxOpenBciWifiRecordingIndex::buildIndex()
+{
+	// Only the record headers and the first timestamp of every indexed block are read
+	Record record;
+	for (size_t offset = OFX_OPENBCI_WIFI_RECORDING_MAGIC_LEN; readRecord(offset, record); offset = record.next)
+	{
+		if (record.headset < 0 || record.headset >= INDEX_MAX_HEADSETS)
+		{
+			continue;
+		}
+		if (record.type == OFX_OPENBCI_WIFI_RECORDING_CONFIG && record.nBytes >= sizeof(ofxOpenBciWifiRecordingConfig))
+		{
+			if (record.headset >= _headsets.size())
+			{
+				_headsets.resize(record.headset + 1, Headset());
+			}
+			ofxOpenBciWifiRecordingConfig& config = _headsets.at(record.headset).config;
+			memcpy(&config, record.payload, sizeof(config));
+			config.ipAddress[sizeof(config.ipAddress) - 1] = '\0';
+			continue;
+		}
+
+		uint32_t nSamples, nChannels;
+		if (!getBlockSizes(record, nSamples, nChannels) || nSamples == 0)
+		{
+			continue;
+		}
+		if (record.headset >= _headsets.size())
+		{
+			_headsets.resize(record.headset + 1, Headset());
+		}
+		Headset& headset = _headsets.at(record.headset);
+		if (headset.nSamples == 0)
+		{
+			headset.firstOffset = offset;
+		}
+		headset.lastOffset = offset;
+
+		if (headset.entries.empty() || headset.nSamples - headset.entries.back().sample >= OFX_OPENBCI_WIFI_RECORDING_INDEX_INTERVAL)
+		{
+			Entry entry = { headset.nSamples, 0., offset };
+			bool valid = true;
+			if (record.type == OFX_OPENBCI_WIFI_RECORDING_BLOCK)
+			{
+				memcpy(&entry.timestamp, record.payload + OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER, sizeof(double));
+			}
+			else
+			{
+				valid = ofxOpenBciWifiRecordingCodec::decodeFirstTimestamp(record.payload, record.nBytes, entry.timestamp);
+			}
+			// A corrupt block leaves the entry to the next one
+			if (valid)
+			{
+				headset.entries.push_back(entry);
+			}
+		}
+		headset.nSamples += nSamples;
+	}
+}
+
+bool ofxOpenBciWifiRecordingIndex::readRecord(size_t offset, Record& record)
+{
+	if (offset + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER > _size)
+	{
+		return false;
+	}
+	uint32_t header[4];
+	memcpy(header, _data + offset, sizeof(header));
+	if (header[2] > _size - offset - OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER)
+	{
+		// The recording was cut off mid record
+		return false;
+	}
+	record.type = header[0];
+	record.headset = header[1];
+	record.payload = _data + offset + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER;
+	record.nBytes = header[2];
+	record.next = offset + OFX_OPENBCI_WIFI_RECORDING_RECORD_HEADER + header[2];
+	return true;
+}
+
+bool ofxOpenBciWifiRecordingIndex::getBlockSizes(const Record& record, uint32_t& nSamples, uint32_t& nChannels)
+{
+	if ((record.type != OFX_OPENBCI_WIFI_RECORDING_BLOCK && record.type != OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK)
+		|| record.nBytes < OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER)
+	{
+		return false;
+	}
+	// Both block types start with the sizes
+	uint32_t sizes[2];
+	memcpy(sizes, record.payload, sizeof(sizes));
+	nSamples = sizes[0];
+	nChannels = sizes[1];
+	if (record.type == OFX_OPENBCI_WIFI_RECORDING_BLOCK)
+	{
+		return OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER + (uint64_t)nSamples * (sizeof(double) + 2 * sizeof(int32_t) + (uint64_t)nChannels * sizeof(float)) <= record.nBytes;
+	}
+	return true;
+}
+
+bool ofxOpenBciWifiRecordingIndex::getSpan(const Record& record, ofxOpenBciWifiRecordingBlock& decoded, ofxOpenBciWifiRecordingSpan& span)
+{
+	if (record.type == OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK)
+	{
+		if (!ofxOpenBciWifiRecordingCodec::decode(record.payload, record.nBytes, decoded) || decoded.nSamples == 0)
+		{
+			return false;
+		}
+		span.timestamps = &decoded.timestamps[0];
+		span.sampleNumbers = &decoded.sampleNumbers[0];
+		span.counts = &decoded.counts[0];
+		span.data = decoded.data.empty() ? NULL : &decoded.data[0];
+		span.nSamples = decoded.nSamples;
+		span.stride = decoded.nChannels;
+		return true;
+	}
+
+	// Records are 8 byte aligned in the file, so the arrays can be used in place
+	uint32_t sizes[2];
+	memcpy(sizes, record.payload, sizeof(sizes));
+	span.timestamps = (const double*)(record.payload + OFX_OPENBCI_WIFI_RECORDING_BLOCK_HEADER);
+	span.sampleNumbers = (const int32_t*)(span.timestamps + sizes[0]);
+	span.counts = span.sampleNumbers + sizes[0];
+	span.data = (const float*)(span.counts + sizes[0]);
+	span.nSamples = sizes[0];
+	span.stride = sizes[1];
+	return true;
+}
+
+ofxOpenBciWifiRecordingIndex::Entry ofxOpenBciWifiRecordingIndex::findEntry(int headset, uint64_t sample)
+{
+	const Headset& h = _headsets.at(headset);
+	Entry start = { 0, -DBL_MAX, h.firstOffset };
+	int lo = 0;
+	int hi = h.entries.size();
+	// First entry after sample
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (h.entries[mid].sample <= sample)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo > 0 ? h.entries[lo - 1] : start;
+}
+
+ofxOpenBciWifiRecordingIndex::Entry ofxOpenBciWifiRecordingIndex::findEntryBefore(int headset, double timestamp)
+{
+	const Headset& h = _headsets.at(headset);
+	Entry start = { 0, -DBL_MAX, h.firstOffset };
+	int lo = 0;
+	int hi = h.entries.size();
+	// First entry at or after timestamp, samples with equal timestamps can start in the entry before
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (h.entries[mid].timestamp < timestamp)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo > 0 ? h.entries[lo - 1] : start;
+}
+
+int ofxOpenBciWifiRecordingIndex::getHeadsetCount()
+{
+	return _headsets.size();
+}
+
+ofxOpenBciWifiRecordingConfig ofxOpenBciWifiRecordingIndex::getConfig(int headset)
+{
+	if (headset < 0 || headset >= _headsets.size())
+	{
+		ofxOpenBciWifiRecordingConfig config;
+		memset(&config, 0, sizeof(config));
+		return config;
+	}
+	return _headsets.at(headset).config;
+}
+
+uint64_t ofxOpenBciWifiRecordingIndex::getSampleCount(int headset)
+{
+	if (headset < 0 || headset >= _headsets.size())
+	{
+		return 0;
+	}
+	return _headsets.at(headset).nSamples;
+}
+
+double ofxOpenBciWifiRecordingIndex::getStartTimestamp(int headset)
+{
+	if (headset < 0 || headset >= _headsets.size() || _headsets.at(headset).entries.empty())
+	{
+		return 0.;
+	}
+	return _headsets.at(headset).entries.front().timestamp;
+}
+
+double ofxOpenBciWifiRecordingIndex::getEndTimestamp(int headset)
+{
+	Record record;
+	ofxOpenBciWifiRecordingSpan span;
+	if (getSampleCount(headset) == 0 || !readRecord(_headsets.at(headset).lastOffset, record)
+		|| !getSpan(record, _scratch, span))
+	{
+		return 0.;
+	}
+	return span.timestamps[span.nSamples - 1];
+}
+
+uint64_t ofxOpenBciWifiRecordingIndex::findSample(int headset, double timestamp)
+{
+	uint64_t nSamples = getSampleCount(headset);
+	if (nSamples == 0)
+	{
+		return 0;
+	}
+
+	// The answer lies before the next index entry, so the walk is short
+	Entry entry = findEntryBefore(headset, timestamp);
+	uint64_t pos = entry.sample;
+	Record record;
+	for (size_t offset = entry.offset; pos < nSamples && readRecord(offset, record); offset = record.next)
+	{
+		uint32_t blockSamples, blockChannels;
+		if (record.headset != headset || !getBlockSizes(record, blockSamples, blockChannels) || blockSamples == 0)
+		{
+			continue;
+		}
+		ofxOpenBciWifiRecordingSpan span;
+		if (getSpan(record, _scratch, span))
+		{
+			for (size_t s = 0; s < span.nSamples; s++)
+			{
+				if (span.timestamps[s] >= timestamp)
+				{
+					return pos + s;
+				}
+			}
+		}
+		pos += blockSamples;
+	}
+	return nSamples;
+}
+
+size_t ofxOpenBciWifiRecordingIndex::getWindow(int headset, uint64_t firstSample, size_t nSamples, int firstChannel, int nChannels, ofxOpenBciWifiRecordingWindow& window)
+{
+	window.spans.clear();
+	window.firstSample = firstSample;
+	window.nChannels = nChannels;
+	_decoded.clear();
+	uint64_t total = getSampleCount(headset);
+	if (firstSample >= total || firstChannel < 0 || nChannels <= 0)
+	{
+		return 0;
+	}
+	size_t remaining = min((uint64_t)nSamples, total - firstSample);
+	uint64_t want = firstSample;
+
+	Entry entry = findEntry(headset, firstSample);
+	uint64_t pos = entry.sample;
+	Record record;
+	for (size_t offset = entry.offset; remaining > 0 && readRecord(offset, record); offset = record.next)
+	{
+		uint32_t blockSamples, blockChannels;
+		if (record.headset != headset || !getBlockSizes(record, blockSamples, blockChannels) || blockSamples == 0)
+		{
+			continue;
+		}
+		if (pos + blockSamples <= want)
+		{
+			pos += blockSamples;
+			continue;
+		}
+		if (firstChannel + nChannels > blockChannels)
+		{
+			break;
+		}
+		ofxOpenBciWifiRecordingSpan span;
+		if (record.type == OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK)
+		{
+			_decoded.push_back(ofxOpenBciWifiRecordingBlock());
+		}
+		if (!getSpan(record, record.type == OFX_OPENBCI_WIFI_RECORDING_COMPRESSED_BLOCK ? _decoded.back() : _scratch, span))
+		{
+			break;
+		}
+		size_t skip = want - pos;
+		size_t take = min(span.nSamples - skip, remaining);
+		span.timestamps += skip;
+		span.sampleNumbers += skip;
+		span.counts += skip;
+		span.data += skip * span.stride + firstChannel;
+		span.nSamples = take;
+		window.spans.push_back(span);
+		remaining -= take;
+		want += take;
+		pos += blockSamples;
+	}
+	return want - firstSample;
+}
+
+size_t ofxOpenBciWifiRecordingIndex::getWindowByTime(int headset, double startTimestamp, double endTimestamp, int firstChannel, int nChannels, ofxOpenBciWifiRecordingWindow& window)
+{
+	uint64_t first = findSample(headset, startTimestamp);
+	uint64_t end = findSample(headset, endTimestamp);
+	return getWindow(headset, first, end > first ? end - first : 0, firstChannel, nChannels, window);
+}
@@ -0,0 +1,132 @@
+//
+//  ofxOpenBciWifiRecordingIndex.h
+//
+//  Random access to recordings written by ofxOpenBciWifi::enableDataLogging(). The file is
+//  memory mapped and open() walks the record headers once, keeping a sparse index from sample
+//  position and timestamp to file offset for every headset. A seek is a binary search of the
+//  index plus a walk of at most OFX_OPENBCI_WIFI_RECORDING_INDEX_INTERVAL samples, and windows
+//  of uncompressed blocks point straight into the mapped file.
+//  Sample positions count a headset's samples from 0, the recorded sampleNumbers wrap around.
+//  Timestamps are expected to increase within a headset.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiRecording.h"
+
+#define OFX_OPENBCI_WIFI_RECORDING_INDEX_INTERVAL 1024	// Samples of a headset between index entries
+
+// Consecutive samples of one block
+struct ofxOpenBciWifiRecordingSpan
+{
+	const double* timestamps;
+	const int32_t* sampleNumbers;
+	const int32_t* counts;
+	const float* data;								// First channel of the window in the first sample
+	size_t nSamples;
+	int stride;										// Floats from one sample to the next
+};
+
+// Zero-copy view of a range of samples and channels, one span per block
+struct ofxOpenBciWifiRecordingWindow
+{
+	vector<ofxOpenBciWifiRecordingSpan> spans;
+	uint64_t firstSample;
+	int nChannels;
+
+	size_t size() const
+	{
+		size_t n = 0;
+		for (int i = 0; i < spans.size(); i++)
+		{
+			n += spans[i].nSamples;
+		}
+		return n;
+	}
+	float at(size_t sample, int channel) const
+	{
+		for (int i = 0; i < spans.size(); i++)
+		{
+			if (sample < spans[i].nSamples)
+			{
+				return spans[i].data[sample * spans[i].stride + channel];
+			}
+			sample -= spans[i].nSamples;
+		}
+		return 0.f;
+	}
+};
+
+class ofxOpenBciWifiRecordingIndex
+{
+private:
+	struct Entry
+	{
+		uint64_t sample;							// Position of the first sample of the block
+		double timestamp;							// Of that sample
+		size_t offset;								// Of the block's record
+	};
+
+	struct Headset
+	{
+		vector<Entry> entries;
+		uint64_t nSamples;
+		size_t firstOffset;							// Of the headset's first block
+		size_t lastOffset;
+		ofxOpenBciWifiRecordingConfig config;
+	};
+
+	struct Record
+	{
+		uint32_t type;
+		int headset;
+		const char* payload;
+		size_t nBytes;
+		size_t next;								// Offset of the following record
+	};
+
+	const char* _data;
+	size_t _size;
+	void* _fileHandle;
+	void* _mappingHandle;
+	vector<Headset> _headsets;
+	deque<ofxOpenBciWifiRecordingBlock> _decoded;	// Compressed blocks of the last window
+	ofxOpenBciWifiRecordingBlock _scratch;
+
+	bool map(string filePath);
+	void unmap();
+	void buildIndex();
+	bool readRecord(size_t offset, Record& record);	// False past the last complete record
+	bool getBlockSizes(const Record& record, uint32_t& nSamples, uint32_t& nChannels);
+	// Points into the mapped file, or into decoded for a compressed block
+	bool getSpan(const Record& record, ofxOpenBciWifiRecordingBlock& decoded, ofxOpenBciWifiRecordingSpan& span);
+	Entry findEntry(int headset, uint64_t sample);	// Last one at or before sample
+	Entry findEntryBefore(int headset, double timestamp);
+
+public:
+	ofxOpenBciWifiRecordingIndex();
+	~ofxOpenBciWifiRecordingIndex();
+
+	bool open(string filePath);
+	void close();
+	bool isOpen();
+
+	int getHeadsetCount();
+	ofxOpenBciWifiRecordingConfig getConfig(int headset);	// Last one in the recording
+	uint64_t getSampleCount(int headset);
+	double getStartTimestamp(int headset);
+	double getEndTimestamp(int headset);
+
+	// Position of the first sample at or after timestamp, getSampleCount() if there is none
+	uint64_t findSample(int headset, double timestamp);
+
+	// Up to nSamples samples from firstSample of channels [firstChannel, firstChannel + nChannels).
+	// Windows of compressed blocks point into memory decoded by the index and are only valid until
+	// the next getWindow(), the others until close(). The window ends early at a block without
+	// those channels. Returns the number of samples in the window.
+	size_t getWindow(int headset, uint64_t firstSample, size_t nSamples, int firstChannel, int nChannels, ofxOpenBciWifiRecordingWindow& window);
+	// Samples with startTimestamp <= timestamp < endTimestamp
+	size_t getWindowByTime(int headset, double startTimestamp, double endTimestamp, int firstChannel, int nChannels, ofxOpenBciWifiRecordingWindow& window);
+};
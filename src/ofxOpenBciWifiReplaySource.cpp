@@ -0,0 +1,412 @@
+//
+//  ofxOpenBciWifiReplaySource.cpp
+//
+//  Plays recorded sessions into ofxOpenBciWifi instead of a network connection.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiReplaySource.h"
+
+ofxOpenBciWifiReplaySource::ofxOpenBciWifiReplaySource()
+{
+	_speed = 1.f;
+	_looping = false;
+	_bytesReplayed = 0;
+	_startTime = 0;
+	// Return to the pipeline regularly when replaying as fast as possible
+	_maxBytesPerDispatch = 256 * 1024;
+	restart();
+}
+
+bool ofxOpenBciWifiReplaySource::loadCapture(string filePath)
+{
+	ofBuffer buffer = ofBufferFromFile(filePath, true);
+	const char* data = buffer.getData();
+	size_t size = buffer.size();
+	if (size < OFX_OPENBCI_WIFI_CAPTURE_MAGIC_LEN || memcmp(data, OFX_OPENBCI_WIFI_CAPTURE_MAGIC, OFX_OPENBCI_WIFI_CAPTURE_MAGIC_LEN) != 0)
+	{
+		ofLogError("ofxOpenBciWifiReplaySource") << filePath << " is not a capture";
+		return false;
+	}
+
+	ofScopedLock lock(_mutex);
+	map<int, int> streams;				// Stream by the headset number in the capture
+	size_t pos = OFX_OPENBCI_WIFI_CAPTURE_MAGIC_LEN;
+	while (pos + OFX_OPENBCI_WIFI_CAPTURE_RECORD_HEADER <= size)
+	{
+		uint64_t micros;
+		uint32_t fields[3];
+		memcpy(&micros, data + pos, sizeof(micros));
+		memcpy(fields, data + pos + sizeof(micros), sizeof(fields));
+		pos += OFX_OPENBCI_WIFI_CAPTURE_RECORD_HEADER;
+		if (pos + fields[2] > size)
+		{
+			ofLogWarning("ofxOpenBciWifiReplaySource") << filePath << " ends with a partial record";
+			break;
+		}
+
+		int headset = fields[1];
+		if (streams.find(headset) == streams.end())
+		{
+			streams[headset] = _ips.size();
+			_ips.push_back("capture headset " + ofToString(headset + 1));
+			_headsets.push_back(-1);
+			_samplingFreqs.push_back(0);
+		}
+		int stream = streams[headset];
+		ofxOpenBciWifiCaptureRecordType type = (ofxOpenBciWifiCaptureRecordType)fields[0];
+		if (type == OFX_OPENBCI_WIFI_CAPTURE_CONNECT)
+		{
+			_ips.at(stream) = string(data + pos, fields[2]);
+		}
+		addEvent(micros, type, stream, data + pos, fields[2]);
+		pos += fields[2];
+	}
+	sortEvents();
+	ofLogNotice("ofxOpenBciWifiReplaySource") << "Loaded " << filePath << ": " << streams.size() << " headsets, "
+		<< (_events.empty() ? 0 : _events.back().time / 1000000.) << " seconds";
+	return true;
+}
+
+bool ofxOpenBciWifiReplaySource::loadRecording(string filePath)
+{
+	ofxOpenBciWifiRecordingReader reader;
+	if (!reader.open(filePath))
+	{
+		return false;
+	}
+
+	ofScopedLock lock(_mutex);
+	map<int, int> streams;				// Stream by the headset number in the recording
+	bool firstBlock = true;
+	double firstTimestamp = 0;
+	ofxOpenBciWifiRecordingBlock block;
+	string chunk;
+	char value[32];
+	while (reader.readBlock(block))
+	{
+		if (block.nSamples == 0)
+		{
+			continue;
+		}
+		if (firstBlock)
+		{
+			firstTimestamp = block.timestamps.front();
+			firstBlock = false;
+		}
+		uint64_t micros = (uint64_t)(max(block.timestamps.front() - firstTimestamp, 0.) * 1000.);
+
+		if (streams.find(block.headset) == streams.end())
+		{
+			string ip = reader.getConfig(block.headset).ipAddress;
+			streams[block.headset] = _ips.size();
+			_ips.push_back(ip);
+			_headsets.push_back(-1);
+			_samplingFreqs.push_back((int)reader.getConfig(block.headset).Fs);
+			addEvent(micros, OFX_OPENBCI_WIFI_CAPTURE_CONNECT, _ips.size() - 1, ip.data(), ip.size());
+		}
+
+		// The block as one chunk, floats with enough digits to parse back exactly
+		chunk = "{\"chunk\":[";
+		for (int s = 0; s < block.nSamples; s++)
+		{
+			snprintf(value, sizeof(value), "%.0f", block.timestamps.at(s));
+			chunk += string(s > 0 ? "," : "") + "{\"timestamp\":" + value
+				+ ",\"sampleNumber\":" + ofToString(block.sampleNumbers.at(s)) + ",\"data\":[";
+			for (int ch = 0; ch < block.nChannels; ch++)
+			{
+				snprintf(value, sizeof(value), ch > 0 ? ",%.9g" : "%.9g", block.data.at(s * block.nChannels + ch));
+				chunk += value;
+			}
+			chunk += "]}";
+		}
+		chunk += "],\"count\":" + ofToString(block.counts.front()) + "}\r\n";
+		addEvent(micros, OFX_OPENBCI_WIFI_CAPTURE_DATA, streams[block.headset], chunk.data(), chunk.size());
+	}
+	sortEvents();
+	ofLogNotice("ofxOpenBciWifiReplaySource") << "Loaded " << filePath << ": " << streams.size() << " headsets, "
+		<< (_events.empty() ? 0 : _events.back().time / 1000000.) << " seconds";
+	return true;
+}
+
+bool ofxOpenBciWifiReplaySource::loadLog(string filePath)
+{
+	ofFile file(filePath);
+	if (!file.exists())
+	{
+		ofLogError("ofxOpenBciWifiReplaySource") << "Could not open " << filePath;
+		return false;
+	}
+	ofBuffer buffer = file.readToBuffer();
+
+	ofScopedLock lock(_mutex);
+	map<string, int> streams;
+	bool firstRow = true;
+	double firstTimestamp = 0;
+	string chunk;
+	for (auto& line : buffer.getLines())
+	{
+		// ip,timestamps,sample_numbers,count,data0,...,dataN
+		vector<string> fields = ofSplitString(line, ",", true, true);
+		if (fields.size() < 5 || fields.at(0) == "ip")
+		{
+			continue;
+		}
+
+		double timestamp = atof(fields.at(1).c_str());
+		if (firstRow)
+		{
+			firstTimestamp = timestamp;
+			firstRow = false;
+		}
+		uint64_t micros = (uint64_t)(max(timestamp - firstTimestamp, 0.) * 1000.);
+
+		if (streams.find(fields.at(0)) == streams.end())
+		{
+			streams[fields.at(0)] = _ips.size();
+			_ips.push_back(fields.at(0));
+			_headsets.push_back(-1);
+			_samplingFreqs.push_back(0);
+			addEvent(micros, OFX_OPENBCI_WIFI_CAPTURE_CONNECT, _ips.size() - 1, fields.at(0).data(), fields.at(0).size());
+		}
+
+		// Same layout as the chunks sent by the Wifi shield
+		chunk = "{\"chunk\":[{\"timestamp\":" + fields.at(1) + ",\"sampleNumber\":" + fields.at(2) + ",\"data\":[";
+		for (int i = 4; i < fields.size(); i++)
+		{
+			if (i > 4)
+			{
+				chunk += ",";
+			}
+			chunk += fields.at(i);
+		}
+		chunk += "]}],\"count\":" + fields.at(3) + "}\r\n";
+		addEvent(micros, OFX_OPENBCI_WIFI_CAPTURE_DATA, streams[fields.at(0)], chunk.data(), chunk.size());
+	}
+	sortEvents();
+	ofLogNotice("ofxOpenBciWifiReplaySource") << "Loaded " << filePath << ": " << streams.size() << " headsets, "
+		<< (_events.empty() ? 0 : _events.back().time / 1000000.) << " seconds";
+	return true;
+}
+
+void ofxOpenBciWifiReplaySource::addEvent(uint64_t time, ofxOpenBciWifiCaptureRecordType type, int stream, const char* payload, size_t nBytes)
+{
+	Event event;
+	event.time = time;
+	event.type = type;
+	event.stream = stream;
+	event.offset = _bytes.size();
+	event.nBytes = nBytes;
+	_bytes.append(payload, nBytes);
+	_events.push_back(event);
+}
+
+void ofxOpenBciWifiReplaySource::sortEvents()
+{
+	// Stable, so bytes recorded at the same time keep their order
+	stable_sort(_events.begin(), _events.end(), [](const Event& a, const Event& b) { return a.time < b.time; });
+	_next = 0;
+	_nextOffset = 0;
+	_started = false;
+}
+
+void ofxOpenBciWifiReplaySource::clear()
+{
+	ofScopedLock lock(_mutex);
+	_events.clear();
+	_bytes.clear();
+	_ips.clear();
+	_headsets.clear();
+	_samplingFreqs.clear();
+	_next = 0;
+	_nextOffset = 0;
+	_started = false;
+}
+
+void ofxOpenBciWifiReplaySource::setSpeed(float speed)
+{
+	ofScopedLock lock(_mutex);
+	speed = max(speed, 0.f);
+	if (_started && speed > 0)
+	{
+		// Carry on from the current position at the new pace
+		uint64_t now = ofGetElapsedTimeMicros();
+		uint64_t position = getPosition(now);
+		if (_speed <= 0)
+		{
+			position = _next < _events.size() ? _events.at(_next).time : 0;
+		}
+		_startTime = now - (uint64_t)(position / speed);
+	}
+	_speed = speed;
+}
+
+float ofxOpenBciWifiReplaySource::getSpeed()
+{
+	return _speed;
+}
+
+void ofxOpenBciWifiReplaySource::setLooping(bool looping)
+{
+	_looping = looping;
+}
+
+bool ofxOpenBciWifiReplaySource::getLooping()
+{
+	return _looping;
+}
+
+void ofxOpenBciWifiReplaySource::restart()
+{
+	ofScopedLock lock(_mutex);
+	_next = 0;
+	_nextOffset = 0;
+	_started = false;
+	_blocked = false;
+	for (int i = 0; i < _headsets.size(); i++)
+	{
+		_headsets.at(i) = -1;
+	}
+}
+
+bool ofxOpenBciWifiReplaySource::isFinished()
+{
+	ofScopedLock lock(_mutex);
+	return _next >= _events.size() && !_looping;
+}
+
+float ofxOpenBciWifiReplaySource::getDuration()
+{
+	ofScopedLock lock(_mutex);
+	return _events.empty() ? 0.f : _events.back().time / 1000000.f;
+}
+
+uint64_t ofxOpenBciWifiReplaySource::getBytesReplayed()
+{
+	ofScopedLock lock(_mutex);
+	return _bytesReplayed;
+}
+
+uint64_t ofxOpenBciWifiReplaySource::getPosition(uint64_t now)
+{
+	if (!_started || _speed <= 0)
+	{
+		return 0;
+	}
+	return (uint64_t)((now - _startTime) * (double)_speed);
+}
+
+void ofxOpenBciWifiReplaySource::wait(int timeoutMs)
+{
+	uint64_t timeout = timeoutMs * 1000;
+	uint64_t delay;
+	{
+		ofScopedLock lock(_mutex);
+		if (_next >= _events.size())
+		{
+			delay = timeout;
+		}
+		else if (_blocked)
+		{
+			// Give the pipeline a moment to make room
+			delay = 1000;
+		}
+		else if (_speed <= 0 || !_started)
+		{
+			delay = 0;
+		}
+		else
+		{
+			uint64_t position = getPosition(ofGetElapsedTimeMicros());
+			uint64_t time = _events.at(_next).time;
+			delay = time > position ? (uint64_t)((time - position) / _speed) : 0;
+		}
+	}
+	delay = min(delay, timeout);
+	if (delay > 0)
+	{
+		ofSleepMillis((delay + 999) / 1000);
+	}
+}
+
+void ofxOpenBciWifiReplaySource::dispatch(ofxOpenBciWifiConnectionListener& listener)
+{
+	ofScopedLock lock(_mutex);
+	uint64_t now = ofGetElapsedTimeMicros();
+	if (!_started)
+	{
+		_startTime = now;
+		_started = true;
+	}
+	_blocked = false;
+	uint64_t position = getPosition(now);
+	size_t budget = _maxBytesPerDispatch;
+
+	while (_next < _events.size())
+	{
+		const Event& event = _events.at(_next);
+		if (_speed > 0 && event.time > position)
+		{
+			break;
+		}
+
+		int& headset = _headsets.at(event.stream);
+		if (event.type == OFX_OPENBCI_WIFI_CAPTURE_CONNECT)
+		{
+			headset = listener.onConnect(_ips.at(event.stream), _samplingFreqs.at(event.stream));
+		}
+		else if (event.type == OFX_OPENBCI_WIFI_CAPTURE_DISCONNECT)
+		{
+			if (headset >= 0)
+			{
+				listener.onDisconnect(headset);
+			}
+			headset = -1;
+		}
+		else
+		{
+			if (headset < 0)
+			{
+				headset = listener.onConnect(_ips.at(event.stream), _samplingFreqs.at(event.stream));
+			}
+			while (_nextOffset < event.nBytes)
+			{
+				size_t space;
+				char* buffer = listener.getReceiveBuffer(headset, space);
+				if (buffer == NULL || space == 0)
+				{
+					// Resume from here once the pipeline has caught up
+					_blocked = true;
+					return;
+				}
+				size_t n = min(space, event.nBytes - _nextOffset);
+				memcpy(buffer, _bytes.data() + event.offset + _nextOffset, n);
+				listener.onReceive(headset, n);
+				_nextOffset += n;
+				_bytesReplayed += n;
+			}
+			budget -= min(budget, event.nBytes);
+		}
+		_next++;
+		_nextOffset = 0;
+
+		if (_next == _events.size() && _looping)
+		{
+			_next = 0;
+			_startTime = now;
+			break;
+		}
+		if (budget == 0)
+		{
+			break;
+		}
+	}
+}
+
+void ofxOpenBciWifiReplaySource::close()
+{
+	ofScopedLock lock(_mutex);
+	_next = _events.size();
+	_nextOffset = 0;
+}
@@ -0,0 +1,74 @@
+//
+//  ofxOpenBciWifiReplaySource.h
+//
+//  Plays recorded sessions into ofxOpenBciWifi instead of a network connection, at the
+//  recorded pace or as fast as the pipeline takes them. Replays are deterministic, so the
+//  parse, filter and FFT path can be profiled and regression tested without sockets.
+//  Reads captures written by ofxOpenBciWifi::enableCapture(), recordings written by
+//  enableDataLogging() and their csv conversions. Recordings hold parsed samples and are
+//  replayed as JSON chunks.
+//  Everything is loaded into memory up front.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiSource.h"
+#include "ofxOpenBciWifiCapture.h"
+#include "ofxOpenBciWifiRecording.h"
+
+class ofxOpenBciWifiReplaySource : public ofxOpenBciWifiSource
+{
+private:
+	struct Event
+	{
+		uint64_t time;					// Microseconds since the start of the recording
+		ofxOpenBciWifiCaptureRecordType type;
+		int stream;
+		size_t offset;					// Payload in _bytes
+		size_t nBytes;
+	};
+
+	ofMutex _mutex;
+	vector<Event> _events;
+	string _bytes;
+	vector<string> _ips;				// By stream
+	vector<int> _headsets;				// Listener's headset by stream, -1 before connecting
+	vector<int> _samplingFreqs;			// By stream, 0 when the file doesn't say
+	size_t _next;						// Next event to deliver
+	size_t _nextOffset;					// Bytes of the next event already delivered
+	float _speed;
+	bool _looping;
+	bool _started;
+	bool _blocked;						// The listener had no room during the last dispatch()
+	uint64_t _startTime;				// When the recording started at the current speed
+	uint64_t _bytesReplayed;
+	size_t _maxBytesPerDispatch;
+
+	uint64_t getPosition(uint64_t now);
+	void addEvent(uint64_t time, ofxOpenBciWifiCaptureRecordType type, int stream, const char* payload, size_t nBytes);
+	void sortEvents();
+
+public:
+	ofxOpenBciWifiReplaySource();
+
+	bool loadCapture(string filePath);
+	// Replay these with the OFX_OPENBCI_WIFI_FORMAT_JSON data format
+	bool loadRecording(string filePath);
+	bool loadLog(string filePath);		// csv from ofxOpenBciWifiRecordingReader::convertToCsv()
+	void clear();
+
+	void setSpeed(float speed);			// 1 = recorded pace (default), 0 = as fast as possible
+	float getSpeed();
+	void setLooping(bool looping);
+	bool getLooping();
+	void restart();
+	bool isFinished();
+	float getDuration();				// Seconds
+	uint64_t getBytesReplayed();
+
+	void wait(int timeoutMs);
+	void dispatch(ofxOpenBciWifiConnectionListener& listener);
+	void close();
+};
@@ -0,0 +1,97 @@
+//
+//  ofxOpenBciWifiSampleRing.cpp
+//
+//  Lock-free single producer / single consumer ring of interleaved sample frames.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiSampleRing.h"
+
+ofxOpenBciWifiSampleRing::ofxOpenBciWifiSampleRing()
+{
+	_writeIndex = 0;
+	_readIndex = 0;
+	_cachedReadIndex = 0;
+	_cachedWriteIndex = 0;
+	_capacity = 0;
+	_mask = 0;
+	_stride = 0;
+}
+
+void ofxOpenBciWifiSampleRing::setup(size_t capacityFrames, int stride)
+{
+	_capacity = 1;
+	while (_capacity < capacityFrames)
+	{
+		_capacity <<= 1;
+	}
+	_mask = _capacity - 1;
+	_stride = stride;
+	_buffer.assign(_capacity * _stride, 0.f);
+
+	_writeIndex = 0;
+	_readIndex = 0;
+	_cachedReadIndex = 0;
+	_cachedWriteIndex = 0;
+}
+
+size_t ofxOpenBciWifiSampleRing::getCapacity()
+{
+	return _capacity;
+}
+
+int ofxOpenBciWifiSampleRing::getStride()
+{
+	return _stride;
+}
+
+bool ofxOpenBciWifiSampleRing::push(const float* frame)
+{
+	size_t w = _writeIndex.load(memory_order_relaxed);
+	if (w - _cachedReadIndex == _capacity)
+	{
+		_cachedReadIndex = _readIndex.load(memory_order_acquire);
+		if (w - _cachedReadIndex == _capacity)
+		{
+			return false;
+		}
+	}
+	memcpy(&_buffer[(w & _mask) * _stride], frame, _stride * sizeof(float));
+	_writeIndex.store(w + 1, memory_order_release);
+	return true;
+}
+
+size_t ofxOpenBciWifiSampleRing::getWriteSpace()
+{
+	_cachedReadIndex = _readIndex.load(memory_order_acquire);
+	return _capacity - (_writeIndex.load(memory_order_relaxed) - _cachedReadIndex);
+}
+
+size_t ofxOpenBciWifiSampleRing::getReadAvailable()
+{
+	_cachedWriteIndex = _writeIndex.load(memory_order_acquire);
+	return _cachedWriteIndex - _readIndex.load(memory_order_relaxed);
+}
+
+size_t ofxOpenBciWifiSampleRing::peek(size_t maxFrames, const float*& first, size_t& nFirst, const float*& second, size_t& nSecond)
+{
+	size_t r = _readIndex.load(memory_order_relaxed);
+	size_t n = min(maxFrames, _cachedWriteIndex - r);
+	if (n > _capacity)
+	{
+		n = 0;	// More frames consumed than were made available
+	}
+
+	size_t start = r & _mask;
+	nFirst = min(n, _capacity - start);
+	nSecond = n - nFirst;
+	first = (nFirst > 0) ? &_buffer[start * _stride] : NULL;
+	second = (nSecond > 0) ? &_buffer[0] : NULL;
+	return n;
+}
+
+void ofxOpenBciWifiSampleRing::consume(size_t nFrames)
+{
+	_readIndex.store(_readIndex.load(memory_order_relaxed) + nFrames, memory_order_release);
+}
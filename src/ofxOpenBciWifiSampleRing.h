@@ -0,0 +1,52 @@
+//
+//  ofxOpenBciWifiSampleRing.h
+//
+//  Lock-free single producer / single consumer ring of interleaved sample frames.
+//  The producer (processing) and consumer (update / getters) never take a mutex,
+//  and the consumer reads frames in place as at most two contiguous spans.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxOpenBciWifiTypes.h"
+
+#define OFX_OPENBCI_WIFI_CACHE_LINE 64
+
+class ofxOpenBciWifiSampleRing
+{
+private:
+	// Producer and consumer indices live on separate cache lines to avoid false sharing
+	alignas(OFX_OPENBCI_WIFI_CACHE_LINE) atomic<size_t> _writeIndex;
+	size_t _cachedReadIndex;						// Producer's last view of _readIndex
+
+	alignas(OFX_OPENBCI_WIFI_CACHE_LINE) atomic<size_t> _readIndex;
+	size_t _cachedWriteIndex;						// Consumer's last view of _writeIndex
+
+	alignas(OFX_OPENBCI_WIFI_CACHE_LINE) vector<float> _buffer;
+	size_t _capacity;								// Frames, power of two
+	size_t _mask;
+	int _stride;									// Floats per frame
+
+public:
+	ofxOpenBciWifiSampleRing();
+
+	// Allocates room for at least capacityFrames frames of stride floats. Not thread safe.
+	void setup(size_t capacityFrames, int stride);
+
+	size_t getCapacity();
+	int getStride();
+
+	// ** Producer **
+	// Copies one frame of getStride() floats into the ring. Returns false when the ring is full.
+	bool push(const float* frame);
+	size_t getWriteSpace();
+
+	// ** Consumer **
+	size_t getReadAvailable();
+	// Points first/second at up to maxFrames of the oldest unread frames without copying.
+	// second is only set when the frames wrap around the end of the ring. Returns the number of frames.
+	size_t peek(size_t maxFrames, const float*& first, size_t& nFirst, const float*& second, size_t& nSecond);
+	void consume(size_t nFrames);
+};
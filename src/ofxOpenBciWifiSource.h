@@ -0,0 +1,41 @@
+//
+//  ofxOpenBciWifiSource.h
+//
+//  Where ofxOpenBciWifi gets its bytes from. ofxOpenBciWifiTcpSource listens for Wifi shields,
+//  ofxOpenBciWifiReplaySource plays back captures and data logs without any sockets.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+// Receives the connections and bytes of a source
+class ofxOpenBciWifiConnectionListener
+{
+public:
+	virtual ~ofxOpenBciWifiConnectionListener() {}
+	// Returns the headset number for a new connection from ip. samplingFreq is the rate the
+	// headset streams at when the source knows it, e.g. from a recording, otherwise 0.
+	virtual int onConnect(const string& ip, int samplingFreq) = 0;
+	// Returns where the next bytes from headset should be written and how many fit,
+	// or NULL to stop reading the connection until there is room again
+	virtual char* getReceiveBuffer(int headset, size_t& nBytes) = 0;
+	// nBytes were written into the last buffer returned by getReceiveBuffer
+	virtual void onReceive(int headset, size_t nBytes) = 0;
+	virtual void onDisconnect(int headset) = 0;
+};
+
+// Called from the ofxOpenBciWifi network thread
+class ofxOpenBciWifiSource
+{
+public:
+	virtual ~ofxOpenBciWifiSource() {}
+	// Blocks until bytes may be available or timeoutMs passes
+	virtual void wait(int timeoutMs) = 0;
+	// Reports new connections and hands the available bytes to the listener
+	virtual void dispatch(ofxOpenBciWifiConnectionListener& listener) = 0;
+	// Stops delivering, called when ofxOpenBciWifi switches to another source
+	virtual void close() = 0;
+};
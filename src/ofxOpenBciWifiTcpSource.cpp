@@ -0,0 +1,96 @@
+//
+//  ofxOpenBciWifiTcpSource.cpp
+//
+//  Accepts Wifi shield connections on a TCP port.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiTcpSource.h"
+
+ofxOpenBciWifiTcpSource::ofxOpenBciWifiTcpSource()
+{
+	_port = 0;
+}
+
+ofxOpenBciWifiTcpSource::~ofxOpenBciWifiTcpSource()
+{
+	close();
+}
+
+bool ofxOpenBciWifiTcpSource::setup(int port)
+{
+	_port = port;
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+	return _reactor.setup(port);
+#else
+	_clientHeadsets.clear();
+	TCP.setMessageDelimiter("\r\n");
+	return TCP.setup(port);
+#endif
+}
+
+int ofxOpenBciWifiTcpSource::getPort()
+{
+	return _port;
+}
+
+void ofxOpenBciWifiTcpSource::wait(int timeoutMs)
+{
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+	// Sleep until a shield connects or sends data
+	_reactor.wait(timeoutMs);
+#else
+	ofSleepMillis(1);
+#endif
+}
+
+void ofxOpenBciWifiTcpSource::dispatch(ofxOpenBciWifiConnectionListener& listener)
+{
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+	_reactor.dispatch(listener);
+#else
+	int lastId = TCP.getLastID();
+	if (_clientHeadsets.size() < lastId)
+	{
+		_clientHeadsets.resize(lastId, -1);
+	}
+	for (int i = 0; i < lastId; i++)
+	{
+		if (!TCP.isClientConnected(i))
+		{
+			if (_clientHeadsets.at(i) >= 0)
+			{
+				listener.onDisconnect(_clientHeadsets.at(i));
+				_clientHeadsets.at(i) = -1;
+			}
+			continue;
+		}
+		if (_clientHeadsets.at(i) < 0)
+		{
+			_clientHeadsets.at(i) = listener.onConnect(TCP.getClientIP(i), 0);
+		}
+		int h = _clientHeadsets.at(i);
+
+		// receive all the available bytes straight into the listener's buffers,
+		// the parsers don't need the messages split at the delimiter
+		int n;
+		size_t space;
+		char* buffer;
+		while ((buffer = listener.getReceiveBuffer(h, space)) != NULL && (n = TCP.receiveRawBytes(i, buffer, space)) > 0)
+		{
+			listener.onReceive(h, n);
+		}
+	}
+#endif
+}
+
+void ofxOpenBciWifiTcpSource::close()
+{
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+	_reactor.close();
+#else
+	TCP.close();
+	_clientHeadsets.clear();
+#endif
+}
@@ -0,0 +1,36 @@
+//
+//  ofxOpenBciWifiTcpSource.h
+//
+//  Accepts Wifi shield connections on a TCP port. Uses ofxOpenBciWifiReactor where epoll
+//  is available and ofxTCPServer everywhere else.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofxNetwork.h"
+#include "ofxOpenBciWifiReactor.h"
+
+class ofxOpenBciWifiTcpSource : public ofxOpenBciWifiSource
+{
+private:
+#ifdef OFX_OPENBCI_WIFI_USE_EPOLL
+	ofxOpenBciWifiReactor _reactor;
+#else
+	ofxTCPServer TCP;
+	vector<int> _clientHeadsets;		// Headset number by ofxTCPServer client id, -1 before onConnect
+#endif
+	int _port;
+
+public:
+	ofxOpenBciWifiTcpSource();
+	~ofxOpenBciWifiTcpSource();
+
+	bool setup(int port);
+	int getPort();
+
+	void wait(int timeoutMs);
+	void dispatch(ofxOpenBciWifiConnectionListener& listener);
+	void close();
+};
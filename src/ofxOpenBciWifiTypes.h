@@ -0,0 +1,152 @@
+//
+//  ofxOpenBciWifiTypes.h
+//
+//  Shared data types for the ofxOpenBciWifi addOn
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+#define OFX_OPENBCI_WIFI_MAX_CHANNELS 16	// Cyton + Daisy
+#define OFX_OPENBCI_WIFI_AUX_CHANNELS 3		// Accelerometer X, Y, Z
+#define OFX_OPENBCI_WIFI_RAW_PACKET_SIZE 33	// Bytes per raw Cyton packet, also the smallest possible sample
+
+// Format of the data streamed by the Wifi shield
+enum ofxOpenBciWifiDataFormat
+{
+	OFX_OPENBCI_WIFI_FORMAT_JSON,		// {"chunk":[...]} text
+	OFX_OPENBCI_WIFI_FORMAT_RAW			// 33 byte Cyton packets
+};
+
+// What to do when a consumer stalls and the bounded ingest buffers fill up
+enum ofxOpenBciWifiOverflowPolicy
+{
+	OFX_OPENBCI_WIFI_OVERFLOW_DROP_OLDEST,	// Throw away the oldest buffered data
+	OFX_OPENBCI_WIFI_OVERFLOW_DROP_NEWEST,	// Throw away data as it arrives
+	OFX_OPENBCI_WIFI_OVERFLOW_BLOCK			// Stop reading the socket, TCP flow control pauses the shield
+};
+
+// Data loss and buffer usage of one headset
+struct ofxOpenBciWifiOverflowStats
+{
+	uint64_t droppedSamples;						// Includes an estimate for dropped bytes that were never parsed
+	uint64_t droppedBytes;							// Received bytes thrown away before parsing
+	uint64_t overflowEvents;						// Number of times a buffer went from not full to full
+	size_t bytesHighWaterMark;						// Most received bytes waiting to be parsed
+	size_t samplesHighWaterMark;					// Most processed samples waiting for update()
+};
+
+// A single decoded sample from one OpenBci board
+struct ofxOpenBciWifiSample
+{
+	double timestamp;
+	int sampleNumber;
+	int count;										// "count" of the chunk the sample arrived in
+	int nChannels;
+	float data[OFX_OPENBCI_WIFI_MAX_CHANNELS];
+	int nAux;										// 0 when the sample carries no aux data
+	float aux[OFX_OPENBCI_WIFI_AUX_CHANNELS];
+};
+
+#define OFX_OPENBCI_WIFI_INVALID_HEADSET -1
+
+// Zero-copy view of one channel of interleaved sample frames
+struct ofxOpenBciWifiChannelSpan
+{
+	const float* first;
+	size_t nFirst;
+	const float* second;
+	size_t nSecond;
+	int stride;
+
+	size_t size() const { return nFirst + nSecond; }
+	float operator[](size_t i) const { return i < nFirst ? first[i * stride] : second[(i - nFirst) * stride]; }
+};
+
+// Zero-copy view of interleaved sample frames, split in two when the frames wrap around a ring buffer
+struct ofxOpenBciWifiSampleSpans
+{
+	const float* first;
+	size_t nFirst;
+	const float* second;
+	size_t nSecond;
+	int nChannels;
+	int stride;										// Floats from the start of one frame to the next
+
+	size_t size() const { return nFirst + nSecond; }
+	float at(size_t sample, int channel) const
+	{
+		return sample < nFirst ? first[sample * stride + channel] : second[(sample - nFirst) * stride + channel];
+	}
+	ofxOpenBciWifiChannelSpan channel(int ch) const
+	{
+		ofxOpenBciWifiChannelSpan span = { first ? first + ch : NULL, nFirst, second ? second + ch : NULL, nSecond, stride };
+		return span;
+	}
+};
+
+// Filtered samples handed to ofxOpenBciWifi::newSamplesEvent listeners
+struct ofxOpenBciWifiSamplesEventArgs
+{
+	int headset;
+	ofxOpenBciWifiSampleSpans samples;				// Only valid during the callback
+	uint64_t receiveTime;							// ofGetElapsedTimeMicros() when the oldest sample of the block arrived
+};
+
+// New spectrum handed to ofxOpenBciWifi::newFftEvent listeners
+struct ofxOpenBciWifiFftEventArgs
+{
+	int headset;
+	const vector<vector<float>>* fft;				// Channels x Frequency, only valid during the callback
+};
+
+// New band powers handed to ofxOpenBciWifi::newBandPowerEvent listeners
+struct ofxOpenBciWifiBandPowerEventArgs
+{
+	int headset;
+	const vector<vector<float>>* power;				// Channels x Bands, only valid during the callback
+	const vector<vector<float>>* ratios;			// Channels x Ratios
+	uint64_t receiveTime;							// ofGetElapsedTimeMicros() when the newest sample arrived
+};
+
+// Time from receiving a sample's bytes to handing it to the newSamplesEvent listeners
+struct ofxOpenBciWifiLatencyStats
+{
+	uint64_t nBlocks;
+	uint64_t lastMicros;
+	uint64_t maxMicros;
+	double meanMicros;
+};
+
+// Stages timed by the instrumentation
+enum ofxOpenBciWifiStage
+{
+	OFX_OPENBCI_WIFI_STAGE_RECEIVE,			// Received bytes waiting to be parsed
+	OFX_OPENBCI_WIFI_STAGE_PARSE,
+	OFX_OPENBCI_WIFI_STAGE_FILTER,
+	OFX_OPENBCI_WIFI_STAGE_FFT,
+	OFX_OPENBCI_WIFI_STAGE_DELIVERY,		// From receiving a sample to publishing it with update()
+	OFX_OPENBCI_WIFI_STAGE_COUNT
+};
+
+// Latency distribution of one stage
+struct ofxOpenBciWifiStageStats
+{
+	uint64_t count;
+	uint64_t p50Micros;
+	uint64_t p99Micros;
+	uint64_t maxMicros;
+};
+
+// Instrumentation of one headset since it was enabled, reset or last dumped
+struct ofxOpenBciWifiInstrumentationSnapshot
+{
+	double seconds;
+	ofxOpenBciWifiStageStats stages[OFX_OPENBCI_WIFI_STAGE_COUNT];
+	double samplesPerSecond;
+	double bytesPerSecond;
+	double fftFramesPerSecond;
+};
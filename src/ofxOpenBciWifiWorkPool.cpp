@@ -0,0 +1,158 @@
+//
+//  ofxOpenBciWifiWorkPool.cpp
+//
+//  Work-stealing thread pool for the offline batch jobs.
+//
+//  This work is licensed under the MIT License
+//
+
+#include "ofxOpenBciWifiWorkPool.h"
+
+ofxOpenBciWifiWorkPool::ofxOpenBciWifiWorkPool()
+{
+	_nQueued = 0;
+	_nPending = 0;
+	_nextWorker = 0;
+	_nStolen = 0;
+	_stopping = false;
+}
+
+ofxOpenBciWifiWorkPool::~ofxOpenBciWifiWorkPool()
+{
+	stop();
+}
+
+void ofxOpenBciWifiWorkPool::setup(int nThreads)
+{
+	stop();
+	if (nThreads <= 0)
+	{
+		nThreads = max((int)thread::hardware_concurrency(), 1);
+	}
+	_stopping = false;
+	_nStolen = 0;
+	for (int w = 0; w < nThreads; w++)
+	{
+		_workers.push_back(unique_ptr<Worker>(new Worker()));
+	}
+	for (int w = 0; w < nThreads; w++)
+	{
+		_threads.push_back(thread(&ofxOpenBciWifiWorkPool::run, this, w));
+	}
+}
+
+void ofxOpenBciWifiWorkPool::stop()
+{
+	{
+		unique_lock<mutex> lock(_idleMutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+	for (int w = 0; w < _threads.size(); w++)
+	{
+		_threads.at(w).join();
+	}
+	_threads.clear();
+	_workers.clear();
+	_nQueued = 0;
+	_nPending = 0;
+	_done.notify_all();
+}
+
+int ofxOpenBciWifiWorkPool::getThreadCount()
+{
+	return _workers.size();
+}
+
+void ofxOpenBciWifiWorkPool::push(Task task, int worker)
+{
+	if (_workers.empty())
+	{
+		setup();
+	}
+	if (worker < 0 || worker >= _workers.size())
+	{
+		worker = _nextWorker++ % _workers.size();
+	}
+	_nPending++;
+	_nQueued++;
+	{
+		unique_lock<mutex> lock(_workers.at(worker)->tasksMutex);
+		_workers.at(worker)->tasks.push_back(task);
+	}
+	{
+		// Under the lock so a worker about to sleep can't miss it
+		unique_lock<mutex> lock(_idleMutex);
+	}
+	_wake.notify_one();
+}
+
+void ofxOpenBciWifiWorkPool::wait()
+{
+	unique_lock<mutex> lock(_idleMutex);
+	_done.wait(lock, [this] { return _nPending == 0; });
+}
+
+uint64_t ofxOpenBciWifiWorkPool::getStealCount()
+{
+	return _nStolen;
+}
+
+bool ofxOpenBciWifiWorkPool::takeTask(int worker, Task& task)
+{
+	// Newest of our own first, the data it touches is likely still in cache
+	{
+		Worker& own = *_workers.at(worker);
+		unique_lock<mutex> lock(own.tasksMutex);
+		if (!own.tasks.empty())
+		{
+			task = move(own.tasks.back());
+			own.tasks.pop_back();
+			_nQueued--;
+			return true;
+		}
+	}
+
+	// Then the oldest of someone else's, which tends to be the biggest
+	int nWorkers = _workers.size();
+	for (int i = 1; i < nWorkers; i++)
+	{
+		Worker& victim = *_workers.at((worker + i) % nWorkers);
+		unique_lock<mutex> lock(victim.tasksMutex);
+		if (!victim.tasks.empty())
+		{
+			task = move(victim.tasks.front());
+			victim.tasks.pop_front();
+			_nQueued--;
+			_nStolen++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ofxOpenBciWifiWorkPool::run(int worker)
+{
+	Task task;
+	while (true)
+	{
+		if (takeTask(worker, task))
+		{
+			task(worker);
+			task = Task();
+			if (--_nPending == 0)
+			{
+				unique_lock<mutex> lock(_idleMutex);
+				_done.notify_all();
+			}
+			continue;
+		}
+
+		unique_lock<mutex> lock(_idleMutex);
+		_wake.wait(lock, [this] { return _stopping || _nQueued > 0; });
+		if (_stopping && _nQueued == 0)
+		{
+			return;
+		}
+	}
+}
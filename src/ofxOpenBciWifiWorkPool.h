@@ -0,0 +1,56 @@
+//
+//  ofxOpenBciWifiWorkPool.h
+//
+//  Work-stealing thread pool for the offline batch jobs. Every worker runs the tasks of its own
+//  deque newest first and steals the oldest task of another worker when it runs dry, so tasks
+//  that push smaller tasks keep their data on one core until someone is idle.
+//  Tasks get the index of the worker running them for per-worker scratch state.
+//
+//  This work is licensed under the MIT License
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class ofxOpenBciWifiWorkPool
+{
+public:
+	typedef function<void(int worker)> Task;
+
+private:
+	struct Worker
+	{
+		mutex tasksMutex;
+		deque<Task> tasks;
+	};
+
+	vector<unique_ptr<Worker>> _workers;
+	vector<thread> _threads;
+	mutex _idleMutex;
+	condition_variable _wake;					// Tasks were queued or the pool is stopping
+	condition_variable _done;					// Nothing is queued or running
+	atomic<int> _nQueued;
+	atomic<int> _nPending;						// Queued or running
+	atomic<unsigned int> _nextWorker;			// For tasks pushed from outside the pool
+	atomic<uint64_t> _nStolen;
+	bool _stopping;
+
+	void run(int worker);
+	bool takeTask(int worker, Task& task);
+
+public:
+	ofxOpenBciWifiWorkPool();
+	~ofxOpenBciWifiWorkPool();
+
+	void setup(int nThreads = 0);				// 0 = one per core
+	void stop();								// Runs what is queued, then ends the threads
+	int getThreadCount();
+
+	// Queues a task on worker's deque, pass the running task's worker from inside the pool.
+	// From other threads leave worker at -1 to spread the tasks over the workers.
+	void push(Task task, int worker = -1);
+	// Blocks until every task, including the ones they pushed, has run
+	void wait();
+	uint64_t getStealCount();
+};